@@ -2,22 +2,50 @@
  * Adjustment.c
  *
  * Adjustment module's function is to maintain data that is needed to convert raw ADC measurement
- * values into usable current and voltage values. For conversion there is a coefficient and an
- * offset value for each measured channel. To do the conversion a specific channel's raw ADC
- * value is first multiplied with it's specific coefficient value and adding it's specific offset
- * value to the result.
+ * values into usable current and voltage values. For conversion each measured channel has two
+ * integer line segments between its three calibration points. To do the conversion the segment
+ * is chosen by comparing a specific channel's raw ADC value with the channel's breakpoint, then
+ * the raw value is multiplied with the segment's slope and the segment's intercept is added to
+ * the result. Results are in millivolts and milliamperes.
  *
  * Adjustment module contains functionality to:
  * - initialize adjustment with raw "factory" values
  * - adjust measurement channels with given calibration data
  * - save current adjustment data to FLASH memory
  * - read existing adjustment data from FLASH memory
+ * - move the offsets of current channels to the zero current measured while PWM is off
+ * - convert the battery NTC measurement into temperature
+ *
+ * Adjustment data is saved to a journal in information memory segments D, C and B. Segment A
+ * holds the DCO calibration data and is never touched. Each save appends a record for every
+ * channel adjusted since the previous save. A record has a tag with the record version and the
+ * channel, the conversion segments of the channel and a CRC-8 which is written last. The newest
+ * valid record of a channel is in use. Records of the third version hold the lines of two
+ * neighbouring channels as slopes and intercepts and they are read as two equal segments.
+ *
+ * Each segment starts with a header of a magic byte and a sequence number. Segments are used in
+ * ring order and one of them is always kept erased. When the newest segment is full the next one
+ * is taken into use. The live records of the segment after it are copied to the new segment
+ * before its header is written and then that segment is erased. Thus a segment is erased only
+ * when a segment has been filled and a power loss at any point leaves either the old or the new
+ * record valid. A segment whose erase was cut by a power loss may hold any bits, before an erase
+ * the header and the unused last word are cleared so that the segment's header would have to
+ * come back by chance as well as the last word as erased for the segment to be taken as one.
+ *
+ * The earlier versions kept the data of all ten channels in segments D and C. A journal has room
+ * for only six records in the free segment B, so the journal is started there with five records
+ * of two channels' lines each, and only then it's header is written. Until the header the journal
+ * is empty and the old data is read, after it the journal holds every channel and the old data is
+ * erased. Thus a power loss at any point of the migration leaves every channel at it's old value.
  *
  * This file includes:
  * - functionality declared above
- * - FLASH addresses to store adjustment data to
+ * - FLASH addresses and journal layout to store adjustment data to
  * - factory values to initialize adjustment with
- * - functionality to read floats from FLASH and to write them to FLASH
+ * - functionality to compile calibration points and lines into conversion segments
+ * - functionality to read, append and rotate journal records in FLASH
+ * - functionality to read floats saved by the earlier versions which wrote the coefficients to
+ *   segment D and the offsets to segment C
  *
  *    Part of: Charger project
  * Created on: 25.8.2015
@@ -30,10 +58,10 @@
  ****************************************************************************************************/
 
 
-#include <msp430f2232.h>
 #include <stdint.h>
 
 #include "Adjustment.h"
+#include "Hal.h"
 
 
 /****************************************************************************************************
@@ -41,9 +69,39 @@
  ****************************************************************************************************/
 
 
-/* FLASH addresses to store adjustment data */
-#define CONVERSION_COEFFICIENT_ADDRESS 0x01000
-#define CONVERSION_OFFSET_ADDRESS      0x01040
+/* Offsets of adjustment data saved by the earlier versions in information FLASH */
+#define CONVERSION_COEFFICIENT_OFFSET 0x00
+#define CONVERSION_OFFSET_OFFSET      0x40
+
+/* Journal is in information segments D, C and B, the first three segments of information FLASH */
+#define JOURNAL_SEGMENT_SIZE  64
+#define JOURNAL_SEGMENTS      3
+
+/* Segment header is a magic byte and a sequence number, 6 records of 10 bytes follow it and the
+ * last word is left erased                                                                  */
+#define JOURNAL_MAGIC         0xA5
+#define JOURNAL_HEADER_SIZE   2
+#define JOURNAL_RECORD_SIZE   10
+#define JOURNAL_RECORDS       6
+
+/* Record version is in the high nibble of the tag and the channel in the low nibble. Version 2
+ * records hold the conversion segments without the second intercept which is calculated from
+ * the others and version 3 records hold the slope and the intercept of an even channel and the
+ * next one.                                                                                  */
+#define RECORD_VERSION_SEGMENTS 2
+#define RECORD_VERSION_LINES    3
+#define RECORD_TAG(channel)   ((RECORD_VERSION_SEGMENTS << 4) | (channel))
+#define RECORD_TAG_LINES(channel) ((RECORD_VERSION_LINES << 4) | (channel))
+#define RECORD_CHANNEL(tag)   ((tag) & 0x0F)
+#define RECORD_ERASED         0xFF
+
+#define NO_SEGMENT            0xFF
+
+/* Journal is started in segment B which the earlier versions didn't use */
+#define FIRST_SEGMENT         2
+
+/* Change of a tracked zero current offset in milliamperes that is saved to FLASH */
+#define ZERO_SAVE_LIMIT       20
 
 /*
  * The adjustment values are byte by byte so they can be read from an adjusted
@@ -92,6 +150,61 @@ const char ADJUSTMENT_OFFSETS[10][4]      = { PANEL_1_VOLTAGE_OFFSET, PANEL_1_CU
                                               PANEL_4_VOLTAGE_OFFSET, PANEL_4_CURRENT_OFFSET,
                                               BATTERY_VOLTAGE_OFFSET, BATTERY_CURRENT_OFFSET };
 
+/* Raw measurements of the battery NTC from -20 C to 60 C in 5 C steps. The NTC is 10 kOhm at
+ * 25 C with B 3950 K and it's connected to ground with a 10 kOhm pull-up to Vcc, so the
+ * measurement doesn't depend on Vcc. A measurement above NTC_OPEN_RAW or below NTC_SHORTED_RAW
+ * means the sensor is missing, between them and the table ends the table end is used.     */
+#define NTC_FIRST_TEMPERATURE -200
+#define NTC_STEP              50
+#define NTC_POINTS            17
+#define NTC_OPEN_RAW          1000
+#define NTC_SHORTED_RAW       20
+
+const uint16_t NTC_TABLE[NTC_POINTS] = { 934, 907, 873, 834, 788, 738, 684, 627, 569,
+                                         512, 456, 403, 354, 310, 270, 235, 204 };
+
+
+/****************************************************************************************************
+ *                                     DATA TYPE DEFINITIONS
+ ****************************************************************************************************/
+
+
+/*
+ * A journal record in FLASH. Tag tells the version and the channel, payload has the conversion
+ * of the channel and crc covers tag and payload. Record is 10 bytes so records stay word aligned
+ * after the 2 byte segment header.
+ */
+typedef struct
+{
+    uint8_t tag;
+    uint8_t payload[8];
+    uint8_t crc;
+} T_JournalRecord;
+
+
+/*
+ * A journal segment in FLASH.
+ */
+typedef struct
+{
+    uint8_t         magic;
+    uint8_t         sequence;
+    T_JournalRecord records[JOURNAL_RECORDS];
+    uint16_t        unused;
+} T_JournalSegment;
+
+
+/****************************************************************************************************
+ *                                           VARIABLES
+ ****************************************************************************************************/
+
+
+/* Bit for each channel adjusted since the previous save */
+static uint16_t unsavedChannels = 0;
+
+/* Bit for each channel calibrated since the previous save, zero tracking leaves them alone */
+static uint16_t calibratedChannels = 0;
+
 
 /****************************************************************************************************
  *                                      STATIC FUNCTIONS
@@ -99,80 +212,594 @@ const char ADJUSTMENT_OFFSETS[10][4]      = { PANEL_1_VOLTAGE_OFFSET, PANEL_1_CU
 
 
 /*
- * Writes a specified number of floats to a specific FLASH address.
+ * Returns a journal segment in FLASH.
+ */
+static inline const T_JournalSegment * Adjustment_GetSegment(uint8_t segment)
+{
+    return (const T_JournalSegment *)(HAL_INFO_FLASH + (segment * JOURNAL_SEGMENT_SIZE));
+}
+
+
+/*
+ * Calculates CRC-8 with polynomial x^8 + x^2 + x + 1.
+ */
+static uint8_t Adjustment_Crc8(const uint8_t * pData, uint8_t length)
+{
+    uint8_t crc = 0;
+    uint8_t i;
+
+    while(length--)
+    {
+        crc ^= *pData++;
+
+        for(i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+    }
+
+    /* Erased value is never stored so that a record torn before its last word is never valid */
+    return (RECORD_ERASED == crc) ? 0x00 : crc;
+}
+
+
+/*
+ * Checks that a record is of a known version, for an existing channel and it's CRC matches.
  */
-static void Adjustment_WriteToFlash(float * pFloats, char * pFlash, uint8_t floatCount)
+static uint8_t Adjustment_IsRecordValid(const T_JournalRecord * pRecord)
 {
-    /* Disable interrupts while writing to FLASH */
-    _BIC_SR(GIE);
+    uint8_t version = pRecord->tag >> 4;
+    uint8_t channel = RECORD_CHANNEL(pRecord->tag);
 
-    /* Convert the float pointer into a char pointer so the data can be written char by char to FLASH */
-    char * pCharFloats = (char *)pFloats;
+    if(((RECORD_VERSION_SEGMENTS != version) && (RECORD_VERSION_LINES != version)) ||
+       (channel >= 10) || ((RECORD_VERSION_LINES == version) && (channel & 1)))
+        return 0;
 
-    FCTL2 = FWKEY + FSSEL_0 + (FN5 + FN4); /* Use ACLK and divide with 6         */
-    FCTL1 = FWKEY + ERASE;                 /* Set erase                          */
-    FCTL3 = FWKEY;                         /* Clear lock                         */
-    *pCharFloats = 0x00;                   /* Dummy write to erase FLASH segment */
+    return Adjustment_Crc8(&pRecord->tag, JOURNAL_RECORD_SIZE - 1) == pRecord->crc;
+}
+
+
+/*
+ * Checks whether a record holds the conversion of a channel. Records of two channels hold the
+ * channel in their tag and the next one.
+ */
+static uint8_t Adjustment_HasChannel(const T_JournalRecord * pRecord, uint8_t channel)
+{
+    uint8_t first = RECORD_CHANNEL(pRecord->tag);
 
-    while(FCTL3 & BUSY);
+    if(RECORD_VERSION_LINES == (pRecord->tag >> 4))
+        return (channel == first) || (channel == (first + 1));
 
-    FCTL1 = FWKEY + WRT;                   /* Change to write mode               */
+    return channel == first;
+}
 
-    uint8_t i = 0;
 
-    /* Write byte by byte to FLASH  */
-    for(i = 0; i < (floatCount * 4); i++)
+/*
+ * Checks whether all bytes of a memory area are erased.
+ */
+static uint8_t Adjustment_IsErased(const uint8_t * pData, uint8_t length)
+{
+    while(length--)
     {
-        *pFlash++ = *pCharFloats++;
-        while((FCTL3 & BUSY));
+        if(RECORD_ERASED != *pData++)
+            return 0;
     }
 
-    FCTL1 = FWKEY;
-    FCTL3 = FWKEY + LOCK;                    /* Set lock */
+    return 1;
+}
+
+
+/*
+ * Checks whether a segment has been taken into use. It has the magic and the unused last word
+ * is erased.
+ */
+static uint8_t Adjustment_IsSegmentUsed(const T_JournalSegment * pSegment)
+{
+    return (JOURNAL_MAGIC == pSegment->magic) && (0xFFFF == pSegment->unused);
+}
+
+
+/*
+ * Checks whether a segment continues the sequence of the segment before it in ring order.
+ */
+static uint8_t Adjustment_IsSegmentNext(uint8_t segment)
+{
+    const T_JournalSegment * pSegment  = Adjustment_GetSegment(segment);
+    const T_JournalSegment * pPrevious = Adjustment_GetSegment((segment + JOURNAL_SEGMENTS - 1) % JOURNAL_SEGMENTS);
+
+    /* The 8-bit sequence wraps around */
+    return Adjustment_IsSegmentUsed(pSegment) && Adjustment_IsSegmentUsed(pPrevious) &&
+           (pSegment->sequence == (uint8_t)(pPrevious->sequence + 1));
+}
+
+
+/*
+ * Finds the segment with the newest sequence number. Segments are taken into use in ring order
+ * with the next sequence number so the newest is the one whose next segment doesn't continue
+ * the sequence. A segment whose erase was cut by a power loss may look like one with any
+ * sequence number, so a segment that continues the sequence of the previous one is preferred.
+ * Returns NO_SEGMENT if the journal is empty.
+ */
+static uint8_t Adjustment_FindNewestSegment(void)
+{
+    uint8_t newest = NO_SEGMENT;
+    uint8_t i;
+
+    for(i = 0; i < JOURNAL_SEGMENTS; i++)
+    {
+        if(!Adjustment_IsSegmentUsed(Adjustment_GetSegment(i)) || Adjustment_IsSegmentNext((i + 1) % JOURNAL_SEGMENTS))
+            continue;
 
-    /* Enable interrupts after writing to FLASH */
-    _BIS_SR(GIE);
+        if((NO_SEGMENT == newest) || Adjustment_IsSegmentNext(i))
+            newest = i;
+    }
+
+    return newest;
 }
 
 
 /*
- * Reads specified number of floats from a specific FLASH address to a float array.
+ * Finds the newest valid record of a channel by going through the segments and their records
+ * from the newest to the oldest. Returns 0 if the channel has no valid record.
  */
-static void Adjustment_ReadFloatsFromFlash(float * pFloats, char * pFlash, uint8_t floatCount)
+static const T_JournalRecord * Adjustment_FindNewestRecord(uint8_t channel)
 {
-    uint8_t i = 0;
-    uint8_t j = 0;
+    const T_JournalSegment * pSegment;
+    uint8_t                  segment = Adjustment_FindNewestSegment();
+    uint8_t                  i;
+    int8_t                   j;
 
-    float  result  = 0;
-    char * pResult = (char *)&result;
+    if(NO_SEGMENT == segment)
+        return 0;
 
-    /* Loop through number of floats and on each float go through it's four bytes
-     * to assign the value to result which is then assigned to the float array. */
-    for(i = 0; i < floatCount; i++)
+    for(i = 0; i < JOURNAL_SEGMENTS; i++)
     {
-        /* If flash address contains other than 0xFF in the first byte it's
-         * considered a valid value.                                      */
-        if(*pFlash != 0xFF)
+        pSegment = Adjustment_GetSegment(segment);
+
+        if(Adjustment_IsSegmentUsed(pSegment))
         {
-            for(j = 0; j < 4; j++)
-                pResult[j] = *pFlash++;
+            for(j = JOURNAL_RECORDS - 1; j >= 0; j--)
+            {
+                if(Adjustment_HasChannel(&pSegment->records[j], channel) && Adjustment_IsRecordValid(&pSegment->records[j]))
+                    return &pSegment->records[j];
+            }
+        }
+
+        /* Previous segment in ring order is the next older one */
+        segment = (segment + JOURNAL_SEGMENTS - 1) % JOURNAL_SEGMENTS;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Erases a journal segment. The unused last word and the header are cleared first, an erase
+ * cut by a power loss leaves random bits set and the segment could keep the header otherwise.
+ * The last word goes first as a cut write of the header could leave any header.
+ */
+static void Adjustment_EraseSegment(uint8_t segment)
+{
+    const T_JournalSegment * pSegment = Adjustment_GetSegment(segment);
+
+    Hal_FlashWriteWord(&pSegment->unused, 0);
+    Hal_FlashWriteWord(pSegment, 0);
+    Hal_FlashEraseSegment(pSegment);
+}
+
+
+/*
+ * Writes a record word by word to a free record slot so that the word with the CRC is written
+ * last. A record interrupted by a power loss fails the CRC check. The last word also has the
+ * last payload byte, it's written alone first so that a write cut by a power loss can't leave
+ * a half written payload byte with a CRC that happens to match. The record has only bytes so
+ * in RAM it may be at an odd address where MSP430 can't read words, thus each word is built
+ * from two bytes.
+ */
+static void Adjustment_WriteRecord(const T_JournalRecord * pFlash, const T_JournalRecord * pRecord)
+{
+    const uint8_t  * pBytes     = (const uint8_t *)pRecord;
+    const uint16_t * pFlashWord = (const uint16_t *)pFlash;
+    uint8_t          i;
+
+    for(i = 0; i < (JOURNAL_RECORD_SIZE / 2); i++)
+    {
+        /* Erased bits of a written word stay as they are */
+        if(i == ((JOURNAL_RECORD_SIZE / 2) - 1))
+            Hal_FlashWriteWord(pFlashWord, pBytes[0] | 0xFF00);
+
+        Hal_FlashWriteWord(pFlashWord++, pBytes[0] | ((uint16_t)pBytes[1] << 8));
+        pBytes += 2;
+    }
+}
+
+
+/*
+ * Returns the first free record slot of a segment or JOURNAL_RECORDS if the segment is full.
+ * Slots after the last used one are free, a slot left half written by a power loss isn't reused.
+ */
+static uint8_t Adjustment_FindFreeSlot(const T_JournalSegment * pSegment)
+{
+    uint8_t slot = JOURNAL_RECORDS;
+
+    while((slot > 0) && Adjustment_IsErased((const uint8_t *)&pSegment->records[slot - 1], JOURNAL_RECORD_SIZE))
+        slot--;
+
+    return slot;
+}
+
+
+/*
+ * Makes sure the segment after the newest one is erased so that the next rotation has a free
+ * segment. Its live records were copied already before the newest segment got its header.
+ */
+static void Adjustment_EraseOldestSegment(uint8_t newest)
+{
+    uint8_t oldest = (newest + 1) % JOURNAL_SEGMENTS;
+
+    if(!Adjustment_IsErased((const uint8_t *)Adjustment_GetSegment(oldest), JOURNAL_SEGMENT_SIZE))
+        Adjustment_EraseSegment(oldest);
+}
+
+
+/*
+ * Makes a segment record of a channel's conversion. Breakpoint, slopes and the first intercept
+ * fill the payload.
+ */
+static void Adjustment_MakeRecord(T_JournalRecord * pRecord, uint8_t channel, const T_Conversion * pConversion)
+{
+    uint8_t i;
+
+    pRecord->tag = RECORD_TAG(channel);
+
+    for(i = 0; i < sizeof(pRecord->payload); i++)
+        pRecord->payload[i] = ((const uint8_t *)pConversion)[i];
+
+    pRecord->crc = Adjustment_Crc8(&pRecord->tag, JOURNAL_RECORD_SIZE - 1);
+}
+
+
+/*
+ * Reads the line of a channel from a record of two channels' lines. The second channel of the
+ * record is in the second half of the payload.
+ */
+static void Adjustment_ReadLines(const T_JournalRecord * pRecord, uint8_t channel, T_Conversion * pConversion)
+{
+    uint8_t i = (channel == RECORD_CHANNEL(pRecord->tag)) ? 0 : 4;
+
+    pConversion->breakpoint   = 0;
+    pConversion->slope[0]     = pRecord->payload[i] | (pRecord->payload[i + 1] << 8);
+    pConversion->slope[1]     = pConversion->slope[0];
+    pConversion->intercept[0] = pRecord->payload[i + 2] | (pRecord->payload[i + 3] << 8);
+    pConversion->intercept[1] = pConversion->intercept[0];
+}
+
 
-            pFloats[i] = result;
-            pResult    = (char *)&result;
+/*
+ * Copies a valid record of the oldest segment to a slot of the new segment if it's still the
+ * newest one of any of it's channels. A record of two channels that is the newest of only one
+ * of them is copied as a segment record of that channel, a copy of the whole record would hide
+ * the newer record of the other channel. Returns 1 if the record was copied.
+ */
+static uint8_t Adjustment_CopyRecord(const T_JournalRecord * pFlash, const T_JournalRecord * pRecord)
+{
+    T_JournalRecord record;
+    T_Conversion    conversion;
+    uint8_t         channel  = RECORD_CHANNEL(pRecord->tag);
+    uint8_t         isLines  = (RECORD_VERSION_LINES == (pRecord->tag >> 4));
+    uint8_t         isLive   = (pRecord == Adjustment_FindNewestRecord(channel));
+    uint8_t         isSecond = isLines && (pRecord == Adjustment_FindNewestRecord(channel + 1));
+
+    if(!isLive && !isSecond)
+        return 0;
+
+    if(isLines && (isLive != isSecond))
+    {
+        if(isSecond)
+            channel++;
+
+        Adjustment_ReadLines(pRecord, channel, &conversion);
+        Adjustment_MakeRecord(&record, channel, &conversion);
+        pRecord = &record;
+    }
+
+    Adjustment_WriteRecord(pFlash, pRecord);
+
+    return 1;
+}
+
+
+/*
+ * Takes the segment after the newest into use. The records of the oldest segment that are still
+ * the newest ones of their channels are copied to it first and only then the header with the
+ * next sequence number is written. Until that the copies are invisible, so a rotation cut by a
+ * power loss is just done again from the start. Finally the oldest segment is erased. Returns
+ * the new segment.
+ */
+static uint8_t Adjustment_RotateJournal(uint8_t newest)
+{
+    const T_JournalSegment * pTarget;
+    const T_JournalSegment * pOldest;
+    uint8_t                  target   = (newest + 1) % JOURNAL_SEGMENTS;
+    uint8_t                  sequence = Adjustment_GetSegment(newest)->sequence + 1;
+    uint8_t                  slot     = 0;
+    uint8_t                  i;
+
+    pTarget = Adjustment_GetSegment(target);
+    pOldest = Adjustment_GetSegment((target + 1) % JOURNAL_SEGMENTS);
+
+    /* Target should be erased already but a power loss may have interrupted an erase or an
+     * earlier rotation                                                                     */
+    if(!Adjustment_IsErased((const uint8_t *)pTarget, JOURNAL_SEGMENT_SIZE))
+        Adjustment_EraseSegment(target);
+
+    if(Adjustment_IsSegmentUsed(pOldest))
+    {
+        for(i = 0; i < JOURNAL_RECORDS; i++)
+        {
+            if(Adjustment_IsRecordValid(&pOldest->records[i]))
+                slot += Adjustment_CopyRecord(&pTarget->records[slot], &pOldest->records[i]);
         }
-        else
-            pFlash += 4;
     }
+
+    Hal_FlashWriteWord(pTarget, ((uint16_t)sequence << 8) | JOURNAL_MAGIC);
+
+    Adjustment_EraseOldestSegment(target);
+
+    return target;
+}
+
+
+/*
+ * Reads a float from four bytes that aren't necessarily word aligned.
+ */
+static float Adjustment_ReadFloat(const char * pBytes)
+{
+    float    result;
+    char   * pResult = (char *)&result;
+    uint8_t  i;
+
+    for(i = 0; i < 4; i++)
+        pResult[i] = *pBytes++;
+
+    return result;
+}
+
+
+/*
+ * Rounds a value to the nearest integer limiting it to the range of int16_t.
+ */
+static int16_t Adjustment_RoundToInt16(float value)
+{
+    if(value >= 32767.0f)
+        return 32767;
+
+    if(value <= -32768.0f)
+        return -32768;
+
+    return (int16_t)((value < 0) ? (value - 0.5f) : (value + 0.5f));
+}
+
+
+/*
+ * Calculates the intercept of the second segment so that the segments meet at the breakpoint.
+ * Returns 0 if the intercept doesn't fit to the segment.
+ */
+static uint8_t Adjustment_JoinSegments(T_Conversion * pConversion)
+{
+    int32_t atBreakpoint = pConversion->intercept[0] + (((int32_t)pConversion->slope[0] * pConversion->breakpoint) >> 8);
+    int32_t intercept    = atBreakpoint - (((int32_t)pConversion->slope[1] * pConversion->breakpoint) >> 8);
+
+    if((intercept < INT16_MIN) || (intercept > INT16_MAX))
+        return 0;
+
+    pConversion->intercept[1] = intercept;
+
+    return 1;
+}
+
+
+/*
+ * Sets a line with a coefficient in units per ADC count and an offset in units as both segments
+ * of a conversion. Used for the factory values and the data saved by the earlier versions.
+ */
+static void Adjustment_SetLine(T_Conversion * pConversion, float coeff, float offset)
+{
+    pConversion->breakpoint   = 0;
+    pConversion->slope[0]     = Adjustment_RoundToInt16(coeff * 256000.0f);
+    pConversion->slope[1]     = pConversion->slope[0];
+    pConversion->intercept[0] = Adjustment_RoundToInt16(offset * 1000.0f);
+    pConversion->intercept[1] = pConversion->intercept[0];
+}
+
+
+/*
+ * Sets the line of a channel that the earlier versions saved to segments D and C. A value that
+ * wasn't saved, it's first byte is erased, is taken from the factory values.
+ */
+static void Adjustment_ReadOldLine(uint8_t channel, T_Conversion * pConversion)
+{
+    const char * pCoeff  = (const char *)(HAL_INFO_FLASH + CONVERSION_COEFFICIENT_OFFSET + (4 * channel));
+    const char * pOffset = (const char *)(HAL_INFO_FLASH + CONVERSION_OFFSET_OFFSET + (4 * channel));
+
+    if(RECORD_ERASED == (uint8_t)*pCoeff)
+        pCoeff = ADJUSTMENT_COEFFICIENTS[channel];
+
+    if(RECORD_ERASED == (uint8_t)*pOffset)
+        pOffset = ADJUSTMENT_OFFSETS[channel];
+
+    Adjustment_SetLine(pConversion, Adjustment_ReadFloat(pCoeff), Adjustment_ReadFloat(pOffset));
 }
 
 
 /*
- * Reads existing adjustment information from FLASH memory.
+ * Starts the journal in segment B from the lines of all channels that the earlier versions
+ * saved to segments D and C, or from the factory values. Each record holds two channels. The
+ * header is written after the records so the journal stays empty until every channel is in it.
+ * Returns the segment.
+ */
+static uint8_t Adjustment_StartJournal(void)
+{
+    const T_JournalSegment * pTarget = Adjustment_GetSegment(FIRST_SEGMENT);
+    T_JournalRecord          record;
+    T_Conversion             conversion;
+    uint8_t                  channel;
+    uint8_t                  i;
+
+    /* Segment may have records of a migration cut by a power loss */
+    if(!Adjustment_IsErased((const uint8_t *)pTarget, JOURNAL_SEGMENT_SIZE))
+        Adjustment_EraseSegment(FIRST_SEGMENT);
+
+    for(channel = 0; channel < 10; channel += 2)
+    {
+        record.tag = RECORD_TAG_LINES(channel);
+
+        /* Slope and intercept of each channel, low byte first */
+        for(i = 0; i < 2; i++)
+        {
+            Adjustment_ReadOldLine(channel + i, &conversion);
+
+            record.payload[(4 * i) + 0] = (uint8_t)conversion.slope[0];
+            record.payload[(4 * i) + 1] = (uint8_t)((uint16_t)conversion.slope[0] >> 8);
+            record.payload[(4 * i) + 2] = (uint8_t)conversion.intercept[0];
+            record.payload[(4 * i) + 3] = (uint8_t)((uint16_t)conversion.intercept[0] >> 8);
+        }
+
+        record.crc = Adjustment_Crc8(&record.tag, JOURNAL_RECORD_SIZE - 1);
+
+        Adjustment_WriteRecord(&pTarget->records[channel / 2], &record);
+    }
+
+    Hal_FlashWriteWord(pTarget, JOURNAL_MAGIC);
+
+    /* Old data is in the journal now and it's erased so that it can't be taken for a segment */
+    for(i = 0; i < FIRST_SEGMENT; i++)
+    {
+        if(!Adjustment_IsErased((const uint8_t *)Adjustment_GetSegment(i), JOURNAL_SEGMENT_SIZE))
+            Adjustment_EraseSegment(i);
+    }
+
+    return FIRST_SEGMENT;
+}
+
+
+/*
+ * Appends a record to the journal to the first free slot of the newest segment. The journal is
+ * started if there is none yet and rotated if the newest segment is full. If the copied live
+ * records fill the new segment it's rotated once more, then at most four live records are left
+ * to copy as ten channels have at most ten live records.
+ */
+static void Adjustment_AppendRecord(const T_JournalRecord * pRecord)
+{
+    uint8_t segment = Adjustment_FindNewestSegment();
+    uint8_t slot;
+
+    if(NO_SEGMENT == segment)
+        segment = Adjustment_StartJournal();
+
+    /* An erase interrupted by a power loss is finished before anything is added */
+    Adjustment_EraseOldestSegment(segment);
+    slot = Adjustment_FindFreeSlot(Adjustment_GetSegment(segment));
+
+    while(JOURNAL_RECORDS == slot)
+    {
+        segment = Adjustment_RotateJournal(segment);
+        slot    = Adjustment_FindFreeSlot(Adjustment_GetSegment(segment));
+    }
+
+    Adjustment_WriteRecord(&Adjustment_GetSegment(segment)->records[slot], pRecord);
+}
+
+
+/*
+ * Reads existing adjustment information from the journal. Each channel with a valid record takes
+ * the conversion from the newest one.
  */
 static inline void Adjustment_ReadAdjustmentFromFlash(T_MeasureInformation * pMeasInfo)
 {
-    Adjustment_ReadFloatsFromFlash(&pMeasInfo->adjustmentCoeff[0],  (char *)CONVERSION_COEFFICIENT_ADDRESS, 10);
-    Adjustment_ReadFloatsFromFlash(&pMeasInfo->adjustmentOffset[0], (char *)CONVERSION_OFFSET_ADDRESS,      10);
+    const T_JournalRecord * pRecord;
+    T_Conversion          * pConversion;
+    uint8_t                 channel;
+    uint8_t                 i;
+
+    for(channel = 0; channel < 10; channel++)
+    {
+        pRecord     = Adjustment_FindNewestRecord(channel);
+        pConversion = &pMeasInfo->conversions[channel];
+
+        if(!pRecord)
+            continue;
+
+        if(RECORD_VERSION_LINES == (pRecord->tag >> 4))
+            Adjustment_ReadLines(pRecord, channel, pConversion);
+        else
+        {
+            for(i = 0; i < sizeof(pRecord->payload); i++)
+                ((uint8_t *)pConversion)[i] = pRecord->payload[i];
+
+            Adjustment_JoinSegments(pConversion);
+        }
+    }
+}
+
+
+/*
+ * Compiles the conversion segments of a channel from the raw measurements of the calibration
+ * points. Slope of each segment is the difference between calibration points divided by the
+ * difference of measured points and the breakpoint is the raw value of the middle point rounded
+ * to whole counts. Returns 0 if the raw measurements don't grow with the calibration points or
+ * a slope or an intercept doesn't fit to the segments. A conversion has a single breakpoint,
+ * see CALIBRATION_POINT_COUNT, so this takes the three calibration points of two segments only.
+ */
+static uint8_t Adjustment_CompileSegments(T_Conversion * pConversion, const uint16_t * pPoints, const uint16_t * pRaw)
+{
+    int32_t slope[CALIBRATION_SEGMENT_COUNT];
+    int32_t intercept;
+    uint8_t i;
+
+    for(i = 0; i < CALIBRATION_SEGMENT_COUNT; i++)
+    {
+        if(pRaw[i + 1] <= pRaw[i])
+            return 0;
+
+        slope[i] = ((int32_t)(pPoints[i + 1] - pPoints[i]) << 12) / (pRaw[i + 1] - pRaw[i]);
+
+        if(slope[i] > 32767)
+            return 0;
+    }
+
+    pConversion->breakpoint   = (pRaw[1] + 8) >> 4;
+    pConversion->slope[0]     = slope[0];
+    pConversion->slope[1]     = slope[1];
+
+    /* First segment goes through the first point and the second one continues from the breakpoint */
+    intercept = pPoints[0] - ((slope[0] * pRaw[0]) >> 12);
+
+    if((intercept < INT16_MIN) || (intercept > INT16_MAX))
+        return 0;
+
+    pConversion->intercept[0] = intercept;
+
+    return Adjustment_JoinSegments(pConversion);
+}
+
+
+/*
+ * Appends a journal record for each channel in the mask.
+ */
+static void Adjustment_SaveChannels(T_MeasureInformation * pMeasInfo, uint16_t channels)
+{
+    T_JournalRecord record;
+    uint8_t         channel;
+
+    Hal_FlashSetClock();
+
+    for(channel = 0; channel < 10; channel++)
+    {
+        if(!(channels & (1 << channel)))
+            continue;
+
+        Adjustment_MakeRecord(&record, channel, &pMeasInfo->conversions[channel]);
+        Adjustment_AppendRecord(&record);
+    }
 }
 
 
@@ -182,56 +809,156 @@ static inline void Adjustment_ReadAdjustmentFromFlash(T_MeasureInformation * pMe
 
 
 /*
- * Writes current adjustment information to FLASH memory.
+ * Saves the channels adjusted since the previous save to FLASH memory by appending a journal
+ * record for each of them.
  */
 inline void Adjustment_SaveAdjustmentToFlash(T_MeasureInformation * pMeasInfo)
 {
-    Adjustment_WriteToFlash(&pMeasInfo->adjustmentCoeff[0],  (char *)CONVERSION_COEFFICIENT_ADDRESS, 10);
-    Adjustment_WriteToFlash(&pMeasInfo->adjustmentOffset[0], (char *)CONVERSION_OFFSET_ADDRESS,      10);
+    Adjustment_SaveChannels(pMeasInfo, unsavedChannels);
+
+    unsavedChannels    = 0;
+    calibratedChannels = 0;
+}
+
+
+/*
+ * Moves the conversion of a current channel so that the filtered raw value measured at zero
+ * current, in 1/64 ADC counts, converts to zero. Both segments move together. Channels with an
+ * unsaved calibration are left alone. Returns 1 if the offset differs from the saved one by
+ * ZERO_SAVE_LIMIT or if the channel has no segment record to compare with, the channel should
+ * be saved then.
+ */
+uint8_t Adjustment_SetZero(T_MeasureInformation * pMeasInfo, uint8_t channel, uint16_t zeroRaw)
+{
+    T_Conversion          * pConversion = &pMeasInfo->conversions[channel];
+    const T_JournalRecord * pRecord;
+    int16_t                 savedIntercept;
+    int16_t                 zeroValue;
+    int16_t                 difference;
+    uint8_t                 segment;
+
+    if(calibratedChannels & (1 << channel))
+        return 0;
+
+    segment   = ((zeroRaw >> 6) < pConversion->breakpoint) ? 0 : 1;
+    zeroValue = pConversion->intercept[segment] + (((int32_t)pConversion->slope[segment] * zeroRaw) >> 14);
+
+    pConversion->intercept[0] -= zeroValue;
+    pConversion->intercept[1] -= zeroValue;
+
+    pRecord = Adjustment_FindNewestRecord(channel);
+
+    if(!pRecord || (RECORD_VERSION_SEGMENTS != (pRecord->tag >> 4)))
+        return 1;
+
+    /* The first intercept is the last word of the payload */
+    savedIntercept = pRecord->payload[6] | (pRecord->payload[7] << 8);
+    difference     = pConversion->intercept[0] - savedIntercept;
+
+    return (difference >= ZERO_SAVE_LIMIT) || (difference <= -ZERO_SAVE_LIMIT);
+}
+
+
+/*
+ * Saves a single channel to FLASH memory. Used for the offsets of zero tracking so that an
+ * unsaved calibration of other channels isn't saved with it.
+ */
+void Adjustment_SaveChannel(T_MeasureInformation * pMeasInfo, uint8_t channel)
+{
+    Adjustment_SaveChannels(pMeasInfo, 1 << channel);
+
+    unsavedChannels &= ~(1 << channel);
 }
 
 
 /*
- * Performs adjustment calculations and sets the results into use.
+ * Performs adjustment calculations and sets the results into use. The raw measurements of the
+ * calibration points in 1/16 ADC counts and the values of the points in millivolts or
+ * milliamperes, the same for all channels of a batch, are compiled into the conversion segments
+ * of each calibrated channel so that the control interrupt needs no divisions. All channels of a
+ * batch are compiled before any of them is taken into use, if the raw measurements of a
+ * channel don't grow with the calibration points or a slope or an intercept doesn't fit to the
+ * segments the whole adjustment is discarded and 0 is returned. The adjusted channels are saved
+ * together on the next save.
  */
-inline void Adjustment_MakeAdjustment(T_MeasureInformation * pMeasInfo, T_CalibrationInfo * pCalibInfo)
+inline uint8_t Adjustment_MakeAdjustment(T_MeasureInformation * pMeasInfo, T_CalibrationInfo * pCalibInfo, const uint16_t * pPoints)
 {
-    /* To determine if voltage or current is being calibrated */
-    uint8_t type = 1;
+    T_Conversion conversions[CALIBRATION_BATCH_SIZE];
+    uint8_t      channel;
+    uint8_t      i;
 
-    if(0 == (pCalibInfo->measToCalibrate % 2))
-        type = 0;
+    for(i = 0; i < pCalibInfo->channelCount; i++)
+    {
+        if(!Adjustment_CompileSegments(&conversions[i], pPoints, pCalibInfo->calibResults[i]))
+            return 0;
+    }
 
-    /* Calculate coefficient by taking the difference between calibration points and dividing it by the difference of measured points */
-    pMeasInfo->adjustmentCoeff[pCalibInfo->measToCalibrate] = (CALIBRATION_POINTS[type][1] - CALIBRATION_POINTS[type][0])/((float)(pCalibInfo->calibResults[1] - pCalibInfo->calibResults[0]));
+    for(i = 0; i < pCalibInfo->channelCount; i++)
+    {
+        channel = pCalibInfo->measToCalibrate + (2 * i);
 
-    /* Calculate offset by finding where the line would intersect with zero voltage/current */
-    pMeasInfo->adjustmentOffset[pCalibInfo->measToCalibrate] = CALIBRATION_POINTS[type][0] - (pMeasInfo->adjustmentCoeff[pCalibInfo->measToCalibrate] * ((float)pCalibInfo->calibResults[0]));
+        pMeasInfo->conversions[channel] = conversions[i];
+        unsavedChannels    |= 1 << channel;
+        calibratedChannels |= 1 << channel;
+    }
+
+    return 1;
 }
 
 
 /*
- * Retrieves the current calibration by first reading the original "factory" values
- * and then updating them by reading values from FLASH.
+ * Converts a raw measurement of the battery NTC into tenths of a degree Celsius by interpolating
+ * linearly between the points of the NTC table. Returns TEMPERATURE_UNKNOWN if the sensor is
+ * missing.
  */
-void Adjustment_GetCurrentAdjustment(T_MeasureInformation * pMeasInfo)
+int16_t Adjustment_ConvertTemperature(uint16_t raw)
 {
-    char * currentByte;
-    char * readByte;
+    uint8_t i;
+
+    if((raw > NTC_OPEN_RAW) || (raw < NTC_SHORTED_RAW))
+        return TEMPERATURE_UNKNOWN;
 
-    currentByte = (char *)pMeasInfo->adjustmentCoeff;
-    readByte    = (char *)ADJUSTMENT_COEFFICIENTS;
+    if(raw >= NTC_TABLE[0])
+        return NTC_FIRST_TEMPERATURE;
+
+    /* Measurement decreases with temperature */
+    for(i = 1; i < NTC_POINTS; i++)
+    {
+        if(raw >= NTC_TABLE[i])
+        {
+            return NTC_FIRST_TEMPERATURE + ((i - 1) * NTC_STEP) +
+                   (((NTC_TABLE[i - 1] - raw) * NTC_STEP) / (NTC_TABLE[i - 1] - NTC_TABLE[i]));
+        }
+    }
 
-    uint8_t i = 0;
+    return NTC_FIRST_TEMPERATURE + ((NTC_POINTS - 1) * NTC_STEP);
+}
 
-    for(i = 0; i < 40; i++)
-        *currentByte++ = *readByte++;
 
-    currentByte = (char *)pMeasInfo->adjustmentOffset;
-    readByte    = (char *)ADJUSTMENT_OFFSETS;
+/*
+ * Retrieves the current calibration. If the journal is empty the lines saved by the earlier
+ * versions, or the factory lines, are used and they are moved to the journal on the first save.
+ * Otherwise the factory lines are updated from the journal in FLASH.
+ */
+void Adjustment_GetCurrentAdjustment(T_MeasureInformation * pMeasInfo)
+{
+    uint8_t isJournalNew = (NO_SEGMENT == Adjustment_FindNewestSegment());
+    uint8_t channel;
+
+    for(channel = 0; channel < 10; channel++)
+    {
+        if(isJournalNew)
+            Adjustment_ReadOldLine(channel, &pMeasInfo->conversions[channel]);
+        else
+        {
+            Adjustment_SetLine(&pMeasInfo->conversions[channel], Adjustment_ReadFloat(ADJUSTMENT_COEFFICIENTS[channel]),
+                                                                 Adjustment_ReadFloat(ADJUSTMENT_OFFSETS[channel]));
+        }
+    }
 
-    for(i = 0; i < 40; i++)
-        *currentByte++ = *readByte++;
+    unsavedChannels    = 0;
+    calibratedChannels = 0;
 
-    Adjustment_ReadAdjustmentFromFlash(pMeasInfo);
+    if(!isJournalNew)
+        Adjustment_ReadAdjustmentFromFlash(pMeasInfo);
 }
@@ -2,16 +2,20 @@
  * Adjustment.h
  *
  * Adjustment module's function is to maintain data that is needed to convert raw ADC measurement
- * values into usable current and voltage values. For conversion there is a coefficient and an
- * offset value for each measured channel. To do the conversion a specific channel's raw ADC
- * value is first multiplied with it's specific coefficient value and adding it's specific offset
- * value to the result.
+ * values into usable current and voltage values. For conversion each measured channel has two
+ * integer line segments between its three calibration points, no more as a conversion has a
+ * single breakpoint. To do the conversion the segment is chosen by comparing a specific
+ * channel's raw ADC value with the channel's breakpoint, then the raw value is multiplied with
+ * the segment's slope and the segment's intercept is added to the result. Results are in
+ * millivolts and milliamperes.
  *
  * Adjustment module contains functionality to:
  * - initialize adjustment with raw "factory" values included in Adjustment.c
  * - adjust measurement channels with given calibration data
  * - save current adjustment data to FLASH memory
  * - read existing adjustment data from FLASH memory
+ * - move the offsets of current channels to the zero current measured while PWM is off
+ * - convert the battery NTC measurement into temperature
  *
  * Adjustment header file includes global function declarations and inclusion of header Common.h
  * where are declared data structures needed for these functions. Also included is definition of
@@ -40,23 +44,41 @@
  ****************************************************************************************************/
 
 
+/*
+ * Conversion of a single channel. Raw values below the breakpoint use the first segment and the
+ * rest the second one. Segments meet at the breakpoint. A segment converts a raw value into
+ * intercept + ((slope * raw) >> 8) so the slope is in 1/256 units per ADC count.
+ */
+typedef struct
+{
+    uint16_t breakpoint;
+    int16_t  slope[CALIBRATION_SEGMENT_COUNT];
+    int16_t  intercept[CALIBRATION_SEGMENT_COUNT];
+} T_Conversion;
+
+
 /*
  * Holds measurement information needed to save the ADC measurements and convert
- * them into current and voltage float values.
+ * them into millivolts and milliamperes.
  */
 typedef struct
 {
     /* Raw ADC measurement values */
     unsigned int rawMeas[15];
 
-    /* Measurement results after conversion to voltage and current units for 10 needed values */
-    float        measResults[10];
+    /* Raw measurements of the 10 needed values corrected to the nominal supply voltage, in the
+     * order of the measurement results                                                        */
+    uint16_t     correctedMeas[10];
+
+    /* Measurement results after conversion to millivolts and milliamperes for 10 needed values
+     * and the battery temperature                                                            */
+    uint16_t     measResults[11];
 
-    /* Adjustment coefficient values */
-    float        adjustmentCoeff[10];
+    /* Bit for each measurement result that changed in the latest conversion */
+    uint16_t     changedResults;
 
-    /* Adjustment offset values */
-    float        adjustmentOffset[10];
+    /* Conversion segments of the 10 needed values */
+    T_Conversion conversions[10];
 } T_MeasureInformation;
 
 
@@ -67,8 +89,18 @@ typedef struct
 /* Writes current adjustment information to FLASH memory. */
 inline void Adjustment_SaveAdjustmentToFlash(T_MeasureInformation * pMeasInfo);
 
-/* Performs adjustment calculations with given calibration data */
-inline void Adjustment_MakeAdjustment(T_MeasureInformation * pMeasInfo, T_CalibrationInfo * pCalibInfo);
+/* Performs adjustment calculations with given calibration data and calibration point values,
+ * returns 0 if it was discarded                                                              */
+inline uint8_t Adjustment_MakeAdjustment(T_MeasureInformation * pMeasInfo, T_CalibrationInfo * pCalibInfo, const uint16_t * pPoints);
+
+/* Moves a current channel's offset to the measured zero, returns 1 if the channel should be saved */
+uint8_t Adjustment_SetZero(T_MeasureInformation * pMeasInfo, uint8_t channel, uint16_t zeroRaw);
+
+/* Writes a single channel's adjustment to FLASH memory */
+void Adjustment_SaveChannel(T_MeasureInformation * pMeasInfo, uint8_t channel);
+
+/* Converts a raw NTC measurement into tenths of a degree Celsius */
+int16_t Adjustment_ConvertTemperature(uint16_t raw);
 
 /* Retrieves available adjustment configuration */
 void Adjustment_GetCurrentAdjustment(T_MeasureInformation * pMeasInfo);
@@ -0,0 +1,183 @@
+/*
+ * Button.c
+ *
+ * Button module reads the single button of the device. Button's port 3.2 can't give an
+ * interrupt so the button is sampled on every system tick (516 us) from the tick interrupt.
+ * This way the timing of clicks doesn't depend on how long the main loop takes and even
+ * short presses are not missed.
+ *
+ * Source includes functionality to:
+ * - debounce the sampled button state
+ * - detect short, double, long and repeat clicks
+ * - queue click events in the tick interrupt and read them in the main loop
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include "Button.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Length of the event queue, must be a power of two */
+#define EVENT_QUEUE_LENGTH 4
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+/* Event queue is written only in the tick interrupt (head) and read only in the main loop (tail) */
+static          T_ButtonEvent eventQueue[EVENT_QUEUE_LENGTH];
+static volatile uint8_t       eventHead = 0;
+static volatile uint8_t       eventTail = 0;
+
+/* Click timings in milliseconds, set in the main loop and read in the tick interrupt */
+static volatile uint16_t timings[BUTTON_TIMING_COUNT] = { BUTTON_DEBOUNCE_MS,
+                                                          BUTTON_LONG_CLICK_MS,
+                                                          BUTTON_DOUBLE_CLICK_MS,
+                                                          BUTTON_REPEAT_MS };
+
+/* Debounce and click detection state, only used in the tick interrupt */
+static uint8_t  sampledState   = 0;    /* Latest sampled state                    */
+static uint8_t  buttonPressed  = 0;    /* Debounced state. 0 = false, 1 = true    */
+static uint8_t  isLongClick    = 0;    /* Current press has become a long click   */
+static uint8_t  isShortPending = 0;    /* A short click may become a double click */
+static uint32_t changeTime     = 0;    /* Time of the latest sampled state change */
+static uint32_t pressTime      = 0;    /* Time of the debounced press             */
+static uint32_t releaseTime    = 0;    /* Time of the latest short click          */
+static uint32_t repeatTime     = 0;    /* Time of the latest long or repeat click */
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Adds an event to the queue. If the queue is full the event is dropped.
+ */
+static void Button_QueueEvent(uint8_t click, uint32_t timestamp)
+{
+    uint8_t nextHead = (eventHead + 1) & (EVENT_QUEUE_LENGTH - 1);
+
+    if(nextHead == eventTail)
+        return;
+
+    eventQueue[eventHead].click     = click;
+    eventQueue[eventHead].timestamp = timestamp;
+
+    eventHead = nextHead;
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Samples button state and queues click events.
+ */
+void Button_Sample(uint8_t isPressed, uint32_t milliseconds)
+{
+    /* Sampled state must stay the same for the debounce time before it's accepted */
+    if(isPressed != sampledState)
+    {
+        sampledState = isPressed;
+        changeTime   = milliseconds;
+    }
+
+    if((sampledState != buttonPressed) && ((milliseconds - changeTime) >= timings[BUTTON_DEBOUNCE]))
+    {
+        buttonPressed = sampledState;
+
+        if(buttonPressed)
+        {
+            pressTime   = changeTime;
+            isLongClick = 0;
+        }
+        else if(!isLongClick)
+        {
+            /* In case of a quick release the click is defined as a short click or as a double
+             * click if the previous short click was released a moment ago                    */
+            if(isShortPending && ((changeTime - releaseTime) <= timings[BUTTON_DOUBLE_CLICK]))
+            {
+                Button_QueueEvent(DOUBLE_CLICK, changeTime);
+                isShortPending = 0;
+            }
+            else
+            {
+                Button_QueueEvent(SHORT_CLICK, changeTime);
+                isShortPending = 1;
+                releaseTime    = changeTime;
+            }
+        }
+    }
+
+    /* If button has been held pressed long enough the click is defined a long click and
+     * after that repeat clicks are given as long as the button is held pressed          */
+    if(buttonPressed)
+    {
+        if(!isLongClick)
+        {
+            if((milliseconds - pressTime) >= timings[BUTTON_LONG_CLICK])
+            {
+                Button_QueueEvent(LONG_CLICK, milliseconds);
+                isLongClick    = 1;
+                isShortPending = 0;
+                repeatTime     = milliseconds;
+            }
+        }
+        else if((milliseconds - repeatTime) >= timings[BUTTON_REPEAT])
+        {
+            Button_QueueEvent(REPEAT_CLICK, milliseconds);
+            repeatTime = milliseconds;
+        }
+    }
+}
+
+
+/*
+ * Takes the oldest click event from the queue.
+ */
+uint8_t Button_GetEvent(T_ButtonEvent * pEvent)
+{
+    if(eventTail == eventHead)
+        return 0;
+
+    *pEvent   = eventQueue[eventTail];
+    eventTail = (eventTail + 1) & (EVENT_QUEUE_LENGTH - 1);
+
+    return 1;
+}
+
+
+/*
+ * Returns a click timing in milliseconds.
+ */
+uint16_t Button_GetTiming(uint8_t timing)
+{
+    return timings[timing];
+}
+
+
+/*
+ * Sets a click timing in milliseconds. A 16-bit write is atomic so the tick interrupt sees
+ * either the old or the new timing.
+ */
+void Button_SetTiming(uint8_t timing, uint16_t milliseconds)
+{
+    timings[timing] = milliseconds;
+}
@@ -0,0 +1,94 @@
+/*
+ * Button.h
+ *
+ * Button module reads the single button of the device. Button's port 3.2 can't give an
+ * interrupt so the button is sampled on every system tick (516 us) from the tick interrupt.
+ * This way the timing of clicks doesn't depend on how long the main loop takes and even
+ * short presses are not missed.
+ *
+ * Button state is debounced by requiring it to stay the same for BUTTON_DEBOUNCE_MS after
+ * a change. Debounced presses and releases are then turned into click events which are
+ * queued with the millisecond timestamp of when they happened:
+ * - short click:  button is released before BUTTON_LONG_CLICK_MS
+ * - double click: a short click released within BUTTON_DOUBLE_CLICK_MS from the previous
+ *                 short click's release, given instead of the second short click
+ * - long click:   button has been held down for BUTTON_LONG_CLICK_MS
+ * - repeat click: button is still held down, given every BUTTON_REPEAT_MS after long click
+ *
+ * Header includes:
+ * - click timing definitions
+ * - button event data type
+ * - global functions for sampling the button and reading the click events
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_BUTTON_H_
+#define CHARGER_BUTTON_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+#include "Common.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Click timings in milliseconds at boot */
+#define BUTTON_DEBOUNCE_MS       20
+#define BUTTON_LONG_CLICK_MS    500
+#define BUTTON_DOUBLE_CLICK_MS  300
+#define BUTTON_REPEAT_MS        250
+
+/* Indexes of the click timings */
+#define BUTTON_DEBOUNCE         0
+#define BUTTON_LONG_CLICK       1    /* A press shorter than this is a short click */
+#define BUTTON_DOUBLE_CLICK     2
+#define BUTTON_REPEAT           3
+#define BUTTON_TIMING_COUNT     4
+
+
+/****************************************************************************************************
+ *                                           DATA TYPES
+ ****************************************************************************************************/
+
+
+/*
+ * A click event with the time it happened.
+ */
+typedef struct
+{
+    uint8_t  click;
+    uint32_t timestamp;
+} T_ButtonEvent;
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/* Samples button state and queues click events. Called from the tick interrupt. */
+void Button_Sample(uint8_t isPressed, uint32_t milliseconds);
+
+/* Takes the oldest click event from the queue. Returns 0 if there are no events. */
+uint8_t Button_GetEvent(T_ButtonEvent * pEvent);
+
+/* Returns a click timing in milliseconds */
+uint16_t Button_GetTiming(uint8_t timing);
+
+/* Sets a click timing in milliseconds */
+void Button_SetTiming(uint8_t timing, uint16_t milliseconds);
+
+
+#endif /* CHARGER_BUTTON_H_ */
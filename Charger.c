@@ -2,17 +2,26 @@
  * Charger.c
  *
  * The charger module is in control of initializing the system and controlling the program
- * flow with a while(1) loop. In the loop ADC measurements and button states are read as
- * inputs and submodules are called with specific input parameters to control the state of
- * each subsystem. Also control of calibrating a measurement channel is included in Charger
+ * flow with tasks run by the scheduler. In the tasks ADC measurements and button states are
+ * read as inputs and submodules are called with specific input parameters to control the
+ * state of each subsystem. Also control of calibrating a measurement channel is included in Charger
  * module though adjustment has it's own module.
  *
  * Charger source file implements functionality to:
  *  - initialize used pins in Charger device
- *  - configure devices (clock, timers, USCI for LDC use, ADC10)
- *  - read inputs (ADC10 measurements and button state)
- *  - save calibration information for a measurement channel
- *  - control program flow
+ *  - configure devices (clock, timers, USCI for LDC use and UART, ADC10) so that charging starts first
+ *  - read inputs (ADC10 measurements and button clicks)
+ *  - run the system tick interrupt
+ *  - capture calibration points of a measurement channel and save calibration information
+ *  - track the zero of the panel currents while their PWM is off
+ *  - correct the measurements relative to Vcc with Vcc measured against the internal reference
+ *  - run the control loop from the system tick and publish it's results to the foreground
+ *  - control program flow with tasks run by the scheduler
+ *  - park the charger to low power night mode when there's no sun
+ *  - keep controller state over resets and supervise the main loop with the watchdog timer
+ *  - time the stages of the program with the profiler when it's built
+ *  - stream telemetry records over the UART and share the USCI transmit interrupt
+ *  - run the commands of the UART console for configuration and calibration
  *
  *    Part of: Charger project
  * Created on: 7.8.2015
@@ -25,9 +34,10 @@
  ****************************************************************************************************/
 
 
-#include <msp430f2232.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "Hal.h"
 #include "Charger.h"
 
 
@@ -36,15 +46,148 @@
  ****************************************************************************************************/
 
 
-/* Defines the threshold separating a short and a long click. Unit is the number of program cycles. */
-#define SHORT_CLICK_THRESHOLD 20
-
 /* Lookup table of different measurement values in the measurement array. In following order:
  * Panel 1 voltage, panel 1 current, panel 2 voltage, panel 2 current,
  * panel 3 voltage, panel 3 current, panel 4 voltage, panel 4 current,
  * battery voltage, battery current                                                 */
 const static uint8_t MEAS_LOOKUP_TABLE[10]     = { 14, 13, 12, 11, 10, 9, 8, 7, 2, 0 };
 
+/* Battery NTC is measured on A13 */
+#define TEMPERATURE_RAW_INDEX 1
+
+/* Control loop is run every second system tick, e.g. at 1.032 ms period */
+#define CONTROL_PERIOD_TICKS 2
+
+/* Crystal fault flag is checked every 6 PWM periods of the DCO, 774 cycles thus about 48 us */
+#define CRYSTAL_CHECK_PERIODS 6
+
+/* Boot time is counted in PWM periods, 16 cycles make a microsecond */
+#define BOOT_CYCLES_PER_MICROSECOND 16
+
+/* Default time all panel voltages have to stay below battery voltage before night mode is
+ * entered, it can be changed from the console                                              */
+#define NIGHT_DELAY_MS 600000
+
+/* Marks a valid record in no-init RAM */
+#define WARM_STATE_MAGIC 0x5AA5
+
+/* A calibration capture takes 256 samples in each of it's two passes, one on every control run.
+ * A point is refused if less than half of the second pass samples are within the window or if
+ * their standard deviation is over 2 ADC counts, 32 in 1/16 counts.                            */
+#define CAPTURE_SAMPLES   256
+#define CAPTURE_MAX_NOISE 32
+
+/* Zero current is summed over blocks of 64 control runs, thus in 1/64 counts, and the blocks are
+ * filtered with a first order filter that takes 1/16 of the difference, about a second.        */
+#define ZERO_BLOCK_SAMPLES  64
+#define ZERO_FILTER_DIVIDER 16
+
+/* Vcc is measured every 256 control runs as (Vcc - Vss) / 2 against the internal 2.5 V reference
+ * which is turned on a run before. The raw measurements are corrected to the nominal 3.3 V supply
+ * measured as 675. Measurements outside 2.9 - 3.6 V are left out as the reference needs 2.9 V.
+ * Vcc is filtered with a first order filter that takes 1/4 of the difference, about a second. */
+#define VCC_REFERENCE_RUN  0xFE
+#define VCC_MEASURE_RUN    0xFF
+#define VCC_NOMINAL_RAW    675
+#define VCC_MIN_RAW        593
+#define VCC_MAX_RAW        737
+#define VCC_FILTER_DIVIDER 4
+#define VCC_SCALE_ONE      4096
+
+/* Indexes of the tasks in the task table */
+#define MENU_TASK      0
+#define LCD_INIT_TASK  1
+#define LCD_TASK       2
+#define POWER_TASK     3
+#define ZERO_TASK      4
+#define TELEMETRY_TASK 5
+#define CONSOLE_TASK   6
+#define TASK_COUNT     7
+
+/* Payload of a telemetry record in bytes, see Charger_TelemetryTask */
+#define TELEMETRY_RECORD_LENGTH 62
+
+/* Status bits of a telemetry record */
+#define TELEMETRY_NIGHT_MODE 0x01
+
+/* Ranges of the values set from the console */
+#define CONSOLE_TIMING_MIN      10     /* Click timings (ms)                       */
+#define CONSOLE_TIMING_MAX    2000
+#define CONSOLE_PERIOD_MAX   60000     /* Telemetry period (ms), 0 stops records   */
+#define CONSOLE_NIGHT_MIN     1000     /* Night delay (ms)                         */
+#define CONSOLE_NIGHT_MAX  3600000
+
+/* Number of commands in the console's command table */
+#define CONSOLE_COMMAND_COUNT 11
+
+/* Line of the dump reply where the lines of the tasks start */
+#define DUMP_TASK_LINE 5
+
+/* Ranges of the battery voltage limits set from the console (mV) in the order of the limits.
+ * Minimum goes down to it's boot value. Temperature compensation adds up to 0.8 V to the
+ * charge voltage so it's kept at most 15 V, and the ranges don't overlap.                */
+const static uint16_t CONSOLE_LIMIT_RANGES[2][2] = { {  9500, 12000 },      /* PWM_LIMIT_MINIMUM */
+                                                     { 13500, 15000 } };    /* PWM_LIMIT_CHARGE  */
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+/* measInfo saves the latest measurements of all 15 ADC channels and for used 10 channels it also saves
+ * their converted results and conversion segments. Raw measurements and conversion segments are
+ * used by the control interrupt, converted results are the foreground's copy.                     */
+static T_MeasureInformation measInfo = { 0 };
+
+/* Results of the control loop and it's timing written by the control interrupt */
+static volatile T_ControlSnapshot controlSnapshot = { 0 };
+static volatile T_ControlStatus   controlStatus   = { 0 };
+
+/* Timing of the boot until the first PWM update */
+static volatile T_BootStatus      bootStatus      = { 0 };
+
+/* Controller state and energy counter kept over resets */
+#pragma NOINIT(warmControl)
+static T_WarmControl warmControl;
+
+#pragma NOINIT(warmEnergy)
+static T_WarmEnergy  warmEnergy;
+
+/* Foreground makes this odd while it changes adjustment values and control is skipped meanwhile */
+static volatile uint8_t adjustmentSequence = 0;
+
+/* In night mode PWM timers and ADC10 are stopped and control isn't run */
+static volatile uint8_t isNightMode = 0;
+
+/* Software timer that runs while all panel voltages are below battery voltage, TIMER_NONE
+ * when the sun is up, and the flag it sets when the night delay has passed                 */
+static uint8_t          nightTimer   = TIMER_NONE;
+static volatile uint8_t isNightDue   = 0;
+static uint32_t         nightDelayMs = NIGHT_DELAY_MS;
+
+/* Menu system with menuScreens */
+static T_MenuSystem         menu     = { NO_MENU, 0, MENU_VIEWS };
+
+/* Holds calibration values when calibrating an ADC channel and the capture of a calibration point */
+static T_CalibrationInfo    calib    = { 0, 1, 0, CAPTURE_IDLE, 0, 0, { { 0 } } };
+static T_CalibrationCapture capture  = { 0 };
+static T_ZeroTracking       zero     = { { 0 }, 0, 0x0F, 0, 0, { 0 } };
+
+/* Values of the calibration points captured from the console in millivolts or milliamperes and
+ * a bit for each of the points that is accepted                                              */
+static uint16_t             consoleReferences[CALIBRATION_POINT_COUNT];
+static uint8_t              consolePoints = 0;
+
+/* Supply voltage correction of the raw measurements, used by the control interrupt */
+static T_VccCorrection      vcc      = { 0, VCC_SCALE_ONE, 0 };
+
+static int8_t   chargingState = -1; /* Will be used when PWM module is implemented */
+static uint16_t redrawFields  =  0; /* Text fields to redraw on the LCD            */
+
+/* Run time statuses of the tasks */
+static T_TaskStatus taskStatus[TASK_COUNT];
+
 
 /****************************************************************************************************
  *                                             FUNCTIONS
@@ -92,9 +235,67 @@ inline static void Charger_InitializePins(void)
 }
 
 /*
- * Initializes devices of the charger project.
+ * Calculates a Fletcher type checksum of a no-init RAM record. The sums are left without the
+ * modulo which would need a software division on every control run. For records of a few
+ * bytes the sums still depend on both the values and the order of the bytes.
+ */
+static uint16_t Charger_Checksum(const void * pRecord, uint8_t length)
+{
+    const uint8_t * pByte = (const uint8_t *)pRecord;
+    uint16_t        sum1  = 0;
+    uint16_t        sum2  = 0;
+
+    while(length--)
+    {
+        sum1 += *pByte++;
+        sum2 += sum1;
+    }
+
+    return (sum2 << 8) + sum1;
+}
+
+
+/*
+ * Reads the reset cause and checks the records in no-init RAM. A controller state is used
+ * after a watchdog or a power-on reset, which includes brown-outs, if it's valid. A reset
+ * from the reset pin starts charging from the beginning. An energy counter that isn't valid
+ * is cleared. After a real power-up RAM content is random so the checks fail.
+ */
+inline static void Charger_CheckWarmRestart(void)
+{
+    uint8_t isControlValid;
+
+    if(IFG1 & WDTIFG)
+        bootStatus.resetCause = RESET_WATCHDOG;
+    else if(IFG1 & RSTIFG)
+        bootStatus.resetCause = RESET_PIN;
+    else
+        bootStatus.resetCause = RESET_POWER_ON;
+
+    IFG1 &= ~(WDTIFG + RSTIFG + PORIFG);
+
+    isControlValid = (WARM_STATE_MAGIC == warmControl.magic) &&
+                     (Charger_Checksum(&warmControl, offsetof(T_WarmControl, checksum)) == warmControl.checksum);
+
+    bootStatus.isWarmRestart = isControlValid && (RESET_PIN != bootStatus.resetCause);
+
+    if((WARM_STATE_MAGIC != warmEnergy.magic) ||
+       (Charger_Checksum(&warmEnergy, offsetof(T_WarmEnergy, checksum)) != warmEnergy.checksum))
+    {
+        warmEnergy.magic       = WARM_STATE_MAGIC;
+        warmEnergy.joules      = 0;
+        warmEnergy.millijoules = 0;
+        warmEnergy.checksum    = Charger_Checksum(&warmEnergy, offsetof(T_WarmEnergy, checksum));
+    }
+}
+
+
+/*
+ * Sets DCO to 16 MHz and starts the 16 MHz crystal. Crystal is left to stabilize while the
+ * rest of the boot continues.
  */
-inline static void Charger_InitializeDevices(){
+inline static void Charger_InitializeClocks(void)
+{
 
     /****************************************************************************************************
      *                                  CLOCK SYSTEM CONFIGURATION
@@ -112,28 +313,27 @@ inline static void Charger_InitializeDevices(){
 
     BCSCTL1 = CALBC1_16MHZ + XTS; /* 16 MHz and high-frequency settings */
     BCSCTL3 = LFXT1S_2;           /* Set 3 - 16 MHz crystal range       */
+}
 
-    /* Wait for crystal to stabilize */
-    while(IFG1 & OFIFG)
-    {
-        IFG1 &= ~OFIFG;
-        _delay_cycles(100000);
-    }
-
-    BCSCTL2 = SELM_0; /* Select MCLK to source DCO */
-
-
+/*
+ * Configures Timer_A and Timer_B for PWM outputs with all outputs off. Clock source is given
+ * as TASSEL_1 for the crystal's ACLK or TASSEL_2 for the DCO's SMCLK.
+ */
+inline static void Charger_InitializeTimers(uint16_t clockSource)
+{
     /****************************************************************************************************
      *                                  TIMER CONFIGURATION
      * Timers A and B set PWM outputs for each four panels. Both of them source from ACLK taking
      * 16 MHz crystal clock signal. With CCR0 set to 128 they set PWM frequency to 128 kHz which
-     * is fast enough for charging.
+     * is fast enough for charging. After a warm restart timers are started already before the
+     * crystal is stable by sourcing them from SMCLK's 16 MHz DCO and moved to ACLK after that.
+     * TBSSEL_x bits are the same as TASSEL_x so the clock source is given with TASSEL_x.
      ****************************************************************************************************/
 
     /* Timer_A sets outputs for PWM 1 and 2 */
     TACTL    = TACLR;                  /* Timer_A clear                                     */
-    TACTL   |= TASSEL_1 + MC_1 + ID_0; /* Select ACLK which is configured for 16 MHz crystal,
-                                          set continuous mode and divide with one           */
+    TACTL   |= clockSource + MC_1 + ID_0; /* Select given 16 MHz clock source,
+                                             set continuous mode and divide with one        */
     TACCR0   = 128;                    /* Set PWM frequency: 16 MHz / 128 = 128kHz          */
 
     /* Initialize PWMs with output off and reset/set mode               */
@@ -150,8 +350,8 @@ inline static void Charger_InitializeDevices(){
 
     /* Timer_B sets outputs for PWM 3 and 4 */
     TBCTL   = TBCLR;                  /* Timer_B clear                                     */
-    TBCTL  |= TBSSEL_1 + MC_1 + ID_0; /* Select ACLK which is configured for 16 MHz crystal,
-                                         set continuous mode and divide with one           */
+    TBCTL  |= clockSource + MC_1 + ID_0; /* Select given 16 MHz clock source,
+                                            set continuous mode and divide with one         */
     TBCCR0  = 128;                    /*    Set PWM frequency: 16 MHz / 128 = 128kHz       */
 
     /* Initialize CCR:s with 0 output and reset/set mode */
@@ -163,6 +363,74 @@ inline static void Charger_InitializeDevices(){
     /* PWM 4 is connected to port 4.2 where TBCCR2 output is located    */
     TBCCR2  = 0;
     TBCCTL2 = OUTMOD_7;
+}
+
+/*
+ * Initializes devices of the charger project in the order that gets charging started first.
+ * PWM timers and ADC10 are configured as soon as the crystal is stable and the first sequence
+ * of conversions is done before the control loop is started with the system tick. USCI for the
+ * LCD is configured last, LCD itself and the menu are initialized by the tasks.
+ */
+inline static void Charger_InitializeDevices(void)
+{
+    uint8_t periods;
+
+    /* The wait is timed in PWM periods of Timer_A running from the DCO. After a warm restart the
+     * timers already run, otherwise they are started here with all outputs off.              */
+    if(!bootStatus.isWarmRestart)
+        Charger_InitializeTimers(TASSEL_2);
+
+    Hal_TimerClearOverflow();
+
+    /* Wait for crystal to stabilize. Fault flag is checked every 6 PWM periods and the number of
+     * checks is saved to boot status.                                                        */
+    while(IFG1 & OFIFG)
+    {
+        IFG1 &= ~OFIFG;
+
+        periods = 0;
+
+        while(periods < CRYSTAL_CHECK_PERIODS)
+            periods += Hal_TimerPollOverflow();
+
+        bootStatus.periods += CRYSTAL_CHECK_PERIODS;
+        bootStatus.crystalChecks++;
+    }
+
+    BCSCTL2 = SELM_0 + DIVS_3; /* Select MCLK to source DCO, SMCLK is DCO / 8 for the watchdog */
+
+
+    Charger_InitializeTimers(TASSEL_1);
+
+    /* Continue with the restored duty cycles now from the crystal */
+    if(bootStatus.isWarmRestart)
+        PWM_RestoreState(warmControl.chargingState, warmControl.duties);
+
+
+    /****************************************************************************************************
+     *                                     ADC10 CONFIGURATION
+     * Set ADC10 to perform conversions on 15 channels of which 11 are active, A13 is the battery NTC.
+     * This is because ADC10 starts multiple channel conversion from the highest channel (14)
+     * and goes to the lowest channel one by one no matter if a specific channel is active or not.
+     ****************************************************************************************************/
+
+    /* First measurement frame is converted before control is started */
+    Hal_AdcStartSequence(measInfo.rawMeas, 0);
+
+    /* Timer_A now runs from the crystal with the same period */
+    while(Hal_AdcIsBusy())
+        bootStatus.periods += Hal_TimerPollOverflow();
+
+
+    /****************************************************************************************************
+     *                                  SYSTEM TICK
+     * Control loop runs from the system tick so charging starts on the first tick after this.
+     ****************************************************************************************************/
+
+    Timer_Initialize();
+
+    /* Enable interrupts */
+    Hal_EnableInterrupts();
 
 
     /****************************************************************************************************
@@ -185,205 +453,1389 @@ inline static void Charger_InitializeDevices(){
 
     UCB0CTL1 &= ~UCSWRST; /* USCI reset OFF */
 
+    /* USCI A0 is the UART of the telemetry on P3.4 and P3.5 */
+    Uart_Initialize();
+}
 
+/*
+ * Converts a raw ADC value to millivolts or milliamperes using the conversion segments of a
+ * channel. The segment is indexed by comparing the raw value with the channel's breakpoint so
+ * only integer math is needed.
+ */
+static inline uint16_t Charger_Convert(const T_Conversion * pConversion, uint16_t raw)
+{
+    uint8_t segment = (raw < pConversion->breakpoint) ? 0 : 1;
+    int32_t result  = pConversion->intercept[segment] + (((int32_t)pConversion->slope[segment] * raw) >> 8);
 
-    /****************************************************************************************************
-     *                                     ADC10 CONFIGURATION
-     * Set ADC10 to perform conversions on 15 channels of which 10 are active.
-     * This is because ADC10 starts multiple channel conversion from the highest channel (14)
-     * and goes to the lowest channel one by one no matter if a specific channel is active or not.
-     ****************************************************************************************************/
-
-    ADC10CTL0 &= ~ENC; /* Disable conversion */
+    /* If value is close to zero it's possible that offset value decreases it below zero. Set value to 0 in case this happens */
+    if(result < 0)
+        return 0;
 
-    /* Set highest active channel to 14, repeat sequence-of-channels conversion */
-    ADC10CTL1 = INCH_14 + CONSEQ_3;
+    if(result > VALUE_SATURATED)
+        return VALUE_SATURATED;
 
-    /* Sample-and-hold time 16 ADC10LCKs, reference Vcc and Vss, ADC10 ON and multiple sample conversion */
-    ADC10CTL0 = ADC10SHT_2 + SREF_0 + ADC10ON + MSC;
+    return result;
+}
 
-    ADC10DTC1 = 15; /* Number of channels to convert */
 
-    /* Enable interrupts */
-    _BIS_SR(GIE);
+/*
+ * Converts the latest measurements of 10 wanted ADC channels to millivolts and milliamperes in
+ * the control snapshot.
+ */
+static void Charger_ConvertMeasurements(void)
+{
+    uint8_t i;
 
-    /* LCD is turned on with LCD modules own initialization function */
-    LCD_Initialize();
+    for(i = 0; i < 10; i++)
+        controlSnapshot.measResults[i] = Charger_Convert(&measInfo.conversions[i], measInfo.correctedMeas[i]);
 }
 
+
 /*
- * Performs measurements on each 15 ADC channels and calculates current float values
- * for 10 wanted measurements.
+ * Reads the Vcc measurement and updates the scale of the raw measurements from the filtered Vcc.
  */
-static void Charger_MeasureADC(T_MeasureInformation * pMeasInfo)
+static void Charger_ReadVcc(void)
 {
+    uint16_t raw = Hal_AdcReadVcc();
+    int16_t  difference;
+
+    if((raw < VCC_MIN_RAW) || (raw > VCC_MAX_RAW))
+        return;
+
+    if(0 == vcc.filtered)
+        vcc.filtered = raw << 4;
+    else
+    {
+        difference    = (raw << 4) - vcc.filtered;
+        vcc.filtered += difference / VCC_FILTER_DIVIDER;
+    }
+
+    vcc.scale = ((uint32_t)vcc.filtered << 8) / VCC_NOMINAL_RAW;
+}
 
-    /* Perform measurements and save results to corresponding meas value array      */
-    ADC10CTL0 &= ~ENC;
-    while (ADC10CTL1 & BUSY);
-    ADC10SA = (unsigned int)pMeasInfo->rawMeas;
-    ADC10CTL0 |= ENC + ADC10SC;
 
-    /* Calculate average of each 10 wanted ADC measurements and save them as floats */
+/*
+ * Scales the raw measurements of the 10 used channels from the current supply to the nominal
+ * supply so that the conversions and the calibration don't depend on Vcc. The results go to
+ * their own array, so the raw measurements stay raw and a sequence can't be corrected twice.
+ */
+static void Charger_CorrectVcc(void)
+{
     uint8_t i;
 
-    /* Loop through measured ADC channels */
     for(i = 0; i < 10; i++)
+        measInfo.correctedMeas[i] = (((uint32_t)measInfo.rawMeas[MEAS_LOOKUP_TABLE[i]] * vcc.scale) + (VCC_SCALE_ONE / 2)) >> 12;
+}
+
+
+/*
+ * Adds the corrected raw value of the captured channel to the capture sums if it's within the
+ * window.
+ */
+static inline void Charger_CaptureSample(void)
+{
+    int16_t  difference = measInfo.correctedMeas[capture.measIndex] - capture.reference;
+    uint16_t distance   = (difference < 0) ? -difference : difference;
+
+    if(distance <= capture.window)
+    {
+        capture.sum        += difference;
+        capture.sumSquares += (int32_t)difference * difference;
+        capture.count++;
+    }
+
+    capture.remaining--;
+}
+
+
+/*
+ * Sums the raw panel currents of the latest sequence for zero tracking. The sequence was measured
+ * with the duty cycles set on the previous run, a panel's current has settled to zero if it's PWM
+ * was off also on the run before that. Duty cycles of this run are stored for the next runs.
+ */
+static inline void Charger_TrackZero(const uint8_t * pDuties)
+{
+    uint8_t settled = zero.offMasks & (zero.offMasks >> 4);
+    uint8_t panel;
+
+    zero.offMasks <<= 4;
+
+    for(panel = 0; panel < 4; panel++)
+    {
+        if(0 == pDuties[panel])
+            zero.offMasks |= 1 << panel;
+    }
+
+    if(zero.count >= ZERO_BLOCK_SAMPLES)
+        return;
+
+    zero.validMask &= settled;
+
+    for(panel = 0; panel < 4; panel++)
+        zero.sums[panel] += measInfo.correctedMeas[PANEL_1_CURRENT + (2 * panel)];
+
+    zero.count++;
+}
+
+
+/*
+ * Control loop run from the system tick. Converts the measurements of the previous sequence of
+ * conversions, updates PWM control and publishes the results to the snapshot. Then starts the next
+ * sequence which finishes well before the next run. While the foreground is changing adjustment
+ * values the conversion is skipped and PWM is kept as it is. A running calibration capture
+ * takes a sample of every sequence. Once in 256 runs Vcc is measured instead of the sequence
+ * and the next run only reads it keeping PWM as it is.
+ */
+static void Charger_RunControl(void)
+{
+    uint8_t isSequence = (VCC_MEASURE_RUN != vcc.runs);
+
+    if(Hal_AdcIsBusy())
+    {
+        controlStatus.adcOverruns++;
+        return;
+    }
+
+    PROFILER_START(PROFILER_MEASURE);
+
+    if(isSequence)
+        Charger_CorrectVcc();
+    else
+        Charger_ReadVcc();
+
+    /* A calibration capture takes the captured channel's raw value of every sequence */
+    if(capture.remaining && isSequence)
+        Charger_CaptureSample();
+
+    if(isSequence && !(adjustmentSequence & 1))
     {
-        /* Calculate the average and convert using calibration coefficient and offset values corresponding to each channel        */
-           pMeasInfo->measResults[i] = ((float)pMeasInfo->rawMeas[MEAS_LOOKUP_TABLE[i]] * pMeasInfo->adjustmentCoeff[i]) + pMeasInfo->adjustmentOffset[i];
+        controlSnapshot.sequence++;
+
+        Charger_ConvertMeasurements();
+
+        /* Measuring is profiled only on runs that convert */
+        PROFILER_END(PROFILER_MEASURE);
+
+        PROFILER_START(PROFILER_CONTROL);
+        controlSnapshot.chargingState = PWM_UpdateControl((uint16_t *)controlSnapshot.measResults);
+        PROFILER_END(PROFILER_CONTROL);
+
+        controlSnapshot.sequence++;
 
-        /* If value is close to zero it's possible that offset value decreases it below zero. Set value to 0 in case this happens */
-        if(pMeasInfo->measResults[i] < 0)
-            pMeasInfo->measResults[i] = 0;
+        /* Keep the controller state for a warm restart */
+        warmControl.magic         = WARM_STATE_MAGIC;
+        warmControl.chargingState = controlSnapshot.chargingState;
+        PWM_GetDuties(warmControl.duties);
+        warmControl.checksum      = Charger_Checksum(&warmControl, offsetof(T_WarmControl, checksum));
+
+        Charger_TrackZero(warmControl.duties);
+
+        /* The first control run is on the first tick, a whole tick after the tick was started */
+        if(0 == bootStatus.firstPwmMicroseconds)
+            bootStatus.firstPwmMicroseconds = ((bootStatus.periods * HAL_PWM_PERIOD_CYCLES) / BOOT_CYCLES_PER_MICROSECOND) + TIMER_TICK_MICROSECONDS;
     }
 
+    /* Start the next sequence of conversions to raw measurement array or measure Vcc */
+    vcc.runs++;
+
+    if(VCC_MEASURE_RUN == vcc.runs)
+        Hal_AdcStartVcc();
+    else if(VCC_REFERENCE_RUN == vcc.runs)
+        Hal_AdcStartSequence(measInfo.rawMeas, REFON + REF2_5V);
+    else
+        Hal_AdcStartSequence(measInfo.rawMeas, 0);
+
+    controlStatus.runs++;
 }
 
 
 /*
- * Checks if button is pressed or not and returns if there's been a short click, long click or no action.
+ * Copies the latest control results from the snapshot to measInfo and marks the results that
+ * changed in changedResults. Copying is retried if the control interrupt published new results
+ * meanwhile. Battery temperature is converted here from the latest raw NTC measurement and the
+ * charge voltage of the control is set for it.
  */
-static enum E_ButtonClicks Charger_IsButtonClicked()
+static void Charger_ReadControlSnapshot(void)
 {
-    enum E_ButtonClicks isClicked = NO_CLICK;
+    uint16_t sequence;
+    uint16_t resultBit;
+    int16_t  temperature;
+    uint8_t  i;
 
-    static uint8_t  buttonPressed  = 0;    /* Stores if the button was pressed or not. 0 = false, 1 = true */
-    static uint16_t pressedCounter = 0;    /* Stores for how many cycles the button has been pressed       */
+    measInfo.changedResults = 0;
 
-    /* Check if button is pressed */
-    if(!(P3IN & BIT2))
+    do
     {
-        /* Check if this is the first time button is pressed or if it is held pressed */
-        if(0 == buttonPressed)
-            buttonPressed++;
-        else
+        sequence  = controlSnapshot.sequence;
+        resultBit = 1;
+
+        for(i = 0; i < 10; i++)
         {
-            /* If button has been held pressed long enough the click is defined a long click */
-            if(pressedCounter == SHORT_CLICK_THRESHOLD)
-                isClicked = LONG_CLICK;
+            if(controlSnapshot.measResults[i] != measInfo.measResults[i])
+            {
+                measInfo.measResults[i]  = controlSnapshot.measResults[i];
+                measInfo.changedResults |= resultBit;
+            }
 
-            pressedCounter++;
+            resultBit <<= 1;
         }
+
+        chargingState = controlSnapshot.chargingState;
+
+    } while(sequence != controlSnapshot.sequence);
+
+    temperature = Adjustment_ConvertTemperature(measInfo.rawMeas[TEMPERATURE_RAW_INDEX]);
+
+    if((uint16_t)temperature != measInfo.measResults[BATTERY_TEMPERATURE])
+    {
+        measInfo.measResults[BATTERY_TEMPERATURE]  = temperature;
+        measInfo.changedResults                   |= 1 << BATTERY_TEMPERATURE;
+    }
+
+    PWM_SetTemperature(temperature);
+}
+
+
+/*
+ * Returns 1 if every panel voltage is below battery voltage, thus no panel could charge.
+ */
+static uint8_t Charger_IsSunDown(const uint16_t * pMeasResults)
+{
+    uint8_t i;
+
+    for(i = PANEL_1_VOLTAGE; i <= PANEL_4_VOLTAGE; i += 2)
+    {
+        if(pMeasResults[i] >= pMeasResults[BATTERY_VOLTAGE])
+            return 0;
     }
 
-    /* If button is not pressed but it was previously pressed then it has been released.
-     * In case of a quick release the click is defined as a short click                 */
-    else if(1 == buttonPressed)
+    return 1;
+}
+
+
+/*
+ * Clock governor changes MCLK between calibrated 16 MHz and 1 MHz DCO frequencies. The control
+ * loop and LCD frames need 16 MHz, at night the short wake ups of the tick and the dawn check
+ * are run at 1 MHz. Timers and USCI source from the crystal's ACLK so PWM and SPI timing stay
+ * the same with either speed.
+ */
+static void Charger_SetSlowClock(uint8_t isSlow)
+{
+    /* Lowest DCO setting first so that the frequency can't overshoot while changing range */
+    DCOCTL = 0;
+
+    if(isSlow)
+    {
+        BCSCTL1 = CALBC1_1MHZ + XTS;
+        DCOCTL  = CALDCO_1MHZ;
+    }
+    else
     {
-        if (pressedCounter < SHORT_CLICK_THRESHOLD)
-            isClicked = SHORT_CLICK;
+        BCSCTL1 = CALBC1_16MHZ + XTS;
+        DCOCTL  = CALDCO_16MHZ;
+    }
+}
+
+
+/*
+ * Saves the offsets that zero tracking has moved. A save may rotate the journal and erase a
+ * FLASH segment, which keeps interrupts disabled for about 15 ms, so the offsets are saved only
+ * when the control has been stopped for the night. Until then they're used from RAM and after a
+ * reset zero tracking moves them again.
+ */
+static void Charger_SaveZeros(void)
+{
+    uint8_t panel;
 
-        buttonPressed = 0;
-        pressedCounter = 0;
+    for(panel = 0; panel < 4; panel++)
+    {
+        if(zero.unsavedMask & (1 << panel))
+            Adjustment_SaveChannel(&measInfo, PANEL_1_CURRENT + (2 * panel));
     }
 
-    return isClicked;
+    zero.unsavedMask = 0;
 }
 
 
 /*
- * First initializes devices and variables, then controls the overall flow of the program
- * with a while loop where inputs are read and the input results are then handled in
- * specific program areas.
+ * Parks the charger for the night. PWM outputs are set low and Timer_B is stopped,
+ * ADC10 is turned off, the moved zero offsets are saved and the LCD put to sleep.
+ * The tick is slowed down, the CPU sleeps in LPM3 between the 32 ticks a second
+ * and MCLK runs at 1 MHz when awake.
  */
-void main(void)
+static void Charger_EnterNightMode(void)
 {
-    /*                                            DEVICE CONFIGURATION                                                        */
+    /* Control interrupt doesn't touch PWM or ADC10 after this */
+    isNightMode = 1;
 
-    /* Stop watchdog timer */
-    WDTCTL = WDTPW + WDTHOLD;
+    TACCTL1  = OUTMOD_0;
+    TACCTL2  = OUTMOD_0;
+    TBCCTL1  = OUTMOD_0;
+    TBCCTL2  = OUTMOD_0;
 
-    /* Initialize pins and devices */
-    Charger_InitializePins();
-    Charger_InitializeDevices();
+    TBCTL   &= ~MC_3;
 
-    /*                                        INITIALIZATION OF USED VARIABLES                                                */
+    Hal_AdcOff();
 
-    /* measInfo saves three past measurements of all 15 ADC channels and for used 10 channels it also saves their averages,
-     * calibration coefficients and offsets.                                                                                  */
-    T_MeasureInformation measInfo = { 0 };
+    /* Conversions at night are sequences so the next run after the night doesn't read Vcc */
+    vcc.runs = 0;
 
-    /* Gets current calibration info by first setting the "factory" values and then checking if new calibration data is found in FLASH. */
-    Adjustment_GetCurrentAdjustment(&measInfo);
+    Charger_SaveZeros();
 
-    /* Initialize menu system with menuScreens */
-    T_MenuSystem menu = { NO_MENU, 0, NO_MENU, MENU_VIEWS, 0, 0 };
+    LCD_Sleep();
 
-    /* Holds calibration values when calibrating an ADC channel */
-    T_CalibrationInfo calib = { 0, { 0, 0 } };
+    Timer_SetSlowTick(1);
+    Scheduler_SetSleepMode(LPM3_bits);
+    Charger_SetSlowClock(1);
+}
 
-    enum E_ButtonClicks buttonClick = NO_CLICK; /* Button state */
 
-    int8_t  menuAction    = -1; /* Action to perform defined by menu module    */
-    int8_t  chargingState = -1; /* Will be used when PWM module is implemented */
-    uint8_t LCDinit       =  0; /* LCD init counter                            */
-    uint8_t cycleDelay    =  0;
+/*
+ * Restarts the charger from night mode. PWM control continues from start up mode on
+ * the next control period and the whole screen is redrawn at once. A fresh sequence is
+ * converted for the first control run, the last one of the night may be minutes old.
+ */
+static void Charger_LeaveNightMode(void)
+{
+    Charger_SetSlowClock(0);
+    Scheduler_SetSleepMode(LPM0_bits);
+    Timer_SetSlowTick(0);
 
-    /*                                                 MAIN LOOP                                                                */
-    while(1){
+    Hal_AdcStartSequence(measInfo.rawMeas, 0);
 
-        /* Read inputs and perform submodule tasks with results */
-        Charger_MeasureADC(&measInfo);
-        chargingState = PWM_UpdateControl(measInfo.measResults);
+    while(Hal_AdcIsBusy());
 
-        buttonClick   = Charger_IsButtonClicked();
-        menuAction    = Menu_UpdateView(&menu, buttonClick, measInfo.measResults, &calib);
+    TACCTL1  = OUTMOD_7;
+    TACCTL2  = OUTMOD_7;
+    TBCCTL1  = OUTMOD_7;
+    TBCCTL2  = OUTMOD_7;
 
-        /* Perform action given by menu module */
-        switch(menuAction)
-        {
-        case MENU_NO_ACTION:
-            break;
+    TBCTL   |= MC_1;
 
-        case MENU_MEASURE_1:
+    LCD_Wake();
+    redrawFields = ALL_TEXT_FIELDS;
+    Scheduler_ReleaseTask(&taskStatus[LCD_TASK]);
 
-            /* Save given measurement's raw measurement data at the first calibration point */
-            calib.calibResults[0] = measInfo.rawMeas[MEAS_LOOKUP_TABLE[calib.measToCalibrate]];
-            break;
+    isNightMode = 0;
+}
 
-        case MENU_MEASURE_2:
 
-            /* Save given measurement's raw measurement data at the second calibration point
-             * and perform adjustment                                                        */
-            calib.calibResults[1] = measInfo.rawMeas[MEAS_LOOKUP_TABLE[calib.measToCalibrate]];
-            Adjustment_MakeAdjustment(&measInfo, &calib);
-            break;
+/*
+ * Performs a single sequence of conversions while control interrupt is stopped at night and
+ * publishes the results to the control snapshot which the foreground writes meanwhile.
+ */
+static void Charger_MeasureAtNight(void)
+{
+    Hal_AdcStartSequence(measInfo.rawMeas, 0);
 
-        case MENU_SAVE:
-            Adjustment_SaveAdjustmentToFlash(&measInfo);
-            break;
+    while(Hal_AdcIsBusy());
 
-        case MENU_CANCEL:
+    Hal_AdcOff();
 
-            /* In case of cancel reload previous adjustment data from factory defaults and FLASH */
-            Adjustment_GetCurrentAdjustment(&measInfo);
-            break;
+    Charger_CorrectVcc();
 
-        default:
+    controlSnapshot.sequence++;
+    Charger_ConvertMeasurements();
+    controlSnapshot.sequence++;
+}
 
-            /* Numbers 0-9 get here indicating which measurement will be calibrated and adjusted */
-            calib.measToCalibrate = menuAction;
-            break;
-        }
 
-        /* Update LCD screen */
-        LCD_UpdateScreen(menu.currentTextFields, menu.views[menu.menuState].textFieldCount);
+/*
+ * Calculates the integer square root with shifts and adds only.
+ */
+static uint16_t Charger_SquareRoot(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit  = 1UL << 30;
 
-        /*
-         * TODO: Sometimes the LCD screen has shut down unexpectedly and initializing it again
-         * every now and then seems to prevent it. This behaviour should be given a deeper
-         * investagion.
-         */
-        LCDinit++;
+    while(bit > value)
+        bit >>= 2;
 
-         if(LCDinit > 100)
-         {
-             LCD_Initialize();
-             LCDinit = 0;
-         }
+    while(bit)
+    {
+        if(value >= (root + bit))
+        {
+            value -= root + bit;
+            root   = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
 
-        for (cycleDelay = 0; cycleDelay < 50000; cycleDelay++);
+        bit >>= 2;
     }
+
+    return root;
+}
+
+
+/*
+ * Calculates the mean and the standard deviation of a finished capture pass in 1/16 ADC counts.
+ * Returns 0 if the pass has no samples or if the samples are so far apart that the variance
+ * doesn't fit in 32 bits, the deviation would be hundreds of counts then.
+ */
+static uint8_t Charger_GetCaptureStatistics(uint16_t * pMean, uint16_t * pDeviation)
+{
+    int32_t  mean;
+    uint32_t meanSquare;
+    uint32_t variance;
+
+    if((0 == capture.count) || (capture.sumSquares >= 0x01000000UL))
+        return 0;
+
+    /* Mean relative to the reference and variance in 1/256 counts squared */
+    mean       = (capture.sum * 16) / (int32_t)capture.count;
+    meanSquare = mean * mean;
+    variance   = (capture.sumSquares << 8) / capture.count;
+
+    /* Rounding may make the variance of a noiseless capture slightly negative */
+    if(variance < meanSquare)
+        variance = 0;
+    else
+        variance -= meanSquare;
+
+    *pMean      = (capture.reference << 4) + mean;
+    *pDeviation = Charger_SquareRoot(variance);
+
+    return 1;
 }
 
+
+/*
+ * Starts a pass of the calibration capture. Remaining is set last as it lets the control
+ * interrupt take samples.
+ */
+static void Charger_StartCapturePass(uint16_t reference, uint16_t window)
+{
+    capture.remaining  = 0;
+    capture.count      = 0;
+    capture.reference  = reference;
+    capture.window     = window;
+    capture.sum        = 0;
+    capture.sumSquares = 0;
+    capture.pass++;
+    capture.remaining  = CAPTURE_SAMPLES;
+}
+
+
+/*
+ * Starts capturing the calibration point on the current channel of the capture. The first pass
+ * takes all samples relative to the latest measurement.
+ */
+static void Charger_StartChannelCapture(void)
+{
+    capture.remaining = 0;
+    capture.measIndex = calib.measToCalibrate + (2 * capture.channel);
+    capture.pass      = 0;
+
+    Charger_StartCapturePass(measInfo.correctedMeas[capture.measIndex], 0xFFFF);
+}
+
+
+/*
+ * Starts capturing a calibration point. The channels of a batch are captured one after another
+ * so that a single capture is enough for all of them. A capture from the menu drops the points
+ * captured from the console as it takes their calibration information.
+ */
+static void Charger_StartCapture(uint8_t point, uint8_t isConsole)
+{
+    capture.remaining  = 0;
+    capture.channel    = 0;
+    capture.isConsole  = isConsole;
+
+    if(!isConsole)
+        consolePoints = 0;
+
+    calib.capturePoint = point;
+    calib.captureState = CAPTURE_RUNNING;
+
+    Charger_StartChannelCapture();
+}
+
+
+/*
+ * Follows a running calibration capture. After the first pass the second pass is started with a
+ * window of three standard deviations, at least one count, around the first pass mean. After the
+ * second pass the channel is accepted or refused by it's noise and the next channel of a batch
+ * is captured. The mean and the noise of the noisiest channel are converted to the channel's unit
+ * for the calibration view, a refused channel refuses the whole point. A capture from the menu is
+ * dropped if the view of it's calibration point has been left.
+ */
+static void Charger_UpdateCapture(void)
+{
+    const T_Conversion * pConversion = &measInfo.conversions[calib.measToCalibrate + (2 * capture.channel)];
+    uint16_t             mean;
+    uint16_t             deviation;
+    uint16_t             window;
+    uint32_t             noise;
+    uint16_t             raw;
+    int16_t              slope;
+    uint8_t              isRefused;
+
+    if(CAPTURE_IDLE == calib.captureState)
+        return;
+
+    if(!capture.isConsole && ((CALIBRATION_VIEW_1 + calib.capturePoint) != menu.menuState))
+    {
+        capture.remaining  = 0;
+        calib.captureState = CAPTURE_IDLE;
+        return;
+    }
+
+    if((CAPTURE_RUNNING != calib.captureState) || (0 != capture.remaining))
+        return;
+
+    if(!Charger_GetCaptureStatistics(&mean, &deviation))
+    {
+        calib.captureMean  = 0;
+        calib.captureNoise = VALUE_SATURATED;
+        calib.captureState = CAPTURE_REFUSED;
+        return;
+    }
+
+    if(1 == capture.pass)
+    {
+        window = ((3 * deviation) + 15) >> 4;
+
+        if(0 == window)
+            window = 1;
+
+        Charger_StartCapturePass((mean + 8) >> 4, window);
+        return;
+    }
+
+    raw   = (mean + 8) >> 4;
+    slope = pConversion->slope[(raw < pConversion->breakpoint) ? 0 : 1];
+
+    if(slope < 0)
+        slope = -slope;
+
+    noise     = ((uint32_t)deviation * slope) >> 12;
+
+    if(noise > VALUE_SATURATED)
+        noise = VALUE_SATURATED;
+    isRefused = (capture.count < (CAPTURE_SAMPLES / 2)) || (deviation > CAPTURE_MAX_NOISE);
+
+    if(isRefused || (0 == capture.channel) || (noise >= calib.captureNoise))
+    {
+        calib.captureMean  = Charger_Convert(pConversion, raw);
+        calib.captureNoise = noise;
+    }
+
+    if(isRefused)
+    {
+        calib.captureState = CAPTURE_REFUSED;
+        return;
+    }
+
+    calib.calibResults[capture.channel][calib.capturePoint] = mean;
+
+    if(++capture.channel < calib.channelCount)
+        Charger_StartChannelCapture();
+    else
+    {
+        calib.captureState = CAPTURE_ACCEPTED;
+
+        if(capture.isConsole)
+            consolePoints |= 1 << calib.capturePoint;
+    }
+}
+
+
+/*
+ * Handles a long click on OK in the view of a calibration point. The first click captures the
+ * point and a click on an accepted point confirms it. Confirming changes to the next point's
+ * view or after the last point performs the adjustment and returns to the menu. If the
+ * adjustment is rejected the view stays and shows the last point failed.
+ */
+static void Charger_CalibratePoint(uint8_t point)
+{
+    uint8_t isAdjusted;
+
+    if(CAPTURE_RUNNING == calib.captureState)
+        return;
+
+    if(CAPTURE_ACCEPTED != calib.captureState)
+    {
+        Charger_StartCapture(point, 0);
+        return;
+    }
+
+    calib.captureState = CAPTURE_IDLE;
+
+    if(point < (CALIBRATION_POINT_COUNT - 1))
+    {
+        Menu_ChangeToView(&menu, (enum E_MenuStates)(CALIBRATION_VIEW_1 + point + 1));
+        return;
+    }
+
+    /* Control interrupt skips conversion while adjustment values are being changed */
+    /* Even channels measure voltage and odd ones current, a batch has only one of them */
+    adjustmentSequence++;
+    isAdjusted = Adjustment_MakeAdjustment(&measInfo, &calib, CALIBRATION_POINTS[calib.measToCalibrate % 2]);
+    adjustmentSequence++;
+
+    /* A rejected adjustment is shown in the view of the last point and the point can be
+     * captured again or the menu left                                                 */
+    if(!isAdjusted)
+    {
+        calib.captureState = CAPTURE_FAILED;
+        return;
+    }
+
+    Menu_ChangeToView(&menu, MENU_VIEW_1);
+}
+
+
+/*
+ * Reads the next button click, updates menu view and performs the action given by the menu.
+ */
+static void Charger_MenuTask(void)
+{
+    enum E_ButtonClicks buttonClick = NO_CLICK; /* Button state       */
+    T_ButtonEvent       buttonEvent;            /* Latest click event */
+    uint8_t             menuAction;             /* Action to perform defined by menu module */
+
+    PROFILER_START(PROFILER_MENU);
+
+    Charger_ReadControlSnapshot();
+
+    if(Button_GetEvent(&buttonEvent))
+        buttonClick = (enum E_ButtonClicks)buttonEvent.click;
+
+    /* At night a click only wakes the charger up */
+    if(isNightMode && (NO_CLICK != buttonClick))
+    {
+        Charger_LeaveNightMode();
+        buttonClick = NO_CLICK;
+    }
+
+    menuAction = Menu_UpdateView(&menu, buttonClick, measInfo.measResults, measInfo.changedResults, &calib);
+
+    /* Perform action given by menu module */
+    switch(menuAction)
+    {
+    case MENU_NO_ACTION:
+        break;
+
+    case MENU_MEASURE_1:
+    case MENU_MEASURE_2:
+    case MENU_MEASURE_3:
+
+        /* Capture or confirm given measurement's calibration point */
+        Charger_CalibratePoint(menuAction - MENU_MEASURE_1);
+        break;
+
+    case MENU_SAVE:
+        Adjustment_SaveAdjustmentToFlash(&measInfo);
+        break;
+
+    case MENU_PROFILER_RESET:
+        PROFILER_RESET();
+        break;
+
+    case MENU_CANCEL:
+
+        /* In case of cancel reload previous adjustment data from factory defaults and FLASH */
+        adjustmentSequence++;
+        Adjustment_GetCurrentAdjustment(&measInfo);
+        adjustmentSequence++;
+        break;
+
+    default:
+
+        /* Numbers 0-9 and the panel voltage batch get here indicating which measurements will
+         * be calibrated and adjusted. Menu module has already set them to calibration info,
+         * a capture or captured points of the console are dropped.                          */
+        capture.remaining  = 0;
+        calib.captureState = CAPTURE_IDLE;
+        consolePoints      = 0;
+        break;
+    }
+
+    Charger_UpdateCapture();
+
+    /* Collect text fields menu has changed until the next screen update. A click is shown
+     * on the screen at once instead of waiting for the next screen update.             */
+    redrawFields |= menu.dirtyFields;
+
+    if((NO_CLICK != buttonClick) && (0 != menu.dirtyFields))
+        Scheduler_ReleaseTask(&taskStatus[LCD_TASK]);
+
+    PROFILER_END(PROFILER_MENU);
+}
+
+
+/*
+ * Redraws the text fields that have changed since the previous screen update. At night the
+ * changes are collected until the screen is woken up.
+ */
+static void Charger_LCDTask(void)
+{
+    if(isNightMode)
+        return;
+
+    PROFILER_START(PROFILER_LCD);
+
+    LCD_UpdateScreen(menu.views[menu.menuState].textFields, menu.views[menu.menuState].textFieldCount,
+                     menu.updatableCharTables, redrawFields);
+
+    PROFILER_END(PROFILER_LCD);
+
+    redrawFields = 0;
+}
+
+
+/*
+ * TODO: Sometimes the LCD screen has shut down unexpectedly and initializing it again
+ * every now and then seems to prevent it. This behaviour should be given a deeper
+ * investagion. As the screen contents may be lost the whole screen is redrawn after it.
+ * At night the screen is left sleeping.
+ */
+static void Charger_LCDInitTask(void)
+{
+    if(isNightMode)
+        return;
+
+    LCD_Initialize();
+    redrawFields = ALL_TEXT_FIELDS;
+}
+
+
+/*
+ * Adds the energy charged to the battery during one power task period of a second to the
+ * energy counter in no-init RAM.
+ */
+static void Charger_CountEnergy(void)
+{
+    uint32_t millijoules = warmEnergy.millijoules;
+
+    /* Power in milliwatts for a second gives millijoules */
+    millijoules += ((uint32_t)measInfo.measResults[BATTERY_VOLTAGE] * measInfo.measResults[BATTERY_CURRENT]) / 1000;
+
+    warmEnergy.joules      += millijoules / 1000;
+    warmEnergy.millijoules  = millijoules % 1000;
+    warmEnergy.checksum     = Charger_Checksum(&warmEnergy, offsetof(T_WarmEnergy, checksum));
+}
+
+
+/*
+ * Callback of the night timer from the tick interrupt. A one-shot timer is freed when it
+ * expires so it's forgotten here.
+ */
+static void Charger_NightTimerExpired(void)
+{
+    nightTimer = TIMER_NONE;
+    isNightDue = 1;
+}
+
+
+/*
+ * Stops the night timer if it's running and forgets an expiry that hasn't been acted on yet.
+ * Interrupts are disabled so that the timer can't expire and be freed between the check and
+ * the stop.
+ */
+static void Charger_StopNightTimer(void)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+
+    if(TIMER_NONE != nightTimer)
+    {
+        Timer_Stop(nightTimer);
+        nightTimer = TIMER_NONE;
+    }
+
+    isNightDue = 0;
+
+    Hal_RestoreInterrupts(interruptState);
+}
+
+
+/*
+ * Enters night mode when all panel voltages have stayed below battery voltage for
+ * nightDelayMs. The delay is a one-shot software timer started when the sun is first seen
+ * down and stopped when it's up again. If the timer pool is full it's tried again on the next
+ * period. At night measures once each period and leaves night mode at dawn. While the sun is
+ * up counts the energy charged to the battery.
+ */
+static void Charger_PowerTask(void)
+{
+    if(isNightMode)
+    {
+        Charger_MeasureAtNight();
+        Charger_ReadControlSnapshot();
+
+        if(!Charger_IsSunDown(measInfo.measResults))
+            Charger_LeaveNightMode();
+    }
+    else if(!Charger_IsSunDown(measInfo.measResults))
+    {
+        Charger_StopNightTimer();
+        Charger_CountEnergy();
+    }
+    else if(isNightDue)
+    {
+        isNightDue = 0;
+        Charger_EnterNightMode();
+    }
+    else if(TIMER_NONE == nightTimer)
+    {
+        nightTimer = Timer_Start(nightDelayMs, 0, Charger_NightTimerExpired);
+    }
+}
+
+
+/*
+ * Filters the finished zero current blocks of the panels and moves the offsets of their current
+ * channels to the filtered zeros. An offset is marked to be saved only when it has moved enough
+ * from the saved one so that FLASH isn't worn by the noise. Then the next block is started.
+ * Blocks are left out while a channel is being calibrated as a reference current may be
+ * connected.
+ */
+static void Charger_ZeroTask(void)
+{
+    uint8_t  panel;
+    uint8_t  channel;
+    int32_t  difference;
+
+    if(zero.count < ZERO_BLOCK_SAMPLES)
+        return;
+
+    if((menu.menuState >= CALIBRATION_VIEW_1) && (menu.menuState <= CALIBRATION_VIEW_3))
+        zero.validMask = 0;
+
+    /* Control interrupt skips conversion while adjustment values are being changed */
+    adjustmentSequence++;
+
+    for(panel = 0; panel < 4; panel++)
+    {
+        if(!(zero.validMask & (1 << panel)))
+            continue;
+
+        if(0 == zero.zeros[panel])
+            zero.zeros[panel] = zero.sums[panel];
+        else
+        {
+            difference         = (int32_t)zero.sums[panel] - zero.zeros[panel];
+            zero.zeros[panel] += difference / ZERO_FILTER_DIVIDER;
+        }
+
+        channel = PANEL_1_CURRENT + (2 * panel);
+
+        if(Adjustment_SetZero(&measInfo, channel, zero.zeros[panel]))
+            zero.unsavedMask |= 1 << panel;
+    }
+
+    adjustmentSequence++;
+
+    for(panel = 0; panel < 4; panel++)
+        zero.sums[panel] = 0;
+
+    zero.validMask = 0x0F;
+    zero.count     = 0;
+}
+
+
+/*
+ * Sends a telemetry record when one is due. The payload is, multi-byte values little-endian:
+ *
+ *   offset  size  contents
+ *        0     4  millisecond clock
+ *        4     4  control runs
+ *        8    22  raw ADC counts of the 10 measurement channels in their order and the NTC
+ *       30    22  converted measurements: mV, mA and battery temperature in 0.1 C
+ *       52     2  late ticks
+ *       54     2  ADC overruns
+ *       56     4  duty cycles of panels 1-4
+ *       60     1  charging state
+ *       61     1  status bits: TELEMETRY_NIGHT_MODE
+ *
+ * Converted measurements are the foreground's copy read by the menu task. Raw counts are read
+ * while the next sequence may be converting so they can be from two sequences. A record that
+ * doesn't fit to the UART ring is dropped.
+ */
+static void Charger_TelemetryTask(void)
+{
+    uint32_t controlRuns;
+    uint8_t  duties[4];
+    uint8_t  i;
+
+    if(!Telemetry_IsDue(Timer_GetMilliseconds()))
+        return;
+
+    if(!Telemetry_StartRecord(TELEMETRY_RECORD_LENGTH))
+        return;
+
+    /* Control interrupt counts the runs so the 32-bit value is read again if it changed */
+    do
+        controlRuns = controlStatus.runs;
+    while(controlRuns != controlStatus.runs);
+
+    Telemetry_PutLong(Timer_GetMilliseconds());
+    Telemetry_PutLong(controlRuns);
+
+    for(i = 0; i < 10; i++)
+        Telemetry_PutWord(measInfo.rawMeas[MEAS_LOOKUP_TABLE[i]]);
+
+    Telemetry_PutWord(measInfo.rawMeas[TEMPERATURE_RAW_INDEX]);
+
+    for(i = 0; i <= BATTERY_TEMPERATURE; i++)
+        Telemetry_PutWord(measInfo.measResults[i]);
+
+    Telemetry_PutWord(controlStatus.lateTicks);
+    Telemetry_PutWord(controlStatus.adcOverruns);
+
+    PWM_GetDuties(duties);
+
+    for(i = 0; i < 4; i++)
+        Telemetry_PutByte(duties[i]);
+
+    Telemetry_PutByte(chargingState);
+    Telemetry_PutByte(isNightMode ? TELEMETRY_NIGHT_MODE : 0);
+
+    Telemetry_EndRecord();
+}
+
+
+/*
+ * Shows a battery voltage limit in millivolts or sets it, "vmin [mV]" and "vcharge [mV]". Each
+ * limit has it's own range in CONSOLE_LIMIT_RANGES.
+ */
+static uint8_t Charger_ConsoleLimit(uint8_t limit, uint8_t argumentCount, const int32_t * pArguments, uint8_t line)
+{
+    if(argumentCount > 1)
+        return CONSOLE_ERROR;
+
+    if(1 == argumentCount)
+    {
+        if((pArguments[0] < CONSOLE_LIMIT_RANGES[limit][0]) || (pArguments[0] > CONSOLE_LIMIT_RANGES[limit][1]))
+            return CONSOLE_ERROR;
+
+        PWM_SetLimit(limit, pArguments[0]);
+    }
+
+    Console_PutNumber(PWM_GetLimit(limit));
+
+    return CONSOLE_DONE;
+}
+
+
+/*
+ * Shows a click timing in milliseconds or sets it, "debounce [ms]", "long [ms]", "double [ms]"
+ * and "repeat [ms]". A press shorter than the long click timing is a short click.
+ */
+static uint8_t Charger_ConsoleTiming(uint8_t timing, uint8_t argumentCount, const int32_t * pArguments, uint8_t line)
+{
+    if(argumentCount > 1)
+        return CONSOLE_ERROR;
+
+    if(1 == argumentCount)
+    {
+        if((pArguments[0] < CONSOLE_TIMING_MIN) || (pArguments[0] > CONSOLE_TIMING_MAX))
+            return CONSOLE_ERROR;
+
+        Button_SetTiming(timing, pArguments[0]);
+    }
+
+    Console_PutNumber(Button_GetTiming(timing));
+
+    return CONSOLE_DONE;
+}
+
+
+/*
+ * Shows the period of the telemetry records in milliseconds or sets it, "period [ms]". Period
+ * 0 stops the records, which leaves the UART to the console.
+ */
+static uint8_t Charger_ConsolePeriod(uint8_t index, uint8_t argumentCount, const int32_t * pArguments, uint8_t line)
+{
+    if(argumentCount > 1)
+        return CONSOLE_ERROR;
+
+    if(1 == argumentCount)
+    {
+        if((pArguments[0] < 0) || (pArguments[0] > CONSOLE_PERIOD_MAX))
+            return CONSOLE_ERROR;
+
+        Telemetry_SetPeriod(pArguments[0]);
+    }
+
+    Console_PutNumber(Telemetry_GetPeriod());
+
+    return CONSOLE_DONE;
+}
+
+
+/*
+ * Shows the time in milliseconds all panel voltages have to stay below battery voltage before
+ * night mode or sets it, "night [ms]". A delay that is running is stopped and the power task
+ * starts it again with the new time.
+ */
+static uint8_t Charger_ConsoleNight(uint8_t index, uint8_t argumentCount, const int32_t * pArguments, uint8_t line)
+{
+    if(argumentCount > 1)
+        return CONSOLE_ERROR;
+
+    if(1 == argumentCount)
+    {
+        if((pArguments[0] < CONSOLE_NIGHT_MIN) || (pArguments[0] > CONSOLE_NIGHT_MAX))
+            return CONSOLE_ERROR;
+
+        nightDelayMs = pArguments[0];
+        Charger_StopNightTimer();
+    }
+
+    Console_PutNumber(nightDelayMs);
+
+    return CONSOLE_DONE;
+}
+
+
+/*
+ * Calibrates a channel against values measured with a reference meter. The points are captured
+ * one at a time like in the menu: "cal <channel> <point> <value>" starts the capture of point
+ * 1-3 with it's value in millivolts or milliamperes, "cal" shows the state of the latest
+ * capture and it's mean and noise in the channel's unit and, once the three points are
+ * accepted, "cal <channel>" adjusts the channel. The values must grow with the points. Like a
+ * calibration from the menu the adjustment is saved with "save". The capture isn't started
+ * while the menu's calibration views are open and it wakes the charger from night mode.
+ */
+static uint8_t Charger_ConsoleCalibrate(uint8_t index, uint8_t argumentCount, const int32_t * pArguments, uint8_t line)
+{
+    static const char * const CAPTURE_STATES[5] = { "idle", "running", "accepted", "refused", "failed" };
+    uint8_t                   channel;
+    uint8_t                   point;
+    uint8_t                   isAdjusted;
+
+    if(0 == argumentCount)
+    {
+        Console_PutNumber(calib.capturePoint + 1);
+        Console_PutText(" ");
+        Console_PutText(CAPTURE_STATES[calib.captureState]);
+
+        if((CAPTURE_ACCEPTED == calib.captureState) || (CAPTURE_REFUSED == calib.captureState))
+        {
+            Console_PutText(" ");
+            Console_PutNumber(calib.captureMean);
+            Console_PutText(" ");
+            Console_PutNumber(calib.captureNoise);
+        }
+
+        return CONSOLE_DONE;
+    }
+
+    if((2 == argumentCount) || (pArguments[0] < PANEL_1_VOLTAGE) || (pArguments[0] > BATTERY_CURRENT))
+        return CONSOLE_ERROR;
+
+    channel = pArguments[0];
+
+    if(1 == argumentCount)
+    {
+        if((((1 << CALIBRATION_POINT_COUNT) - 1) != consolePoints) || (channel != calib.measToCalibrate))
+            return CONSOLE_ERROR;
+
+        for(point = 1; point < CALIBRATION_POINT_COUNT; point++)
+        {
+            if(consoleReferences[point] <= consoleReferences[point - 1])
+                return CONSOLE_ERROR;
+        }
+
+        /* Control interrupt skips conversion while adjustment values are being changed */
+        adjustmentSequence++;
+        isAdjusted = Adjustment_MakeAdjustment(&measInfo, &calib, consoleReferences);
+        adjustmentSequence++;
+
+        if(!isAdjusted)
+            return CONSOLE_ERROR;
+
+        consolePoints = 0;
+
+        Console_PutText("ok");
+
+        return CONSOLE_DONE;
+    }
+
+    if((pArguments[1] < 1) || (pArguments[1] > CALIBRATION_POINT_COUNT) || (pArguments[2] < 0) || (pArguments[2] > 0xFFFF))
+        return CONSOLE_ERROR;
+
+    if(((menu.menuState >= CALIBRATION_VIEW_1) && (menu.menuState < (CALIBRATION_VIEW_1 + CALIBRATION_POINT_COUNT))) ||
+       (CAPTURE_RUNNING == calib.captureState))
+    {
+        return CONSOLE_ERROR;
+    }
+
+    if(isNightMode)
+        Charger_LeaveNightMode();
+
+    /* Points of another channel are dropped */
+    if((channel != calib.measToCalibrate) || (1 != calib.channelCount))
+        consolePoints = 0;
+
+    point = pArguments[1] - 1;
+
+    calib.measToCalibrate    = channel;
+    calib.channelCount       = 1;
+    consoleReferences[point] = pArguments[2];
+    consolePoints           &= ~(1 << point);
+
+    Charger_StartCapture(point, 1);
+
+    Console_PutNumber(point + 1);
+    Console_PutText(" running");
+
+    return CONSOLE_DONE;
+}
+
+
+/*
+ * Saves the adjusted channels to FLASH memory, "save".
+ */
+static uint8_t Charger_ConsoleSave(uint8_t index, uint8_t argumentCount, const int32_t * pArguments, uint8_t line)
+{
+    if(0 != argumentCount)
+        return CONSOLE_ERROR;
+
+    Adjustment_SaveAdjustmentToFlash(&measInfo);
+
+    Console_PutText("ok");
+
+    return CONSOLE_DONE;
+}
+
+
+/*
+ * Writes the state of the charger a line at a time, "dump". The lines are the voltages and
+ * the currents of panels 1-4 and the battery, the charging state with the night mode and the
+ * battery temperature, the duty cycles, the reset cause with the crystal checks and the time
+ * to the first PWM update in us, the deadline overruns and the longest run in ms of each task,
+ * and the late ticks, ADC overruns and dropped telemetry records.
+ */
+static uint8_t Charger_ConsoleDump(uint8_t index, uint8_t argumentCount, const int32_t * pArguments, uint8_t line)
+{
+    uint8_t duties[4];
+    uint8_t i;
+
+    if(0 != argumentCount)
+        return CONSOLE_ERROR;
+
+    switch(line)
+    {
+    case 0:
+    case 1:
+
+        /* Voltages are the even measurements and currents the odd ones */
+        Console_PutText((0 == line) ? "volt" : "curr");
+
+        for(i = line; i <= BATTERY_CURRENT; i += 2)
+        {
+            Console_PutText(" ");
+            Console_PutNumber(measInfo.measResults[i]);
+        }
+        break;
+
+    case 2:
+        Console_PutText("state ");
+        Console_PutNumber(chargingState);
+        Console_PutText(" night ");
+        Console_PutNumber(isNightMode);
+        Console_PutText(" temp ");
+        Console_PutNumber((int16_t)measInfo.measResults[BATTERY_TEMPERATURE]);
+        break;
+
+    case 3:
+        PWM_GetDuties(duties);
+
+        Console_PutText("duty");
+
+        for(i = 0; i < 4; i++)
+        {
+            Console_PutText(" ");
+            Console_PutNumber(duties[i]);
+        }
+        break;
+
+    case 4:
+        Console_PutText("boot ");
+        Console_PutNumber(bootStatus.resetCause);
+        Console_PutText(" warm ");
+        Console_PutNumber(bootStatus.isWarmRestart);
+        Console_PutText(" checks ");
+        Console_PutNumber(bootStatus.crystalChecks);
+        Console_PutText(" pwm ");
+        Console_PutNumber(bootStatus.firstPwmMicroseconds);
+        break;
+
+    default:
+
+        /* A line for each task in the order of the task table, the last line ends the reply */
+        i = line - DUMP_TASK_LINE;
+
+        if(i < TASK_COUNT)
+        {
+            Console_PutText("task ");
+            Console_PutNumber(i);
+            Console_PutText(" over ");
+            Console_PutNumber(taskStatus[i].overruns);
+            Console_PutText(" max ");
+            Console_PutNumber(taskStatus[i].maxDuration);
+            break;
+        }
+
+        Console_PutText("late ");
+        Console_PutNumber(controlStatus.lateTicks);
+        Console_PutText(" adc ");
+        Console_PutNumber(controlStatus.adcOverruns);
+        Console_PutText(" drop ");
+        Console_PutNumber(Telemetry_GetDropped());
+
+        return CONSOLE_DONE;
+    }
+
+    return CONSOLE_MORE;
+}
+
+
+/*
+ * Commands of the console with the index each handler gets.
+ */
+static const T_ConsoleCommand CONSOLE_COMMANDS[CONSOLE_COMMAND_COUNT] = { { "vmin",     Charger_ConsoleLimit,     PWM_LIMIT_MINIMUM   },
+                                                                          { "vcharge",  Charger_ConsoleLimit,     PWM_LIMIT_CHARGE    },
+                                                                          { "debounce", Charger_ConsoleTiming,    BUTTON_DEBOUNCE     },
+                                                                          { "long",     Charger_ConsoleTiming,    BUTTON_LONG_CLICK   },
+                                                                          { "double",   Charger_ConsoleTiming,    BUTTON_DOUBLE_CLICK },
+                                                                          { "repeat",   Charger_ConsoleTiming,    BUTTON_REPEAT       },
+                                                                          { "period",   Charger_ConsolePeriod,    0                   },
+                                                                          { "night",    Charger_ConsoleNight,     0                   },
+                                                                          { "cal",      Charger_ConsoleCalibrate, 0                   },
+                                                                          { "save",     Charger_ConsoleSave,      0                   },
+                                                                          { "dump",     Charger_ConsoleDump,      0                   } };
+
+
+/*
+ * Runs the commands received over the UART. Parsing is done here in the background so it
+ * never delays the control interrupt.
+ */
+static void Charger_ConsoleTask(void)
+{
+    Console_Process(CONSOLE_COMMANDS, CONSOLE_COMMAND_COUNT);
+}
+
+
+/*
+ * Tasks of the program in priority order with their periods and deadlines in milliseconds.
+ * Indexes of the table are defined in CONSTANTS. All tasks are due at boot so the first pass
+ * sets up the menu and initializes the LCD before the first screen update.
+ */
+static const T_Task TASKS[TASK_COUNT] = { { Charger_MenuTask,       50,   50 },    /* MENU_TASK      */
+                                          { Charger_LCDInitTask,  5000,  200 },    /* LCD_INIT_TASK  */
+                                          { Charger_LCDTask,       200,  200 },    /* LCD_TASK       */
+                                          { Charger_PowerTask,    1000,  200 },    /* POWER_TASK     */
+                                          { Charger_ZeroTask,      100,  100 },    /* ZERO_TASK      */
+                                          { Charger_TelemetryTask,  10,   50 },    /* TELEMETRY_TASK */
+                                          { Charger_ConsoleTask,    20,  100 } };  /* CONSOLE_TASK   */
+
+
+/*
+ * System tick from the overflow interrupt of Timer_A, started by the period interrupt of the
+ * Timer module. Runs the control loop every CONTROL_PERIOD_TICKS ticks, advances the
+ * millisecond clock, samples the button and wakes up the scheduler from LPM0 or LPM3. Control
+ * is run first so that it's started at a fixed rate from the crystal. At night control is
+ * stopped. Interrupts are enabled meanwhile so the periods are counted while the tick runs.
+ */
+#pragma vector=TIMERA1_VECTOR
+__interrupt void Charger_TickISR(void)
+{
+    static uint8_t controlTicks = CONTROL_PERIOD_TICKS - 1; /* Control on the first tick */
+
+    PROFILER_MARK_TICK();
+
+    Timer_BeginTick();
+
+    if(++controlTicks >= CONTROL_PERIOD_TICKS)
+    {
+        controlTicks = 0;
+
+        if(!isNightMode)
+            Charger_RunControl();
+    }
+
+    Timer_Tick();
+
+    PROFILER_START(PROFILER_BUTTON);
+    Button_Sample(Hal_IsButtonDown(), Timer_GetMilliseconds());
+    PROFILER_END(PROFILER_BUTTON);
+
+    /* The next tick came while this one was running */
+    if(Timer_EndTick())
+        controlStatus.lateTicks++;
+
+    Hal_WakeFromInterrupt(LPM3_bits);
+}
+
+
+/*
+ * USCI A0 and B0 share the transmit interrupt. B0 sends the LCD's transfers over SPI and A0 the
+ * UART ring.
+ */
+#pragma vector=USCIAB0TX_VECTOR
+__interrupt void USCI0TX_ISR(void)
+{
+    if(Hal_SpiIsTxReady())
+        LCD_TransmitNext();
+
+    if(Hal_UartIsTxReady())
+        Uart_TransmitNext();
+}
+
+
+/*
+ * First initializes devices and variables, then controls the overall flow of the program
+ * by running the tasks with the scheduler. CPU sleeps between the ticks when no task is due.
+ */
+void main(void)
+{
+    /*                                            DEVICE CONFIGURATION                                                        */
+
+    /* Stop watchdog timer */
+    WDTCTL = WDTPW + WDTHOLD;
+
+    /* Initialize pins and clocks */
+    Charger_InitializePins();
+    Charger_InitializeClocks();
+
+    /* After a warm restart charging continues at once from the DCO until the crystal is stable */
+    Charger_CheckWarmRestart();
+
+    if(bootStatus.isWarmRestart)
+    {
+        Charger_InitializeTimers(TASSEL_2);
+        PWM_RestoreState(warmControl.chargingState, warmControl.duties);
+    }
+
+    /*                                        INITIALIZATION OF USED VARIABLES                                                */
+
+    /* Gets current calibration info by first setting the "factory" values and then checking if new calibration data is found in FLASH.
+     * This is done while the crystal stabilizes and before control is started so no adjustment sequence is needed.                  */
+    Adjustment_GetCurrentAdjustment(&measInfo);
+
+    /* Charging starts in device initialization, LCD and menu are set up by the tasks */
+    Charger_InitializeDevices();
+
+    /* Profiling starts once the timers run from the crystal. Compiles to nothing without PROFILER. */
+    PROFILER_INITIALIZE();
+
+    Scheduler_Initialize(taskStatus, TASK_COUNT);
+
+    /* Watchdog resets the device if the main loop hasn't run for 32768 SMCLK cycles, 16 ms with
+     * the 2 MHz SMCLK of the day and 262 ms at night. A hang with interrupts disabled or inside
+     * an interrupt is caught as well.                                                        */
+    Hal_WatchdogStart(HAL_WATCHDOG_SMCLK);
+
+    /*                                                 MAIN LOOP                                                                */
+    while(1)
+    {
+        Scheduler_RunDueTasks(TASKS, taskStatus, TASK_COUNT);
+
+        /* Service the watchdog */
+        Hal_WatchdogClear();
+    }
+}
@@ -2,12 +2,13 @@
  * Charger.h
  *
  * The charger module is in control of initializing the system and controlling the program
- * flow with a while(1) loop. In the loop ADC measurements and button states are read as
- * inputs and submodules are called with specific input parameters to control the state of
- * each subsystem. Also control of calibrating a measurement channel is included in Charger
+ * flow with tasks run by the scheduler. In the tasks ADC measurements and button states are
+ * read as inputs and submodules are called with specific input parameters to control the
+ * state of each subsystem. Also control of calibrating a measurement channel is included in Charger
  * module though adjustment has it's own module.
  *
- * Header file includes necessary submodule headers and Common.h for common data types.
+ * Header file includes necessary submodule headers and Common.h for common data types. It
+ * also defines the data types shared between the control interrupt and the foreground tasks.
  *
  *    Part of: Charger project
  * Created on: 7.8.2015
@@ -24,9 +25,154 @@
  ****************************************************************************************************/
 
 #include "Adjustment.h"
+#include "Button.h"
 #include "Common.h"
+#include "Console.h"
 #include "PWM.h"
 #include "LCD.h"
 #include "Menu.h"
+#include "Profiler.h"
+#include "Scheduler.h"
+#include "Telemetry.h"
+#include "Timer.h"
+#include "Uart.h"
+
+
+/****************************************************************************************************
+ *                                           DATA TYPES
+ ****************************************************************************************************/
+
+
+/*
+ * Latest results of the control loop published by the control interrupt. The interrupt is the
+ * only writer and it makes sequence odd for the time it's writing. A reader copies the data and
+ * retries if sequence changed meanwhile, so the reader never has to disable interrupts.
+ */
+typedef struct
+{
+    uint16_t sequence;
+    uint16_t measResults[10];
+    int8_t   chargingState;
+} T_ControlSnapshot;
+
+
+/*
+ * Timing statistics of the control loop. Control runs at the start of every second system
+ * tick so it's start jitter is bounded by the longest other interrupt. Late ticks count the
+ * times the tick interrupt took longer than a tick and delayed the following one. ADC overruns
+ * count the times the previous sequence of conversions hadn't finished when control was due.
+ */
+typedef struct
+{
+    uint32_t runs;
+    uint16_t lateTicks;
+    uint16_t adcOverruns;
+} T_ControlStatus;
+
+/*
+ * A capture of a calibration point. The control interrupt takes the raw value of the channel on
+ * every control run until remaining counts down to zero. Samples are summed relative to the
+ * reference so that the sums stay small, samples further than window from it are left out.
+ * The first pass takes all samples, the second pass only the ones within three standard
+ * deviations of the first pass mean. Channel is the index of the captured channel in a batch
+ * and measIndex it's index in the corrected raw measurements.
+ * A capture started from the console isn't tied to the menu's calibration views.
+ */
+typedef struct
+{
+    volatile uint16_t remaining;
+    uint16_t          count;
+    uint16_t          reference;
+    uint16_t          window;
+    int32_t           sum;
+    uint32_t          sumSquares;
+    uint8_t           measIndex;
+    uint8_t           pass;
+    uint8_t           channel;
+    uint8_t           isConsole;
+} T_CalibrationCapture;
+
+
+/*
+ * Tracking of the panel currents' zero. The control interrupt sums the raw panel currents of
+ * ZERO_BLOCK_SAMPLES control runs, a panel's sum is valid if it's PWM was off during the whole
+ * block. The foreground filters the valid blocks into zeros and sets count back to zero. The
+ * low nibble of offMasks has the panels with PWM off after the latest run and the high nibble
+ * after the run before it. unsavedMask has the panels whose offset waits to be saved at night.
+ */
+typedef struct
+{
+    uint16_t          sums[4];
+    volatile uint8_t  count;
+    uint8_t           validMask;
+    uint8_t           offMasks;
+    uint8_t           unsavedMask;
+    uint16_t          zeros[4];    /* Filtered zero currents in 1/64 ADC counts, 0 before the first block */
+} T_ZeroTracking;
+
+
+/*
+ * Correction of the supply voltage. The raw measurements are relative to Vcc and they are scaled
+ * to the nominal supply with scale which is filtered Vcc relative to the nominal in 1/4096 units.
+ * Runs counts the control runs so that Vcc is measured once in 256 runs.
+ */
+typedef struct
+{
+    uint16_t filtered;    /* Filtered Vcc measurement in 1/16 ADC counts, 0 before the first one */
+    uint16_t scale;
+    uint8_t  runs;
+} T_VccCorrection;
+
+
+/*
+ * Reset causes read from the interrupt flags at boot. A brown-out shows as a power-on reset.
+ */
+#define RESET_POWER_ON 0
+#define RESET_PIN      1
+#define RESET_WATCHDOG 2
+
+
+/*
+ * Controller state kept in no-init RAM over resets. Written only by the control interrupt on
+ * every control run. The record is valid if magic and checksum match.
+ */
+typedef struct
+{
+    uint16_t magic;
+    int8_t   chargingState;
+    uint8_t  duties[4];
+    uint16_t checksum;
+} T_WarmControl;
+
+
+/*
+ * Energy counter kept in no-init RAM over resets. Written only by the power task once a second.
+ * Energy charged to the battery is counted in joules and the millijoules of the current joule.
+ */
+typedef struct
+{
+    uint16_t magic;
+    uint32_t joules;
+    uint16_t millijoules;
+    uint16_t checksum;
+} T_WarmEnergy;
+
+
+/*
+ * Reset cause and timing of the boot. After a watchdog or a power-on reset with a valid
+ * controller state in no-init RAM charging continues from that state. Crystal checks are done
+ * every 6 PWM periods, about 48 us, until the crystal is stable. Time to the first PWM update
+ * is measured from the start of the crystal wait to the first tick: Timer_A periods are counted
+ * by polling during the crystal wait and the first sequence of conversions, and the tick adds
+ * it's fixed 516 us. Register writes between the waits are left out, they take a few us.
+ */
+typedef struct
+{
+    uint8_t  resetCause;
+    uint8_t  isWarmRestart;
+    uint16_t crystalChecks;
+    uint32_t periods;
+    uint32_t firstPwmMicroseconds;
+} T_BootStatus;
 
 #endif /* CHARGER_CHARGER_H_ */
@@ -6,10 +6,14 @@
  * other.
  *
  * Includes:
+ * - button click types                          (Button + Charger + Menu)
  * - number representation of measured variables (Menu + PWM)
+ * - battery temperature representation          (Adjustment + Menu + PWM)
  * - calibration point definitions               (Menu + Adjustment)
- * - calibration info data type                  (Adjustment + Charger + Menu)
- * - text field data type                        (Menu + LCD)
+ * - calibration capture states and
+ *   calibration info data type                  (Adjustment + Charger + Menu)
+ * - text field data type, updatable text fields
+ *   and dirty field mask                        (Menu + LCD)
  *
  *       Part of: Charger project
  *  Created on: 5.9.2015
@@ -45,11 +49,59 @@
 #define BATTERY_VOLTAGE    8
 #define BATTERY_CURRENT    9
 
+/* Battery temperature follows the measured variables in results in tenths of a degree Celsius as
+ * a signed value. It's unknown if the sensor is missing.                                      */
+#define BATTERY_TEMPERATURE 10
+#define TEMPERATURE_UNKNOWN 0x7FFF
+
+/* Converted measurements and noises that don't fit to 16 bits are saturated to this value, the
+ * screen shows it as a value that doesn't fit.                                               */
+#define VALUE_SATURATED     0xFFFF
+
+/*
+ * Calibration points definition. Measurement results are in millivolts and milliamperes. Each
+ * channel is calibrated at three points which give two line segments with a breakpoint at the
+ * middle point. The count of points is fixed by the journal in information FLASH: a record's 8
+ * byte payload holds the breakpoint, both slopes and the first intercept, and each further point
+ * would add a breakpoint and a slope, 4 bytes. With four points a segment would hold 4 records
+ * instead of 6 so the three segments would be erased half again as often.
+ */
+#define CALIBRATION_POINT_COUNT   3
+#define CALIBRATION_SEGMENT_COUNT (CALIBRATION_POINT_COUNT - 1)
+
+const static uint16_t CALIBRATION_POINTS[2][CALIBRATION_POINT_COUNT] = { { 2000, 8000, 15000 },    /* Voltage calibration points 1-3 (mV) */
+                                                                         { 1000, 3000,  5000 } };  /* Current calibration points 1-3 (mA) */
+
 /*
- * Calibration points definition.
+ * The voltages of all four panels can be calibrated in a batch from one reference connected to
+ * every panel input. The channels of a batch are every other channel from the first one.
  */
-const static float CALIBRATION_POINTS[2][2] = { { 2.0f, 15.0f },    /* Voltage calibration points 1 and 2 (V) */
-                                                { 1.0f,  5.0f } };  /* Current calibration points 1 and 2 (A) */
+#define CALIBRATION_BATCH_SIZE    4
+
+/*
+ * States of capturing a calibration point. A captured point is accepted if it's noise is low
+ * enough, otherwise it's refused and can be captured again. If the adjustment made from the
+ * accepted points is rejected the last point is failed and can be captured again too.
+ */
+#define CAPTURE_IDLE       0
+#define CAPTURE_RUNNING    1
+#define CAPTURE_ACCEPTED   2
+#define CAPTURE_REFUSED    3
+#define CAPTURE_FAILED     4
+
+/*
+ * A text field with UPDATABLE_DATA as it's char pointer value has it's text in an updatable
+ * char table of UPDATABLE_TEXT_LENGTH chars. The n:th updatable text field of a view uses
+ * the n:th updatable char table.
+ */
+#define UPDATABLE_DATA            0
+#define UPDATABLE_TEXT_LENGTH     8
+
+/*
+ * Dirty field mask telling that all text fields of a view have changed and the whole
+ * screen must be redrawn. A view has at most 15 text fields so the highest bit is free.
+ */
+#define ALL_TEXT_FIELDS           0xFFFF
 
 
 /****************************************************************************************************
@@ -58,15 +110,30 @@ const static float CALIBRATION_POINTS[2][2] = { { 2.0f, 15.0f },    /* Voltage c
 
 
 /*
- * Holds info needed to do a calibration for a single measurement channel.
+ * Defines button click states
+ */
+enum E_ButtonClicks { NO_CLICK, SHORT_CLICK, LONG_CLICK, DOUBLE_CLICK, REPEAT_CLICK };
+
+
+/*
+ * Holds info needed to do a calibration for a single measurement channel or a batch of them.
  */
 typedef struct
 {
-    /* Defines which measurement will be calibrated         */
-    uint8_t measToCalibrate;
+    /* Defines which measurement will be calibrated and how many channels from it, every other one, in a batch */
+    uint8_t  measToCalibrate;
+    uint8_t  channelCount;
+
+    /* Calibration point of the latest capture and the state of capturing it */
+    uint8_t  capturePoint;
+    uint8_t  captureState;
+
+    /* Mean and standard deviation of the latest capture in millivolts or milliamperes, the noisiest channel of a batch */
+    uint16_t captureMean;
+    uint16_t captureNoise;
 
-    /* Saves calibration measurement results for two points */
-    float   calibResults[2];
+    /* Saves filtered means of raw calibration measurements for each channel and calibration point in 1/16 ADC counts */
+    uint16_t calibResults[CALIBRATION_BATCH_SIZE][CALIBRATION_POINT_COUNT];
 } T_CalibrationInfo;
 
 
@@ -0,0 +1,272 @@
+/*
+ * Console.c
+ *
+ * Console module parses the lines received by the UART module and runs the commands of the
+ * main module's table. It's called from a background task so parsing never delays the control.
+ * Each call runs at most one command or one line of a longer reply, and only when the UART
+ * ring has room for a whole reply line, so the console never waits for the UART and it's
+ * replies are not dropped. Telemetry records still go to the ring between the reply lines.
+ *
+ * Source includes functionality to:
+ * - split a line to the command name and it's arguments in place
+ * - parse decimal arguments
+ * - find the command in the table and call it's handler for each reply line
+ * - write the reply lines to the UART ring
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include "Console.h"
+#include "Uart.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Longest reply line with it's CR LF. A reply line is started only when the UART ring has room
+ * for this many bytes and longer lines are cut.                                            */
+#define REPLY_LENGTH 48
+
+/* Command index when no command is running */
+#define NO_COMMAND 0xFF
+
+/* Longest argument in digits, so that it fits to 32 bits */
+#define ARGUMENT_DIGITS 9
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+static uint8_t command       = NO_COMMAND;    /* Command whose reply is being written  */
+static uint8_t replyLine     = 0;             /* Reply line the handler writes next    */
+static uint8_t replyLength   = 0;             /* Bytes written to the current line     */
+static uint8_t argumentCount = 0;
+static int32_t arguments[CONSOLE_ARGUMENT_COUNT];
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Returns 1 if the character separates the words of a line.
+ */
+static uint8_t Console_IsSpace(char character)
+{
+    return ((' ' == character) || ('\t' == character)) ? 1 : 0;
+}
+
+
+/*
+ * Returns 1 if two null terminated names are the same.
+ */
+static uint8_t Console_IsSameName(const char * pName, const char * pWord)
+{
+    while(*pName && (*pName == *pWord))
+    {
+        pName++;
+        pWord++;
+    }
+
+    return (*pName == *pWord) ? 1 : 0;
+}
+
+
+/*
+ * Parses a decimal number with an optional minus sign. Returns 0 if the word isn't a number.
+ */
+static uint8_t Console_ParseNumber(const char * pWord, int32_t * pValue)
+{
+    int32_t value   = 0;
+    uint8_t digits  = 0;
+    uint8_t isMinus = 0;
+
+    if('-' == *pWord)
+    {
+        isMinus = 1;
+        pWord++;
+    }
+
+    while(*pWord)
+    {
+        if((*pWord < '0') || (*pWord > '9') || (++digits > ARGUMENT_DIGITS))
+            return 0;
+
+        value = (value * 10) + (*pWord++ - '0');
+    }
+
+    if(0 == digits)
+        return 0;
+
+    *pValue = isMinus ? -value : value;
+
+    return 1;
+}
+
+
+/*
+ * Splits the line to words in place, finds the command of the first word and parses the rest
+ * to arguments. Returns the index of the command or NO_COMMAND if the line isn't a command.
+ */
+static uint8_t Console_ParseLine(char * pLine, const T_ConsoleCommand * pCommands, uint8_t commandCount)
+{
+    char    * pWords[CONSOLE_ARGUMENT_COUNT + 1];
+    uint8_t   wordCount = 0;
+    uint8_t   found     = NO_COMMAND;
+    uint8_t   i;
+
+    while(*pLine)
+    {
+        if(Console_IsSpace(*pLine))
+        {
+            *pLine++ = '\0';
+            continue;
+        }
+
+        if(wordCount > CONSOLE_ARGUMENT_COUNT)
+            return NO_COMMAND;
+
+        pWords[wordCount++] = pLine;
+
+        while(*pLine && !Console_IsSpace(*pLine))
+            pLine++;
+    }
+
+    if(0 == wordCount)
+        return NO_COMMAND;
+
+    for(i = 0; i < commandCount; i++)
+    {
+        if(Console_IsSameName(pCommands[i].pName, pWords[0]))
+            found = i;
+    }
+
+    argumentCount = wordCount - 1;
+
+    for(i = 0; i < argumentCount; i++)
+    {
+        if(!Console_ParseNumber(pWords[i + 1], &arguments[i]))
+            return NO_COMMAND;
+    }
+
+    return found;
+}
+
+
+/*
+ * Ends the reply line and hands it to the UART.
+ */
+static void Console_EndLine(void)
+{
+    Uart_Put('\r');
+    Uart_Put('\n');
+    Uart_Send();
+
+    replyLength = 0;
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Runs a received command or continues the reply of the current one. The line buffer is
+ * released as soon as the line is parsed, the arguments are kept for the following reply lines.
+ */
+void Console_Process(const T_ConsoleCommand * pCommands, uint8_t commandCount)
+{
+    char    * pLine;
+    uint8_t   lineState;
+    uint8_t   result;
+
+    if(Uart_GetFree() < REPLY_LENGTH)
+        return;
+
+    if(NO_COMMAND == command)
+    {
+        lineState = Uart_GetLine(&pLine);
+
+        if(UART_NO_LINE == lineState)
+            return;
+
+        if(UART_LINE == lineState)
+            command = Console_ParseLine(pLine, pCommands, commandCount);
+
+        Uart_ReleaseLine();
+
+        if(NO_COMMAND == command)
+        {
+            Console_PutText("error");
+            Console_EndLine();
+            return;
+        }
+
+        replyLine = 0;
+    }
+
+    Console_PutText(pCommands[command].pName);
+    Console_PutText(" ");
+
+    result = pCommands[command].pfHandler(pCommands[command].index, argumentCount, arguments, replyLine);
+
+    if(CONSOLE_ERROR == result)
+        Console_PutText("error");
+
+    Console_EndLine();
+
+    if(CONSOLE_MORE == result)
+        replyLine++;
+    else
+        command = NO_COMMAND;
+}
+
+
+/*
+ * Writes text to the reply line. Text that doesn't fit to the line is cut.
+ */
+void Console_PutText(const char * pText)
+{
+    while(*pText && (replyLength < (REPLY_LENGTH - 2)))
+    {
+        Uart_Put(*pText++);
+        replyLength++;
+    }
+}
+
+
+/*
+ * Writes a decimal number to the reply line.
+ */
+void Console_PutNumber(int32_t value)
+{
+    char     digits[12];
+    uint8_t  i         = sizeof(digits) - 1;
+    uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+
+    digits[i] = '\0';
+
+    do
+    {
+        digits[--i]  = '0' + (magnitude % 10);
+        magnitude   /= 10;
+    } while(magnitude);
+
+    if(value < 0)
+        digits[--i] = '-';
+
+    Console_PutText(&digits[i]);
+}
@@ -0,0 +1,81 @@
+/*
+ * Console.h
+ *
+ * Console module runs text commands received over the UART. A command is a line of a name and
+ * up to CONSOLE_ARGUMENT_COUNT decimal numbers separated by spaces, for example "vmin 9600".
+ * Commands are defined by the main module in a constant table, the console finds the command
+ * of a line, parses it's arguments and calls it's handler. Nothing is allocated: the line is
+ * parsed in the UART's line buffer and the arguments are kept in a fixed array.
+ *
+ * Every reply line starts with the name of the command so that the replies can be told apart
+ * from each other and from the binary telemetry frames. A line that isn't a command gets the
+ * reply "error" and a command with wrong arguments it's name and "error". A reply is written to
+ * the UART ring only when there is room for a whole line, until then the command waits.
+ *
+ * Header includes:
+ * - results of the command handlers and the command data type
+ * - global functions for processing the received lines and writing the replies
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_CONSOLE_H_
+#define CHARGER_CONSOLE_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Maximum number of arguments of a command */
+#define CONSOLE_ARGUMENT_COUNT 4
+
+/* Results of the command handlers */
+#define CONSOLE_DONE  0    /* Reply is complete                                         */
+#define CONSOLE_MORE  1    /* Handler is called again for the next line of the reply    */
+#define CONSOLE_ERROR 2    /* Arguments were wrong, the handler has written nothing     */
+
+
+/****************************************************************************************************
+ *                                           DATA TYPES
+ ****************************************************************************************************/
+
+
+/*
+ * Defines a single command with it's name and handler. The handler gets the index of the
+ * command, the parsed arguments and the number of the reply line starting from 0. The index
+ * lets a handler serve a group of similar commands.
+ */
+typedef struct
+{
+    const char * const pName;
+    uint8_t      (* const pfHandler)(uint8_t index, uint8_t argumentCount, const int32_t * pArguments, uint8_t line);
+    const uint8_t      index;
+} T_ConsoleCommand;
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/* Runs a received command or continues the reply of the current one */
+void Console_Process(const T_ConsoleCommand * pCommands, uint8_t commandCount);
+
+/* Write the reply line of a command handler */
+void Console_PutText(const char * pText);
+void Console_PutNumber(int32_t value);
+
+
+#endif /* CHARGER_CONSOLE_H_ */
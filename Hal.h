@@ -0,0 +1,485 @@
+/*
+ * Hal.h
+ *
+ * Hardware abstraction layer over the MSP430F2232 registers that the program logic uses at
+ * run time: ADC10 sequences and the Vcc measurement, PWM duty cycles, the USCI SPI and pins of
+ * the LCD, the USCI UART, information FLASH, the button pin, interrupts, low power modes and
+ * the reset. The configuration of the devices at boot is left to the modules as plain register
+ * writes.
+ *
+ * In the target build the layer is static inline functions and macros over the registers so
+ * it adds no code. With HAL_HOST defined the registers are variables of simulated peripherals
+ * in host/HalHost.h and the functions whose hardware behaviour matters are implemented by the
+ * simulation in host/HalHost.c. Functions that only read and write registers are shared by
+ * both builds.
+ *
+ * Header includes:
+ * - the device header or the simulated peripherals
+ * - PWM duty cycle, LCD pin, button, USCI interrupt, UART receive, timer overflow and watchdog
+ *   functions shared by both builds
+ * - interrupt, sleep, ADC10, SPI, UART, FLASH, reset and timer functions of the target build
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_HAL_H_
+#define CHARGER_HAL_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+#ifdef HAL_HOST
+#include "host/HalHost.h"
+#else
+#include <msp430f2232.h>
+#include <intrinsics.h>
+#endif
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+#ifndef HAL_HOST
+
+/* Information memory segments D, C, B and A */
+#define HAL_INFO_FLASH ((const uint8_t *)0x01000)
+
+#endif
+
+/* Timer_A counts from 0 to TACCR0 = 128 in up mode so a PWM period is 129 timer cycles */
+#define HAL_PWM_PERIOD_CYCLES 129
+
+/* Clock sources of the watchdog */
+#define HAL_WATCHDOG_SMCLK 0
+#define HAL_WATCHDOG_ACLK  WDTSSEL
+
+
+/****************************************************************************************************
+ *                                  FUNCTIONS SHARED BY BOTH BUILDS
+ ****************************************************************************************************/
+
+
+/*
+ * Sets the duty cycle of a panel's PWM output. Panels 1 and 2 are on TA2 and TA1 and panels 3
+ * and 4 on TB1 and TB2.
+ */
+static inline void Hal_SetPwmDuty(uint8_t panel, uint8_t duty)
+{
+    switch(panel)
+    {
+    case 0:  TACCR2 = duty; break;
+    case 1:  TACCR1 = duty; break;
+    case 2:  TBCCR1 = duty; break;
+    default: TBCCR2 = duty; break;
+    }
+}
+
+
+/*
+ * Returns the duty cycle of a panel's PWM output.
+ */
+static inline uint8_t Hal_GetPwmDuty(uint8_t panel)
+{
+    switch(panel)
+    {
+    case 0:  return TACCR2;
+    case 1:  return TACCR1;
+    case 2:  return TBCCR1;
+    default: return TBCCR2;
+    }
+}
+
+
+/*
+ * Selects the LCD for a transfer by setting it's chip select pin 4.0 down.
+ */
+static inline void Hal_LcdSelect(uint8_t isSelected)
+{
+    if(isSelected)
+        P4OUT &= ~BIT0;
+    else
+        P4OUT |= BIT0;
+}
+
+
+/*
+ * Sets the LCD's A0 pin 2.5 up for data and down for commands.
+ */
+static inline void Hal_LcdSetDataMode(uint8_t isData)
+{
+    if(isData)
+        P2OUT |= BIT5;
+    else
+        P2OUT &= ~BIT5;
+}
+
+
+/*
+ * Returns 1 if the button on pin 3.2 is pressed, it pulls the pin down.
+ */
+static inline uint8_t Hal_IsButtonDown(void)
+{
+    return !(P3IN & BIT2);
+}
+
+
+/*
+ * Returns 1 if the USCI B0 transmit interrupt is on and it's buffer is empty. USCI A0 and B0
+ * share the transmit interrupt.
+ */
+static inline uint8_t Hal_SpiIsTxReady(void)
+{
+    return ((UC0IE & UCB0TXIE) && (UC0IFG & UCB0TXIFG)) ? 1 : 0;
+}
+
+
+/*
+ * Returns 1 if the USCI A0 transmit interrupt is on and it's buffer is empty.
+ */
+static inline uint8_t Hal_UartIsTxReady(void)
+{
+    return ((UC0IE & UCA0TXIE) && (UC0IFG & UCA0TXIFG)) ? 1 : 0;
+}
+
+
+/*
+ * Enables the USCI A0 receive interrupt. It must be enabled after the USCI is released from
+ * reset as the reset clears it.
+ */
+static inline void Hal_UartEnableRxInterrupt(void)
+{
+    UC0IE |= UCA0RXIE;
+}
+
+
+/*
+ * Reads the received byte from the USCI A0 receive buffer, which clears the receive interrupt.
+ */
+static inline uint8_t Hal_UartRead(void)
+{
+    return UCA0RXBUF;
+}
+
+
+/*
+ * Enables the Timer_A overflow interrupt. The overflow flag is set at the end of every PWM
+ * period so the interrupt comes at once if the flag is already set.
+ */
+static inline void Hal_TimerEnableOverflow(void)
+{
+    TACTL |= TAIE;
+}
+
+
+/*
+ * Disables the Timer_A overflow interrupt and clears it's flag.
+ */
+static inline void Hal_TimerDisableOverflow(void)
+{
+    TACTL &= ~(TAIE + TAIFG);
+}
+
+
+/*
+ * Clears the Timer_A overflow flag in it's interrupt.
+ */
+static inline void Hal_TimerClearOverflow(void)
+{
+    TACTL &= ~TAIFG;
+}
+
+
+/*
+ * Returns 1 and clears the flag if Timer_A has wrapped around since the last call. Counts the
+ * PWM periods by polling while the overflow interrupt is off.
+ */
+static inline uint8_t Hal_TimerPollOverflow(void)
+{
+    if(!(TACTL & TAIFG))
+        return 0;
+
+    TACTL &= ~TAIFG;
+
+    return 1;
+}
+
+
+/*
+ * Starts the watchdog timer in watchdog mode from the given clock, HAL_WATCHDOG_SMCLK or
+ * HAL_WATCHDOG_ACLK. The device is reset unless the watchdog is cleared within 32768 cycles of
+ * the clock.
+ */
+static inline void Hal_WatchdogStart(uint16_t clockSource)
+{
+    WDTCTL = WDTPW + WDTCNTCL + clockSource;
+}
+
+
+/*
+ * Clears the count of the watchdog timer. The clock is kept.
+ */
+static inline void Hal_WatchdogClear(void)
+{
+    WDTCTL = WDTPW + WDTCNTCL + (WDTCTL & WDTSSEL);
+}
+
+
+/****************************************************************************************************
+ *                                     FUNCTIONS OF THE TARGET
+ ****************************************************************************************************/
+
+
+#ifndef HAL_HOST
+
+/*
+ * Disables interrupts and returns the earlier interrupt state for Hal_RestoreInterrupts.
+ */
+static inline uint16_t Hal_DisableInterrupts(void)
+{
+    uint16_t interruptState = __get_SR_register() & GIE;
+
+    __disable_interrupt();
+
+    return interruptState;
+}
+
+
+/*
+ * Restores the interrupt state returned by Hal_DisableInterrupts.
+ */
+static inline void Hal_RestoreInterrupts(uint16_t interruptState)
+{
+    _BIS_SR(interruptState);
+}
+
+
+/*
+ * Enables interrupts.
+ */
+static inline void Hal_EnableInterrupts(void)
+{
+    _BIS_SR(GIE);
+}
+
+
+/*
+ * Sleeps in the low power mode of the given bits with interrupts enabled until an interrupt
+ * wakes the CPU up with Hal_WakeFromInterrupt.
+ */
+static inline void Hal_Sleep(uint16_t sleepBits)
+{
+    _BIS_SR(sleepBits + GIE);
+}
+
+
+/* Clears the low power mode bits from the status register saved by the interrupt. This is a
+ * macro as the intrinsic has to be in the interrupt function itself.                      */
+#define Hal_WakeFromInterrupt(sleepBits) _BIC_SR_IRQ(sleepBits)
+
+
+/*
+ * Resets the device by writing the watchdog control without the password. WDTIFG tells the
+ * cause after the reset.
+ */
+static inline void Hal_Reset(void)
+{
+    WDTCTL = 0;
+}
+
+
+/*
+ * Returns 1 while ADC10 is converting.
+ */
+static inline uint8_t Hal_AdcIsBusy(void)
+{
+    return (ADC10CTL1 & BUSY) ? 1 : 0;
+}
+
+
+/*
+ * Starts a sequence of conversions from channel 14 down to channel 0 against Vcc, the data
+ * transfer controller writes them to the 15 word array. Sample-and-hold time is 16 ADC10CLKs.
+ * The internal reference can be turned on with REFON + REF2_5V in advance of a Vcc measurement,
+ * it doesn't affect conversions against Vcc.
+ */
+static inline void Hal_AdcStartSequence(unsigned int * pRaw, uint16_t reference)
+{
+    ADC10CTL0 &= ~ENC;
+    ADC10CTL1  = INCH_14 + CONSEQ_1;
+    ADC10CTL0  = ADC10SHT_2 + SREF_0 + ADC10ON + MSC + reference;
+    ADC10DTC1  = 15;
+    ADC10SA    = (unsigned int)pRaw;
+    ADC10CTL0 |= ENC + ADC10SC;
+}
+
+
+/*
+ * Starts a single conversion of (Vcc - Vss) / 2 against the internal 2.5 V reference. The data
+ * transfer is off so the result is read from ADC10MEM.
+ */
+static inline void Hal_AdcStartVcc(void)
+{
+    ADC10CTL0 &= ~ENC;
+    ADC10CTL1  = INCH_11;
+    ADC10CTL0  = ADC10SHT_3 + SREF_1 + REFON + REF2_5V + ADC10ON;
+    ADC10DTC1  = 0;
+    ADC10CTL0 |= ENC + ADC10SC;
+}
+
+
+/*
+ * Returns the result of the Vcc conversion.
+ */
+static inline uint16_t Hal_AdcReadVcc(void)
+{
+    return ADC10MEM;
+}
+
+
+/*
+ * Turns ADC10 and the internal reference off.
+ */
+static inline void Hal_AdcOff(void)
+{
+    ADC10CTL0 &= ~ENC;
+    ADC10CTL0 &= ~(ADC10ON + REFON);
+}
+
+
+/*
+ * Enables the USCI B0 transmit interrupt which then sends the LCD buffer byte by byte.
+ */
+static inline void Hal_SpiEnableTxInterrupt(void)
+{
+    UC0IE |= UCB0TXIE;
+}
+
+
+/*
+ * Disables the USCI B0 transmit interrupt.
+ */
+static inline void Hal_SpiDisableTxInterrupt(void)
+{
+    UC0IE &= ~UCB0TXIE;
+}
+
+
+/*
+ * Writes a byte to the USCI B0 transmit buffer.
+ */
+static inline void Hal_SpiWrite(uint8_t data)
+{
+    UCB0TXBUF = data;
+}
+
+
+/*
+ * Enables the USCI A0 transmit interrupt which then sends the UART buffer byte by byte.
+ */
+static inline void Hal_UartEnableTxInterrupt(void)
+{
+    UC0IE |= UCA0TXIE;
+}
+
+
+/*
+ * Disables the USCI A0 transmit interrupt.
+ */
+static inline void Hal_UartDisableTxInterrupt(void)
+{
+    UC0IE &= ~UCA0TXIE;
+}
+
+
+/*
+ * Writes a byte to the USCI A0 transmit buffer.
+ */
+static inline void Hal_UartWrite(uint8_t data)
+{
+    UCA0TXBUF = data;
+}
+
+
+/*
+ * Sets the FLASH timing generator to ACLK divided by 49.
+ */
+static inline void Hal_FlashSetClock(void)
+{
+    FCTL2 = FWKEY + FSSEL_0 + (FN5 + FN4);
+}
+
+
+/*
+ * Writes a single word to FLASH. Interrupts are disabled only for the time of the word write.
+ */
+static inline void Hal_FlashWriteWord(const void * pFlash, uint16_t word)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+
+    FCTL3 = FWKEY;                         /* Clear lock                         */
+    FCTL1 = FWKEY + WRT;                   /* Set write mode                     */
+
+    *(uint16_t *)pFlash = word;
+    while(FCTL3 & BUSY);
+
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY + LOCK;                  /* Set lock                           */
+
+    Hal_RestoreInterrupts(interruptState);
+}
+
+
+/*
+ * Erases the FLASH segment of the given address. Interrupts are disabled for the time of the
+ * erase. The erase takes about 15 ms so the watchdog is held meanwhile and cleared after it.
+ */
+static inline void Hal_FlashEraseSegment(const void * pSegment)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+    uint16_t watchdog       = WDTCTL & 0x00FF;
+
+    WDTCTL = WDTPW + WDTHOLD + watchdog;
+
+    FCTL3 = FWKEY;                         /* Clear lock                         */
+    FCTL1 = FWKEY + ERASE;                 /* Set erase                          */
+
+    *(uint16_t *)pSegment = 0;             /* Dummy write to erase FLASH segment */
+    while(FCTL3 & BUSY);
+
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY + LOCK;                  /* Set lock                           */
+
+    WDTCTL = WDTPW + WDTCNTCL + watchdog;
+
+    Hal_RestoreInterrupts(interruptState);
+}
+
+
+/*
+ * Returns the Timer_A clock cycles from the given count of PWM periods and the timer's count.
+ * If the timer has wrapped around but the period interrupt of CCR0 hasn't counted the period
+ * yet the period is added here. Must be called interrupts disabled.
+ */
+static inline uint32_t Hal_TimerReadCycles(uint32_t periods)
+{
+    uint16_t count = TAR;
+
+    if((TACCTL0 & CCIFG) && (count < (HAL_PWM_PERIOD_CYCLES / 2)))
+        periods++;
+
+    return (periods * HAL_PWM_PERIOD_CYCLES) + count;
+}
+
+#endif /* HAL_HOST */
+
+
+#endif /* CHARGER_HAL_H_ */
@@ -7,11 +7,12 @@
  * bitmap image by converting it with MATLAB into hexadecimal representation.
  *
  * Source includes:
- * - constant parameters needed to initialize to screen and turn it on
+ * - constant parameters needed to initialize to screen and turn it on, sleep and wake up
  * - 8p font in char array hexadecimal representation
  * - device functions to send commands and pixel data to LCD
  * - a helper function to change to a specific row and column of LCD
- * - global functions for turning on LCD screen and updating the screen with text fields
+ * - global functions for turning on LCD screen, sleep mode and updating the screen with text fields
+ * - sending the next byte from the USCI transmit interrupt
  *
  *    Part of: Charger project
  * Created on: 11.7.2015
@@ -24,8 +25,7 @@
  ****************************************************************************************************/
 
 
-#include <msp430f2232.h>
-
+#include "Hal.h"
 #include "LCD.h"
 
 
@@ -57,6 +57,16 @@ const char LCD_INIT[] = { 0x40,    /* Display start line 0               */
                           0xAF };  /* Display on                         */
 
 
+/*
+ * LCD sleep and wake up arrays. Display off followed by all points on sets the sleep mode.
+ */
+const char LCD_SLEEP[] = { 0xAE,    /* Display off                        */
+                           0xA5 };  /* All points on                      */
+
+const char LCD_WAKE[]  = { 0xA4,    /* All points normal                  */
+                           0xAF };  /* Display on                         */
+
+
 /*
  * Font with a height of 8 pixels.
  */
@@ -101,7 +111,8 @@ const char FONT_8P[] = { 0x7E, 0x09, 0x09, 0x09, 0x7E, /*  A    */
                          0x06, 0x49, 0x49, 0x29, 0x1E, /*  9    */
                          0x00, 0x24, 0x00, 0x00, 0x00, /*  :    */
                          0x00, 0x22, 0x14, 0x08, 0x00, /*  >    */
-                         0x00, 0x08, 0x14, 0x22, 0x00  /*  <    */ };
+                         0x00, 0x08, 0x14, 0x22, 0x00, /*  <    */
+                         0x00, 0x08, 0x08, 0x08, 0x00  /*  -    */ };
 
 
 /****************************************************************************************************
@@ -134,17 +145,17 @@ static void LCD_SendCommands(char * data, uint8_t length)
     isTransferReady = 0;
 
     /* Fill the buffer with data */
-    while(i < length)
-        msgBuffer[i] = data[i++];
+    for(i = 0; i < length; i++)
+        msgBuffer[i] = data[i];
 
     msgLength = length;
 
     /* Set down ports that define data transfer and command mode */
-    P4OUT &= ~BIT0;
-    P2OUT &= ~BIT5;
+    Hal_LcdSelect(1);
+    Hal_LcdSetDataMode(0);
 
     /* Enable interrupts for transfer to work */
-    UC0IE |= UCB0TXIE;
+    Hal_SpiEnableTxInterrupt();
 }
 
 
@@ -163,12 +174,12 @@ static inline void LCD_SendData(uint8_t length)
     msgLength = length;
 
     /* Set down the port that indicates data transfer start */
-    P4OUT &= ~BIT0;
+    Hal_LcdSelect(1);
 
     for(i = 0; i < 10; i++);
 
     /* Enable interrupts for transfer to work */
-    UC0IE |= UCB0TXIE;
+    Hal_SpiEnableTxInterrupt();
 }
 
 
@@ -195,31 +206,70 @@ inline void LCD_SetRowColumn(uint8_t row, uint8_t column)
  */
 inline void LCD_Initialize(void)
 {
-    LCD_SendCommands((char*)LCD_INIT, 15);
+    LCD_SendCommands((char*)LCD_INIT, sizeof(LCD_INIT));
+}
+
+
+/*
+ * Put LCD to sleep mode.
+ */
+void LCD_Sleep(void)
+{
+    LCD_SendCommands((char*)LCD_SLEEP, 2);
+}
+
+
+/*
+ * Wake LCD up from sleep mode.
+ */
+void LCD_Wake(void)
+{
+    LCD_SendCommands((char*)LCD_WAKE, 2);
 }
 
 
 /*
  * Updates the screen with an array of text fields. As parametres it takes the pointer
- * to the first element of text field array and the number of text fields in the array.
+ * to the first element of text field array, the number of text fields in the array,
+ * the updatable char tables and a mask of text fields that have changed. Text fields
+ * with UPDATABLE_DATA as their char pointer are drawn from the updatable char tables
+ * in their order. Only the rows (pages) that changed text fields cover are redrawn and
+ * with ALL_TEXT_FIELDS the whole screen is redrawn.
  */
-void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount)
+void LCD_UpdateScreen(const T_TextField * pTextFields, uint8_t textFieldCount,
+                      const char (* pUpdatableTexts)[UPDATABLE_TEXT_LENGTH], uint16_t dirtyFields)
 {
-    uint8_t currentTextField;
-    uint8_t y_end[15];
+    const T_TextField * pFirstTextField = pTextFields;
+    uint8_t             currentTextField;
+    uint8_t             y_end;
+    uint8_t             dirtyRows = 0xFF;
+
+    /* Nothing has changed so there is nothing to draw */
+    if(0 == dirtyFields)
+        return;
+
+    if(ALL_TEXT_FIELDS != dirtyFields)
+        dirtyRows = 0;
 
     /*
-     *  First the vertical direction ending points of each text field are counted as it
-     *  helps determining whether or not the text field should be written to each LCD page.
+     *  First the rows covered by changed text fields are marked to be redrawn. A text field
+     *  covers the rows of it's top pixels and of it's vertical direction ending point.
      */
     for(currentTextField = 0; currentTextField < textFieldCount; currentTextField++)
     {
-        y_end[currentTextField] = pTextFields->y + 8;
+        y_end = pTextFields->y + 8;
+
+        if(dirtyFields & 1)
+            dirtyRows |= (1 << (pTextFields->y >> 3)) | (1 << (y_end >> 3));
+
+        dirtyFields >>= 1;
         pTextFields++;
     }
 
-    uint8_t currentRow;
-    uint8_t bufferPosition;
+    uint8_t      currentRow;
+    uint8_t      bufferPosition;
+    uint8_t      updatableText;
+    const char * charInText;
     uint8_t byteOfChar = 0;
     uint8_t charPosition = 0;
     uint8_t direction = 0;
@@ -229,8 +279,13 @@ void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount)
      */
     for(currentRow = 0; currentRow < 8; currentRow++)
     {
-        /* Always point to the first text field when starting to write a new row */
-        pTextFields -= textFieldCount;
+        /* Rows without changed text fields keep their contents */
+        if(!(dirtyRows & (1 << currentRow)))
+            continue;
+
+        /* Always point to the first text field and updatable char table when starting to write a new row */
+        pTextFields   = pFirstTextField;
+        updatableText = 0;
 
         /* Set the LCD point to the beginning of current row (page) */
         LCD_SetRowColumn(currentRow, 0);
@@ -248,13 +303,20 @@ void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount)
              * it should be translated for the correct position in the row. By default it's set as zero
              * to tell the text field area doesn't cover current row and should not be drawn there */
             direction = 0;
+            y_end     = pTextFields->y + 8;
+
+            /* Point to the first char of text field's char array or updatable char table */
+            charInText = pTextFields->pText;
+
+            if(UPDATABLE_DATA == charInText)
+                charInText = pUpdatableTexts[updatableText++];
 
             /* If top pixels of the text field belong to the current row */
             if((pTextFields->y >= currentRow*8) && (pTextFields->y <= ((currentRow + 1)*8 - 1)))
                 direction = 1;
 
             /* If bottom pixels of the text field belong to the current row */
-            else if(((y_end[currentTextField] + 8) >= currentRow*8) && (y_end[currentTextField] <= ((currentRow + 1)*8 - 1)))
+            else if(((y_end + 8) >= currentRow*8) && (y_end <= ((currentRow + 1)*8 - 1)))
                 direction = 2;
 
             if(direction != 0)
@@ -262,9 +324,6 @@ void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount)
                 /* Change buffer write position to the beginning of current text field */
                 bufferPosition = pTextFields->x;
 
-                /* Point to the first char of text field's char array */
-                char * charInText = pTextFields->pText;
-
                 /* While char array has chars in it */
                 while(*charInText != '\0')
                 {
@@ -284,12 +343,14 @@ void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount)
                         charPosition = 200;
                     else if(60 == *charInText)                            /* Char <                                */
                         charPosition = 205;
+                    else if(45 == *charInText)                            /* Char -                                */
+                        charPosition = 210;
                     else if((44 == *charInText) || (46 == *charInText))   /* , and . both translate to ,           */
                     {
                         if(1 == direction)
                             msgBuffer[bufferPosition] |= (0xC0 << (pTextFields->y - (currentRow*8)));
                         else
-                            msgBuffer[bufferPosition] |= (0xC0 >> (8-(y_end[currentTextField] - (currentRow*8))));
+                            msgBuffer[bufferPosition] |= (0xC0 >> (8-(y_end - (currentRow*8))));
                         bufferPosition += 2;
                     }
                     else if(32 == *charInText)                            /* Space                                 */
@@ -303,7 +364,7 @@ void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount)
                             if(1 == direction)
                                 msgBuffer[bufferPosition + byteOfChar] |= (FONT_8P[charPosition + byteOfChar] << (pTextFields->y - (currentRow*8)));
                             else
-                                msgBuffer[bufferPosition + byteOfChar] |= (FONT_8P[charPosition + byteOfChar] >> (8-(y_end[currentTextField] - (currentRow*8))));
+                                msgBuffer[bufferPosition + byteOfChar] |= (FONT_8P[charPosition + byteOfChar] >> (8-(y_end - (currentRow*8))));
                         }
 
                         bufferPosition += 6;
@@ -321,24 +382,23 @@ void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount)
 
 
 /*
- * Interruption for USCI TX vector puts a new char from the data buffer to TX buffer
+ * Called from the USCI TX interrupt, puts a new char from the data buffer to TX buffer
  * and stops data transfer and interrupts for USCI when the data has been sent.
  */
-#pragma vector=USCIAB0TX_VECTOR
-__interrupt void USCI0TX_ISR(void)
+void LCD_TransmitNext(void)
 {
-       UCB0TXBUF = msgBuffer[msgIndex++];
+       Hal_SpiWrite(msgBuffer[msgIndex++]);
 
        if(msgIndex >= msgLength)
     {
-           UC0IE &= ~UCB0TXIE;
+           Hal_SpiDisableTxInterrupt();
 
         uint8_t i;
 
         for(i = 0; i < 100; i++);
 
-        P4OUT |= BIT0; /* Unselect transmit                 */
-        P2OUT |= BIT5; /* Set data transfer mode as default */
+        Hal_LcdSelect(0);      /* Unselect transmit                 */
+        Hal_LcdSetDataMode(1); /* Set data transfer mode as default */
 
         for(i = 0; i < 100; i++);
 
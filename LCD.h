@@ -8,7 +8,8 @@
  *
  * Header includes:
  * - necessary includes for uint8_t and text field data structures
- * - global functions declarations for turning on LCD screen and updating the screen
+ * - global functions declarations for turning on LCD screen, putting it to sleep and waking
+ *   it up and updating the screen
  *
  *
  *    Part of: Charger project
@@ -37,9 +38,12 @@
 
 
 /*
- * Draws the text field array's text fields to the screen.
+ * Draws the text field array's text fields to the screen. Updatable text fields are drawn
+ * from the given updatable char tables. Only rows covered by the text fields marked in
+ * dirtyFields are redrawn, ALL_TEXT_FIELDS redraws everything.
  */
-void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount);
+void LCD_UpdateScreen(const T_TextField * pTextFields, uint8_t textFieldCount,
+                      const char (* pUpdatableTexts)[UPDATABLE_TEXT_LENGTH], uint16_t dirtyFields);
 
 
 /*
@@ -48,4 +52,23 @@ void LCD_UpdateScreen(T_TextField * pTextFields, uint8_t textFieldCount);
 void LCD_Initialize(void);
 
 
+/*
+ * Puts the LCD screen to sleep mode where it's blank and draws only a few microamperes.
+ */
+void LCD_Sleep(void);
+
+
+/*
+ * Wakes the LCD screen from sleep mode. Screen contents are kept during sleep.
+ */
+void LCD_Wake(void);
+
+
+/*
+ * Sends the next byte of a transfer. Called from the USCI transmit interrupt which USCI B0 of
+ * the LCD shares with USCI A0.
+ */
+void LCD_TransmitNext(void);
+
+
 #endif /* CHARGER_LCD_H_ */
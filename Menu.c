@@ -21,9 +21,13 @@
  * Source includes functionality to:
  * - switch from one menu view to another
  * - determine tasks to perform in menu and in the main module when a button is clicked
- * - write floats and char arrays to char tables (separate helper functions)
+ *   by dispatching to handlers through view and button tables
+ * - write fixed-point numbers and char arrays to char tables (separate helper functions)
  * - initialize calibration view according to measurement to be calibrated
+ * - show the mean and the noise of a captured calibration point
  * - update a specific view's text fields to match with newest measurements and selections
+ * - show the figures of the profiler in a hidden diagnostics view when it's built
+ * - the table of menu views
  *
  *    Part of: Charger project
  * Created on: 29.7.2015
@@ -45,397 +49,613 @@
 
 
 /*
- * Updates current textfields similar to newly chosen view's text fields.
+ * Marks the view changed. Newly chosen view's text fields are drawn straight from the view so
+ * only it's updatable char tables need to be written on the next update and the whole screen
+ * is redrawn.
  */
 static void Menu_ChangeView(T_MenuSystem * pMenu)
 {
-    uint8_t i;
-    uint8_t j = 0;
-
-    for(i = 0; i < pMenu->views[pMenu->menuState].textFieldCount; i++)
-    {
-        pMenu->currentTextFields[i].pText = pMenu->views[pMenu->menuState].textFields[i].pText;
-        pMenu->currentTextFields[i].x = pMenu->views[pMenu->menuState].textFields[i].x;
-        pMenu->currentTextFields[i].y = pMenu->views[pMenu->menuState].textFields[i].y;
-
-        /* In case textfield's char array is undefined it's supposed to have a modifiable valuable.
-         * It will be appointed an address of menuSystems's char table array that are modified in
-         * Menu_UpdateTextFields according to current menu view.                                    */
-        if(UPDATABLE_DATA == pMenu->currentTextFields[i].pText)
-            pMenu->currentTextFields[i].pText = pMenu->updatableCharTables[j++];
-    }
+    pMenu->isViewChanged = 1;
+    pMenu->dirtyFields   = ALL_TEXT_FIELDS;
 }
 
 
 /*
  * Performs primary action according to current menu state. Basically this is the "select" action.
+ * Selection moves forward and when it goes "over the screen" the view changes to the view's
+ * overflow view. Views that only change the selection have themselves as the overflow view.
  */
-static inline uint8_t Menu_PrimaryAction(T_MenuSystem * pMenu)
+static uint8_t Menu_PrimaryAction(T_MenuSystem * pMenu)
 {
-    switch (pMenu->menuState)
+    const T_MenuView * pView = &pMenu->views[pMenu->menuState];
+
+    pMenu->currentSelection++;
+
+    if (pMenu->currentSelection >= pView->selectionCount)
     {
+        pMenu->currentSelection = 0;
 
-    case PANEL_VIEW:
+        if (pView->overflowView != pMenu->menuState)
+        {
+            pMenu->menuState = (enum E_MenuStates)pView->overflowView;
+            Menu_ChangeView(pMenu);
+        }
+    }
 
-        /* Panel and battery views switching with primary action */
+    /* There is never a task for the main program after primary action so always return no action */
+    return MENU_NO_ACTION;
+}
 
-        pMenu->menuState = BATTERY_VIEW;
-        Menu_ChangeView(pMenu);
 
-        break;
+/*
+ * Performs secondary action according to current menu state. This is the "perform a task" action.
+ * Current selection is used as an index to the view's transition table which defines the next
+ * view and the task for the main program.
+ */
+static uint8_t Menu_SecondaryAction(T_MenuSystem * pMenu)
+{
+    const T_MenuView       * pView       = &pMenu->views[pMenu->menuState];
+    const T_MenuTransition * pTransition = &pView->transitions[pMenu->currentSelection];
 
-    case BATTERY_VIEW:
+    pMenu->menuState = (enum E_MenuStates)pTransition->nextView;
 
-        /* Panel and battery views switching with primary action */
+    /* Selection is kept only when changing between views sharing the same layout, i.e. calibration views */
+    if (pMenu->views[pMenu->menuState].textFields != pView->textFields)
+        pMenu->currentSelection = 0;
 
-        pMenu->menuState = PANEL_VIEW;
-        Menu_ChangeView(pMenu);
+    /* Update menu view as it always changes after secondary action */
+    Menu_ChangeView(pMenu);
 
-        break;
+    return pTransition->task;
+}
 
-    case MENU_VIEW_1:
-    case MENU_VIEW_2:
 
-        /* Menu screen is changed when selection goes "over the screen". */
+/*
+ * No click means no action.
+ */
+static uint8_t Menu_NoAction(T_MenuSystem * pMenu)
+{
+    return MENU_NO_ACTION;
+}
 
-        pMenu->currentSelection++;
 
-        if (pMenu->currentSelection > 3)
-        {
-            pMenu->menuState++;
-            pMenu->currentSelection = 0;
-            Menu_ChangeView(pMenu);
-        }
+#ifdef PROFILER
 
-        break;
+/*
+ * Repeat clicks after a long click from the measurement views move the selection of the first
+ * menu forward and over it's end open the hidden diagnostics view. Elsewhere they have no action.
+ */
+static uint8_t Menu_RepeatAction(T_MenuSystem * pMenu)
+{
+    if(MENU_VIEW_1 != pMenu->menuState)
+        return MENU_NO_ACTION;
 
-    case MENU_VIEW_3:
+    pMenu->currentSelection++;
 
-        /* Menu view is changed when the selection goes "over the screen". */
+    if(pMenu->currentSelection >= pMenu->views[MENU_VIEW_1].selectionCount)
+    {
+        pMenu->currentSelection = 0;
+        pMenu->menuState        = DIAGNOSTICS_VIEW;
+        Menu_ChangeView(pMenu);
+    }
 
-        pMenu->currentSelection++;
+    return MENU_NO_ACTION;
+}
 
-        if (pMenu->currentSelection > 3)
-        {
-            pMenu->menuState = MENU_VIEW_1;
-            pMenu->currentSelection = 0;
-            Menu_ChangeView(pMenu);
-        }
+#endif
 
-        break;
 
-    case CALIBRATION_VIEW_1:
-    case CALIBRATION_VIEW_2:
+/*
+ * Button click handlers indexed with E_ButtonClicks. Double click is two quick short clicks so it
+ * performs the primary action as well. Repeat clicks while holding the button have no action
+ * unless the profiler is built.
+ */
+static uint8_t (* const MENU_BUTTON_ACTIONS[])(T_MenuSystem * pMenu) = { Menu_NoAction,        /* NO_CLICK     */
+                                                                        Menu_PrimaryAction,   /* SHORT_CLICK  */
+                                                                        Menu_SecondaryAction, /* LONG_CLICK   */
+                                                                        Menu_PrimaryAction,   /* DOUBLE_CLICK */
+#ifdef PROFILER
+                                                                        Menu_RepeatAction     /* REPEAT_CLICK */ };
+#else
+                                                                        Menu_NoAction         /* REPEAT_CLICK */ };
+#endif
 
-        /* Calibration views only change the selection */
 
-        pMenu->currentSelection++;
+/*
+ * Handles what function to be taken with current state of the button.
+ */
+static uint8_t Menu_HandleButtonState(T_MenuSystem * pMenu, uint8_t buttonState)
+{
+    if(buttonState > REPEAT_CLICK)
+        return MENU_NO_ACTION;
 
-        if (pMenu->currentSelection > 1)
-            pMenu->currentSelection = 0;
+    return MENU_BUTTON_ACTIONS[buttonState](pMenu);
+}
 
-        break;
 
+/*
+ * Writes char array's value to menuSystem's updatable char table. The table is compared
+ * first and written only if it differs, in which case it's marked dirty so that only
+ * changed text fields are redrawn on the screen.
+ */
+static void Menu_WriteTable(T_MenuSystem * pMenu, uint8_t table, const char * array)
+{
+    char *  pTable = pMenu->updatableCharTables[table];
+    uint8_t i      = 0;
+
+    while(array[i] == pTable[i])
+    {
+        if('\0' == array[i])
+            return;
+        i++;
     }
 
-    /* There is never a task for the main program after primary action so always return no action */
-    return MENU_NO_ACTION;
+    do
+        pTable[i] = array[i];
+    while('\0' != array[i++]);
+
+    pMenu->dirtyCharTables |= 1 << table;
 }
 
 
 /*
- * Performs secondary action according to current menu state. This is the "perform a task" action.
+ * Converts a value to five BCD digits with double dabble which only shifts and adds as
+ * MSP430F2232 has neither hardware division nor multiplication.
  */
-static inline uint8_t Menu_SecondaryAction(T_MenuSystem * pMenu)
+static inline uint32_t Menu_ToBcd(uint16_t value)
 {
-    /* By default return no task for the main program */
-    uint8_t result = MENU_NO_ACTION;
+    uint32_t bcd = 0;
+    uint32_t adjust;
+    uint8_t  i   = 0;
 
-    pMenu->previousMenu = pMenu->menuState;
+    /* Leading zero bits don't change the result */
+    while((i < 16) && !(value & 0x8000))
+    {
+        value <<= 1;
+        i++;
+    }
 
-    switch(pMenu->menuState)
+    /* Shift value's bits into five BCD digits. Before each shift 3 is added to every
+     * digit that is 5 or more so that the digit carries correctly into the next one. */
+    for(; i < 16; i++)
     {
+        adjust = (bcd + 0x33333) & 0x88888;
+        bcd   += (adjust >> 2) | (adjust >> 3);
+        bcd  <<= 1;
 
-    case PANEL_VIEW:
-    case BATTERY_VIEW:
+        if(value & 0x8000)
+            bcd |= 1;
 
-        /* Panel and battery views change into the menu view */
+        value <<= 1;
+    }
 
-        pMenu->menuState = MENU_VIEW_1;
-        pMenu->currentSelection = 0;
+    return bcd;
+}
 
-        break;
 
-    case MENU_VIEW_1:
-    case MENU_VIEW_2:
-    case MENU_VIEW_3:
+/*
+ * Fills the number part of a char array of given size with '>' chars to show a value that
+ * doesn't fit. The unit char, if any, stays in front of the terminator.
+ */
+static void Menu_FillOverflow(char * charArray, uint8_t size, char unit)
+{
+    uint8_t i;
 
-        /* Current menu view and selection are calculated into a number that defines
-         * a task for the main program. Menus 1-2 selections 0-3 and menu 3 selections
-         * 0-1 become 0-9 which defines a calibration and adjustment to be made. 10 is
-         * selection 2 in menu 3 and means save while selection 4 in menu is 11 and
-         * means cancel.                                                             */
+    for(i = 0; i < (size - 1); i++)
+        charArray[i] = '>';
 
-        result = ((pMenu->menuState - 2) * 4) + pMenu->currentSelection;
-        pMenu->currentSelection = 0;
+    if('\0' != unit)
+        charArray[size - 2] = unit;
 
-        switch(result)
-        {
-            case 10:
-            case 11:
-                pMenu->menuState = PANEL_VIEW;
-                break;
-
-            default:
-                pMenu->menuState = CALIBRATION_VIEW_1;
-                break;
-        }
+    charArray[size - 1] = '\0';
+}
 
-        break;
 
-    case CALIBRATION_VIEW_1:
+/*
+ * Writes a fixed-point value given in thousandths (mV, mA) into a char array of given size with
+ * given number of decimals (0-3) and a unit char ('\0' for no unit). The number is right aligned
+ * in front of the unit and the remaining chars are filled with spaces. If the number doesn't fit
+ * in the array or it's VALUE_SATURATED it's number part is filled with '>' chars.
+ */
+static void Menu_FixedToCharArray(char * charArray, uint8_t size, uint16_t value, uint8_t decimals, char unit)
+{
+    uint32_t bcd;
+    uint8_t  i          = 0;
+    int8_t   position   = size - 1;
 
-        /* Selection 0 in calibration views is cancel/back while 1 defines a
-         * calibration value should be measured. */
+    /* Check that unit, decimals, decimal comma, one integer digit and the terminator fit */
+    if((int8_t)size < (2 + (0 != unit) + ((decimals > 0) ? (decimals + 1) : 0)))
+    {
+        for(i = 0; i < (size - 1); i++)
+            charArray[i] = '>';
+        charArray[i] = '\0';
+        return;
+    }
 
-        if(0 == pMenu->currentSelection)
-            pMenu->menuState = MENU_VIEW_1;
-        else
-        {
-            pMenu->menuState = CALIBRATION_VIEW_2;
-            result = MENU_MEASURE_1;
-        }
+    if(VALUE_SATURATED == value)
+    {
+        Menu_FillOverflow(charArray, size, unit);
+        return;
+    }
 
-        break;
+    bcd = Menu_ToBcd(value);
 
-    case CALIBRATION_VIEW_2:
+    charArray[position] = '\0';
 
-        /* Selection 0 in calibration views is cancel/back while 1 defines a
-         * calibration value should be measured. */
+    if('\0' != unit)
+        charArray[--position] = unit;
 
-        if(0 == pMenu->currentSelection)
-            pMenu->menuState = CALIBRATION_VIEW_1;
-        else
+    /* Drop the thousandths that are not shown */
+    for(i = decimals; i < 3; i++)
+        bcd >>= 4;
+
+    if(decimals > 0)
+    {
+        for(i = 0; i < decimals; i++)
         {
-            pMenu->menuState = MENU_VIEW_1;
-            result = MENU_MEASURE_2;
+            charArray[--position] = (bcd & 0x0F) + '0';
+            bcd >>= 4;
         }
 
-        break;
+        charArray[--position] = ',';
     }
 
-    /* Update menu view as it always changes after secondary action */
-    Menu_ChangeView(pMenu);
+    /* Integer part has always at least one digit */
+    do
+    {
+        if(0 == position)
+        {
+            Menu_FillOverflow(charArray, size, unit);
+            return;
+        }
 
-    return result;
+        charArray[--position] = (bcd & 0x0F) + '0';
+        bcd >>= 4;
+    }
+    while(0 != bcd);
+
+    /* Put empty spaces to the remaining chars */
+    while(position > 0)
+        charArray[--position] = ' ';
 }
 
 
 /*
- * Handles what function to be taken with current state of the button.
+ * Writes a measurement value in thousandths with it's unit to menuSystem's updatable char table.
  */
-static uint8_t Menu_HandleButtonState(T_MenuSystem * pMenu, uint8_t buttonState)
+static void Menu_WriteMeasurement(T_MenuSystem * pMenu, uint8_t table, uint16_t milliValue, char unit)
 {
-    switch(buttonState)
-    {
-    case SHORT_CLICK:
-        return Menu_PrimaryAction(pMenu);
+    char measurement[8];
 
-    case LONG_CLICK:
-        return Menu_SecondaryAction(pMenu);
+    Menu_FixedToCharArray(measurement, sizeof(measurement), milliValue, 2, unit);
 
-    case NO_CLICK:
-    default:
-        return MENU_NO_ACTION;
-    }
+    Menu_WriteTable(pMenu, table, measurement);
 }
 
 
 /*
- * Writes char array's value to a table of chars. Used for writing constants
- * to menuSystem's updatable char arrays.
+ * Writes a temperature in tenths of a degree Celsius to menuSystem's updatable char table. The
+ * minus sign is put in front of the first digit. A missing sensor is shown as EI, no.
  */
-static void Menu_CharArrayToTable(char * array, char * table)
+static void Menu_WriteTemperature(T_MenuSystem * pMenu, uint8_t table, int16_t temperature)
 {
-    char i = 0;
-    while(*array != '\0')
-        table[i++] = *array++;
-    table[i] = '\0';
+    char     text[8];
+    uint8_t  i = 0;
+    uint16_t magnitude;
+
+    if(TEMPERATURE_UNKNOWN == temperature)
+    {
+        Menu_WriteTable(pMenu, table, "     EI");
+        return;
+    }
+
+    /* Up to 60 C is 60000 in thousandths which fits to 16 bits only unsigned */
+    magnitude = (uint16_t)((temperature < 0) ? -temperature : temperature);
+
+    Menu_FixedToCharArray(text, sizeof(text), magnitude * 100, 1, 'C');
+
+    while(' ' == text[i])
+        i++;
+
+    if((temperature < 0) && (i > 0))
+        text[i - 1] = '-';
+
+    Menu_WriteTable(pMenu, table, text);
 }
 
 
 /*
- * Writes a float value as two decimal number into an EIGHT BYTES CHAR ARRAY.
- * This function is only used for writing to T_MenuSystems's updatable char arrays
- * which are defined as eight chars long.
+ * Writes the noise of a captured calibration point with it's unit to menuSystem's updatable char
+ * table. K stands for kohina, noise.
  */
-static void Menu_FloatToCharArray(char * charArray, float * value)
+static void Menu_WriteNoise(T_MenuSystem * pMenu, uint8_t table, uint16_t milliValue, char unit)
 {
-    /* Convert value into unsigned int after multiplying it with 100 for decimals */
-    unsigned int newValue = (unsigned int)((*value) * 100);
+    char noise[8] = "K:";
 
-    int8_t i = 0;
+    Menu_FixedToCharArray(&noise[2], sizeof(noise) - 2, milliValue, 2, unit);
 
-    /* Set decimals into their places */
-    charArray[5] = (newValue % 10) + '0';
-    newValue /= 10;
-    charArray[4] = (newValue % 10) + '0';
-    newValue /= 10;
+    Menu_WriteTable(pMenu, table, noise);
+}
 
-    charArray[3] = ',';
 
-    i = 2;
+/*
+ * Updates the calibration view's text fields that tell the calibrated channel and the calibration
+ * state. These don't change while the view is shown so this is called only when the view is
+ * changed.
+ */
+static inline void Menu_SetCalibrationView(T_MenuSystem * pMenu, T_CalibrationInfo * pCalibInfo)
+{
+    /* Change the text fields that tell whether it's a battery or a certain panel that's being calibrated */
+    char panelNumber[] = "       ";
 
-    if(0 == newValue)
+    if(pCalibInfo->channelCount > 1)
+        Menu_WriteTable(pMenu, 0, "KAIKKI ");
+    else if(pCalibInfo->measToCalibrate > 7)
+        Menu_WriteTable(pMenu, 0, "  AKKU ");
+    else
     {
-        charArray[i] = '0';
-        i--;
+        Menu_WriteTable(pMenu, 0, "PANEELI");
+        panelNumber[0] = ((pCalibInfo->measToCalibrate + 2)/2) + '0';
     }
-    else
+
+    Menu_WriteTable(pMenu, 1, panelNumber);
+
+    /* Change the text fields that tell of the measured quantity and the calibration state */
+    char * quantity = "VIRTA";
+    char   state[]  = "1/3    ";
+
+    state[0] += pMenu->menuState - CALIBRATION_VIEW_1;
+
+    if(0 == (pCalibInfo->measToCalibrate % 2))
+        quantity = "JaNNITE";
+
+    Menu_WriteTable(pMenu, 2, quantity);
+    Menu_WriteTable(pMenu, 3, state);
+}
+
+
+/*
+ * In panel view update the panel measurements that have changed.
+ */
+static void Menu_UpdatePanelView(T_MenuSystem * pMenu, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo)
+{
+    uint8_t i;
+
+    if(pMenu->isViewChanged)
+        changedResults = ALL_TEXT_FIELDS;
+
+    for(i = 0; i < 8; i++)
     {
-        /* Continue dividing with 10 and putting numbers into char array until value reaches 0 */
-        while(newValue > 0)
+        if(changedResults & 1)
         {
-            charArray[i] = (newValue % 10) + '0';
-            newValue /= 10;
-            i--;
+            if(0 == (i % 2))
+                Menu_WriteMeasurement(pMenu, i, pMeasResults[i], 'V');
+            else
+                Menu_WriteMeasurement(pMenu, i, pMeasResults[i], 'A');
         }
+
+        changedResults >>= 1;
     }
+}
 
-    /* Put empty spaces to the remaining chars */
-    while(i >= 0)
-        charArray[i--] = ' ';
+
+/*
+ * In battery view update battery's current and voltage if they have changed.
+ */
+static void Menu_UpdateBatteryView(T_MenuSystem * pMenu, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo)
+{
+    if(pMenu->isViewChanged)
+        changedResults = ALL_TEXT_FIELDS;
+
+    if(changedResults & (1 << BATTERY_VOLTAGE))
+        Menu_WriteMeasurement(pMenu, 0, pMeasResults[BATTERY_VOLTAGE], 'V');
+
+    if(changedResults & (1 << BATTERY_CURRENT))
+        Menu_WriteMeasurement(pMenu, 1, pMeasResults[BATTERY_CURRENT], 'A');
+
+    if(changedResults & (1 << BATTERY_TEMPERATURE))
+        Menu_WriteTemperature(pMenu, 2, pMeasResults[BATTERY_TEMPERATURE]);
 }
 
 
 /*
- * Updates the calibration view's text fields according to calibration state.
+ * In menu views update the selection mark place to match with the current selection state.
  */
-static inline void Menu_SetCalibrationView(T_MenuSystem * pMenu, T_CalibrationInfo * pCalibInfo)
+static void Menu_UpdateMenuView(T_MenuSystem * pMenu, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo)
 {
-    /* Change the text fields that tell whether it's a battery or a certain panel that's being calibrated */
-    Menu_CharArrayToTable("       ", pMenu->updatableCharTables[1]);
+    uint8_t i;
 
-    if(pCalibInfo->measToCalibrate > 7)
-        Menu_CharArrayToTable("  AKKU ", pMenu->updatableCharTables[0]);
-    else
+    for(i = 0; i < 4; i++)
     {
-        Menu_CharArrayToTable("PANEELI", pMenu->updatableCharTables[0]);
-        pMenu->updatableCharTables[1][0] = ((pCalibInfo->measToCalibrate + 2)/2) + '0';
+        if(i == pMenu->currentSelection)
+            Menu_WriteTable(pMenu, i, ">      ");
+        else
+            Menu_WriteTable(pMenu, i, "       ");
     }
+}
 
-    /* Change the text fields that tell of the calibration point and the calibration state */
-    char *  quantity         = "VIRTA";
-    char *  state            = "1/2    ";
-    char    unit             = 'A';
-    uint8_t calibrationState = 0;
-    uint8_t calibUnit        = 1;
 
-    if(CALIBRATION_VIEW_2 == pMenu->menuState)
+/*
+ * In calibration views update the measurement of the calibrated quantity and the selection
+ * mark to match with the current selection state. After a capture the noise is shown in place
+ * of the calibration point and the mean of the capture, or a noise warning if the point was
+ * refused, in place of the measurement.
+ */
+static void Menu_UpdateCalibrationView(T_MenuSystem * pMenu, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo)
+{
+    /* If calibration was chosen call the function to update fields according to calibration state */
+    if(pMenu->isViewChanged)
     {
-        calibrationState = 1;
-        state            = "2/2    ";
+        Menu_SetCalibrationView(pMenu, pCalibInfo);
+        changedResults = ALL_TEXT_FIELDS;
     }
 
+    if(0 == pMenu->currentSelection)
+    {
+        Menu_WriteTable(pMenu, 5, ">      ");
+        Menu_WriteTable(pMenu, 6, "<      ");
+    }
+    else
+    {
+        Menu_WriteTable(pMenu, 5, "       ");
+        Menu_WriteTable(pMenu, 6, "   >  <");
+    }
+
+    char    unit             = 'A';
+    uint8_t calibUnit        = 1;
+    uint8_t calibrationPoint = pMenu->menuState - CALIBRATION_VIEW_1;
+    uint8_t captureState     = CAPTURE_IDLE;
+
     if(0 == (pCalibInfo->measToCalibrate % 2))
     {
-        quantity  = "JaNNITE";
         unit      = 'V';
         calibUnit = 0;
     }
 
-    Menu_CharArrayToTable(quantity, pMenu->updatableCharTables[2]);
-    Menu_CharArrayToTable(state, pMenu->updatableCharTables[3]);
-    Menu_FloatToCharArray(pMenu->updatableCharTables[4], &CALIBRATION_POINTS[calibUnit][calibrationState]);
-    pMenu->updatableCharTables[5][6] = unit;
-    pMenu->updatableCharTables[7][6] = unit;
+    /* Results of a capture are shown only in the view of the captured point */
+    if(calibrationPoint == pCalibInfo->capturePoint)
+        captureState = pCalibInfo->captureState;
+
+    if(CAPTURE_ACCEPTED == captureState)
+    {
+        Menu_WriteNoise(pMenu, 4, pCalibInfo->captureNoise, unit);
+        Menu_WriteMeasurement(pMenu, 7, pCalibInfo->captureMean, unit);
+    }
+    else if(CAPTURE_REFUSED == captureState)
+    {
+        Menu_WriteNoise(pMenu, 4, pCalibInfo->captureNoise, unit);
+        Menu_WriteTable(pMenu, 7, "KOHINA ");
+    }
+    else if(CAPTURE_FAILED == captureState)
+    {
+        Menu_WriteMeasurement(pMenu, 4, CALIBRATION_POINTS[calibUnit][calibrationPoint], unit);
+        Menu_WriteTable(pMenu, 7, "VIRHE  ");
+    }
+    else
+    {
+        Menu_WriteMeasurement(pMenu, 4, CALIBRATION_POINTS[calibUnit][calibrationPoint], unit);
+
+        /* Measurement is written on every update while capturing as it may have shown a refused or failed capture */
+        if((changedResults & (1 << pCalibInfo->measToCalibrate)) || (CAPTURE_RUNNING == captureState))
+            Menu_WriteMeasurement(pMenu, 7, pMeasResults[pCalibInfo->measToCalibrate], unit);
+    }
 }
 
 
+#ifdef PROFILER
+
 /*
- * Updates the contents of current menu view's textfields to match with newest measurements and selection. *
- *
- * TODO: Content that changes when menus views changes such as measurement units are also updated here. To
- * avoid changing text pieces that don't need to be changed again these parts could be moved to Menu_ChangeView.
+ * Writes a count right aligned to menuSystem's updatable char table.
  */
-void Menu_UpdateTextFields(T_MenuSystem * pMenu, float * pMeasResults, T_CalibrationInfo * pCalibInfo)
+static void Menu_WriteCount(T_MenuSystem * pMenu, uint8_t table, uint16_t count)
 {
-    if(NO_MENU == pMenu->menuState)
+    char     text[8]  = "       ";
+    int8_t   position = sizeof(text) - 1;
+    uint32_t bcd      = Menu_ToBcd(count);
+
+    do
     {
-        pMenu->menuState = PANEL_VIEW;
-        Menu_ChangeView(pMenu);
+        text[--position] = (bcd & 0x0F) + '0';
+        bcd >>= 4;
     }
+    while(0 != bcd);
 
-    /* If calibration was chosen call the function to update fields according to calibration state */
-    if(((5 == pMenu->menuState) || (6 == pMenu->menuState)) && (pMenu->menuState != pMenu->previousMenu))
-        Menu_SetCalibrationView(pMenu, pCalibInfo);
+    Menu_WriteTable(pMenu, table, text);
+}
 
-    uint8_t i = 0;
 
-    switch(pMenu->menuState)
-    {
-    case PANEL_VIEW:
+/*
+ * In diagnostics view update the figures of the selected stage and the worst latency of the
+ * tick interrupt. Figures are in timer cycles, 16 in a microsecond.
+ */
+static void Menu_UpdateDiagnosticsView(T_MenuSystem * pMenu, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo)
+{
+    const static char * const STAGE_NAMES[PROFILER_STAGE_COUNT] = { "MITTAUS", "SaaTo  ", "NAPPI  ", "VALIKKO", "NaYTTo " };
 
-        /* In panel view update all eight panel measurements */
+    T_ProfilerStage stage;
 
-        for(i = 0; i < 8; i++)
-        {
-            Menu_FloatToCharArray(pMenu->updatableCharTables[i], &pMeasResults[i]);
-            if(0 == (i % 2))
-                pMenu->updatableCharTables[i][6] = 'V';
-            else
-                pMenu->updatableCharTables[i][6] = 'A';
-        }
+    Profiler_GetStage(pMenu->currentSelection, &stage);
 
-         break;
+    Menu_WriteTable(pMenu, 0, STAGE_NAMES[pMenu->currentSelection]);
+    Menu_WriteCount(pMenu, 1, stage.minimum);
+    Menu_WriteCount(pMenu, 2, (0 != stage.count) ? (stage.sum / stage.count) : 0);
+    Menu_WriteCount(pMenu, 3, stage.maximum);
+    Menu_WriteCount(pMenu, 4, stage.overruns);
+    Menu_WriteCount(pMenu, 5, Profiler_GetMaxLatency());
+}
 
-    case BATTERY_VIEW:
+#endif
 
-        /* In battery view update battery's current and voltage */
 
-        Menu_FloatToCharArray(pMenu->updatableCharTables[0], &pMeasResults[BATTERY_VOLTAGE]);
-        Menu_FloatToCharArray(pMenu->updatableCharTables[1], &pMeasResults[BATTERY_CURRENT]);
-        pMenu->updatableCharTables[0][6] = 'V';
-        pMenu->updatableCharTables[1][6] = 'A';
+/*
+ * Updates the contents of current menu view's textfields to match with newest measurements and selection
+ * by calling the current view's update handler. Measurements are formatted only if they are changed,
+ * which is told by changedResults bits, or if the view has just been changed.
+ */
+void Menu_UpdateTextFields(T_MenuSystem * pMenu, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo)
+{
+    if(NO_MENU == pMenu->menuState)
+    {
+        pMenu->menuState = PANEL_VIEW;
+        Menu_ChangeView(pMenu);
+    }
 
-         break;
+    pMenu->views[pMenu->menuState].pfUpdateFields(pMenu, pMeasResults, changedResults, pCalibInfo);
+}
 
-    case MENU_VIEW_1:
-    case MENU_VIEW_2:
-    case MENU_VIEW_3:
 
-        /* In menu view update the selection mark place to match with the current selection state */
+/*
+ * Converts dirty char tables into dirty text fields of the current view. Updatable text fields
+ * use the char tables in their order in the view.
+ */
+static void Menu_SetDirtyFields(T_MenuSystem * pMenu)
+{
+    const T_MenuView * pView = &pMenu->views[pMenu->menuState];
 
-        for(i = 0; i < 4; i++)
-            Menu_CharArrayToTable("       ", pMenu->updatableCharTables[i]);
+    uint8_t  i;
+    uint8_t  tables    = pMenu->dirtyCharTables;
+    uint16_t fieldMask = 1;
 
-        pMenu->updatableCharTables[pMenu->currentSelection][0] = '>';
+    for(i = 0; (i < pView->textFieldCount) && (0 != tables); i++)
+    {
+        if(UPDATABLE_DATA == pView->textFields[i].pText)
+        {
+            if(tables & 1)
+                pMenu->dirtyFields |= fieldMask;
 
-         break;
+            tables >>= 1;
+        }
 
-    case CALIBRATION_VIEW_1:
-    case CALIBRATION_VIEW_2:
+        fieldMask <<= 1;
+    }
 
-        /* In calibration views update the measurement of the calibrated quantity and
-         * the selection mark to match with the current selection state */
+    pMenu->dirtyCharTables = 0;
+}
 
-        if(0 == pMenu->currentSelection)
-        {
-            Menu_CharArrayToTable(">      ", pMenu->updatableCharTables[5]);
-            Menu_CharArrayToTable("<      ", pMenu->updatableCharTables[6]);
-        }
-        else
-        {
-            Menu_CharArrayToTable("       ", pMenu->updatableCharTables[5]);
-            Menu_CharArrayToTable("   >  <", pMenu->updatableCharTables[6]);
-        }
 
-        Menu_FloatToCharArray(pMenu->updatableCharTables[7], &pMeasResults[pCalibInfo->measToCalibrate]);
+/****************************************************************************************************
+ *                                           CONSTANTS
+ ****************************************************************************************************/
 
-         break;
 
-    }
-}
+/*
+ * Defines an array of menuScreen entities in the order of E_MenuStates. All three calibration states
+ * use the same layout so it's used three times. The diagnostics view is there only when the
+ * profiler is built.
+ */
+const T_MenuView MENU_VIEWS[] = { { PANEL_VIEW_FIELDS,       15, 1, BATTERY_VIEW,       MEASUREMENT_VIEW_TRANSITIONS, Menu_UpdatePanelView       },
+                                  { BATTERY_VIEW_FIELDS,      7, 1, PANEL_VIEW,         MEASUREMENT_VIEW_TRANSITIONS, Menu_UpdateBatteryView     },
+                                  { MENU_1_FIELDS,            9, 4, MENU_VIEW_2,        MENU_1_TRANSITIONS,           Menu_UpdateMenuView        },
+                                  { MENU_2_FIELDS,            9, 4, MENU_VIEW_3,        MENU_2_TRANSITIONS,           Menu_UpdateMenuView        },
+                                  { MENU_3_FIELDS,            3, 1, MENU_VIEW_4,        MENU_3_TRANSITIONS,           Menu_UpdateMenuView        },
+                                  { MENU_4_FIELDS,            9, 4, MENU_VIEW_1,        MENU_4_TRANSITIONS,           Menu_UpdateMenuView        },
+                                  { CALIBRATION_MENU_FIELDS, 12, 2, CALIBRATION_VIEW_1, CALIBRATION_1_TRANSITIONS,    Menu_UpdateCalibrationView },
+                                  { CALIBRATION_MENU_FIELDS, 12, 2, CALIBRATION_VIEW_2, CALIBRATION_2_TRANSITIONS,    Menu_UpdateCalibrationView },
+                                  { CALIBRATION_MENU_FIELDS, 12, 2, CALIBRATION_VIEW_3, CALIBRATION_3_TRANSITIONS,    Menu_UpdateCalibrationView },
+#ifdef PROFILER
+                                  { DIAGNOSTICS_FIELDS,      12, 5, PANEL_VIEW,         DIAGNOSTICS_TRANSITIONS,      Menu_UpdateDiagnosticsView },
+#endif
+                                };
 
 
 /****************************************************************************************************
@@ -443,14 +663,48 @@ void Menu_UpdateTextFields(T_MenuSystem * pMenu, float * pMeasResults, T_Calibra
  ****************************************************************************************************/
 
 
+/*
+ * Changes the view on behalf of the main module. Used when a confirmed calibration point moves
+ * the calibration forward. Selection is kept only between views sharing the same layout.
+ */
+void Menu_ChangeToView(T_MenuSystem * pMenu, enum E_MenuStates view)
+{
+    if (pMenu->views[view].textFields != pMenu->views[pMenu->menuState].textFields)
+        pMenu->currentSelection = 0;
+
+    pMenu->menuState = view;
+    Menu_ChangeView(pMenu);
+}
+
+
 /*
  *  Updates menu view with given information and returns a task for main module to perform
  */
-inline uint8_t Menu_UpdateView(T_MenuSystem * pMenu, uint8_t buttonState, float * pMeasResults, T_CalibrationInfo * pCalibInfo)
+inline uint8_t Menu_UpdateView(T_MenuSystem * pMenu, uint8_t buttonState, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo)
 {
+    /* Dirty fields are collected again on every update */
+    pMenu->dirtyFields = 0;
+
     uint8_t menuAction = Menu_HandleButtonState(pMenu, buttonState);
 
-    Menu_UpdateTextFields(pMenu, pMeasResults, pCalibInfo);
+    /* Numbers 0-9 define the measurement to calibrate. It's set already here so that the
+     * calibration view can be initialized when it's changed to. A batch of panel voltages
+     * starts from the first panel and takes every other channel.                         */
+    if(menuAction < MENU_SAVE)
+    {
+        pCalibInfo->measToCalibrate = menuAction;
+        pCalibInfo->channelCount    = 1;
+    }
+    else if(MENU_CALIBRATE_PANELS == menuAction)
+    {
+        pCalibInfo->measToCalibrate = PANEL_1_VOLTAGE;
+        pCalibInfo->channelCount    = CALIBRATION_BATCH_SIZE;
+    }
+
+    Menu_UpdateTextFields(pMenu, pMeasResults, changedResults, pCalibInfo);
+    Menu_SetDirtyFields(pMenu);
+
+    pMenu->isViewChanged = 0;
 
     return menuAction;
 }
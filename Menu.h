@@ -11,16 +11,23 @@
  * the x and y coordinates of a single text field. A single menu view is defined with an
  * array of text fields and the amount of text fields in it.
  *
- * When current menu view is changed to another the menu system changes it's current text
- * fields according to new view's fields. Because some text fields are updatable, such as
- * the ones showing newest measurement results and the ones indicating selection state,
- * given char array pointers (the ones pointing to 0) are put to point menu system
- * structure's pre-allocated char arrays that can be updated according to specific menu
- * view.
+ * Text fields are drawn straight from the current view's constant text field array. Because
+ * some text fields are updatable, such as the ones showing newest measurement results and
+ * the ones indicating selection state, given char array pointers (the ones pointing to 0)
+ * are drawn from menu system structure's pre-allocated char arrays that are updated
+ * according to specific menu view. The n:th updatable text field of a view uses the n:th
+ * char array so no copies of the text fields are kept in RAM.
+ *
+ * Each view also carries its own behaviour: the number of selections it has, the view
+ * to change to when a short click goes over the last selection, a transition table that
+ * tells for every selection where a long click leads and which task it gives to the main
+ * module, and a handler that updates the view's updatable text fields. Menu.c only
+ * dispatches to these through the view table so adding a view doesn't need any changes
+ * to the shared menu logic.
  *
  * Header includes:
  * - definitions used in Menu and Charger modules to define the interaction between them
- * - initialization of menu views and text fields for Charger project
+ * - initialization of text fields and transition tables for Charger project
  *
  *    Part of: Charger project
  * Created on: 29.7.2015
@@ -38,6 +45,7 @@
 #include <stdint.h>
 
 #include "Common.h"
+#include "Profiler.h"
 
 
 /****************************************************************************************************
@@ -47,15 +55,17 @@
 
 /*
  * Actions that are selected from menu system and passed on to the main program.
- * Numbers 0-9 define a specific measure will be calibrated.
+ * Numbers 0-9 define a specific measure will be calibrated and MENU_CALIBRATE_PANELS
+ * that all panel voltages are calibrated together.
  */
 #define MENU_SAVE      10
 #define MENU_CANCEL    11
 #define MENU_NO_ACTION 12
 #define MENU_MEASURE_1 13
 #define MENU_MEASURE_2 14
-
-#define UPDATABLE_DATA  0
+#define MENU_MEASURE_3 15
+#define MENU_CALIBRATE_PANELS 16
+#define MENU_PROFILER_RESET   17
 
 
 /****************************************************************************************************
@@ -63,12 +73,6 @@
  ****************************************************************************************************/
 
 
-/*
- * Defines button click states
- */
-enum E_ButtonClicks { NO_CLICK, SHORT_CLICK, LONG_CLICK };
-
-
 /*
  * Different menu states, basically different menu views to help make the code
  * more understandable.
@@ -78,18 +82,51 @@ enum E_MenuStates   { PANEL_VIEW         = 0,
                       MENU_VIEW_1        = 2,
                       MENU_VIEW_2        = 3,
                       MENU_VIEW_3        = 4,
-                      CALIBRATION_VIEW_1 = 5,
-                      CALIBRATION_VIEW_2 = 6,
-                      NO_MENU            = 7 };
+                      MENU_VIEW_4        = 5,
+                      CALIBRATION_VIEW_1 = 6,
+                      CALIBRATION_VIEW_2 = 7,
+                      CALIBRATION_VIEW_3 = 8,
+#ifdef PROFILER
+                      DIAGNOSTICS_VIEW   = 9,
+                      NO_MENU            = 10 };
+#else
+                      NO_MENU            = 9 };
+#endif
+
+
+/*
+ * Forward declaration of the menu system so that menu views can define handlers for it.
+ */
+typedef struct S_MenuSystem T_MenuSystem;
+
+
+/*
+ * Defines where a long click leads from a single selection of a view and which task it
+ * gives to the main program.
+ */
+typedef struct
+{
+    const uint8_t nextView;
+    const uint8_t task;
+} T_MenuTransition;
 
 
 /*
- * Contains an array of textfields and their amount to define a single menu view.
+ * Contains an array of textfields and their amount to define a single menu view. The rest
+ * of the members define how the view behaves: a short click moves the selection forward
+ * and changes to overflowView when selection goes "over the screen", a long click follows
+ * the current selection's transition and pfUpdateFields updates the updatable text fields.
  */
 typedef struct
 {
-    const T_TextField * const textFields;
-    const uint8_t             textFieldCount;
+    const T_TextField      * const textFields;
+    const uint8_t                  textFieldCount;
+
+    const uint8_t                  selectionCount;
+    const uint8_t                  overflowView;
+    const T_MenuTransition * const transitions;
+
+    void (* const pfUpdateFields)(T_MenuSystem * pMenu, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo);
 } T_MenuView;
 
 
@@ -99,22 +136,30 @@ typedef struct
  *
  * As some text fields require to be updated according to measurements and current
  * selection a menuSystem has eight helper char tables of eight bytes length that
- * are modifiable. To hold all the current menu view's text fields nicely in one
- * place there is also a helper table of text fields. This makes managing the text
- * fields easier for other modules.
+ * are modifiable. Other text fields are read from the views in FLASH.
+ *
+ * Char tables are written only when their contents change and each written table
+ * sets its bit in dirtyCharTables. On every update these are converted to bits of
+ * the current view's text fields in dirtyFields which tells the LCD what to redraw.
+ *
+ * On MSP430 a T_MenuSystem takes 74 bytes: 64 for the char tables, two for each of
+ * menuState, views and dirtyFields, one for each of the three byte members and one
+ * byte of padding. Menu module has no static variables, everything else is const
+ * and stays in FLASH.
  */
-typedef struct
+struct S_MenuSystem
 {
     enum E_MenuStates  menuState;
     uint8_t            currentSelection;
 
-    enum E_MenuStates  previousMenu;
-
     const T_MenuView * views;
 
-    char               updatableCharTables[8][8];
-    T_TextField        currentTextFields[15];
-} T_MenuSystem;
+    uint8_t            isViewChanged;
+    uint8_t            dirtyCharTables;
+    uint16_t           dirtyFields;
+
+    char               updatableCharTables[8][UPDATABLE_TEXT_LENGTH];
+};
 
 
 /****************************************************************************************************
@@ -151,9 +196,11 @@ const static T_TextField BATTERY_VIEW_FIELDS[]    = { { "AKKU",            53,
                                                       { "JaNNITE",         10, 20     },
                                                       { "VIRTA",           80, 20     },
                                                       { UPDATABLE_DATA,     5, 38     },   /* Battery voltage */
-                                                      { UPDATABLE_DATA,    70, 38     } }; /* Battery current */
+                                                      { UPDATABLE_DATA,    70, 38     },   /* Battery current */
+                                                      { "LaMPo",           10, 54     },
+                                                      { UPDATABLE_DATA,    70, 54     } }; /* Battery temperature */
 
-const static T_TextField MENU_1_FIELDS[]          = { { "VIRITYS 1/3",        15,  2  },
+const static T_TextField MENU_1_FIELDS[]          = { { "VIRITYS 1/4",        15,  2  },
                                                       { "PANEELI 1: JaNNITE", 10, 15  },
                                                       { "PANEELI 1: VIRTA",   10, 28  },
                                                       { "PANEELI 2: JaNNITE", 10, 41  },
@@ -163,7 +210,7 @@ const static T_TextField MENU_1_FIELDS[]          = { { "VIRITYS 1/3",        15
                                                       { UPDATABLE_DATA,        5, 41  },   /* Selection 2 */
                                                       { UPDATABLE_DATA,        5, 54  } }; /* Selection 3 */
 
-const static T_TextField MENU_2_FIELDS[]          = { { "VIRITYS 2/3",        15,  2 },
+const static T_TextField MENU_2_FIELDS[]          = { { "VIRITYS 2/4",        15,  2 },
                                                       { "PANEELI 3: JaNNITE", 10, 15 },
                                                       { "PANEELI 3: VIRTA",   10, 28 },
                                                       { "PANEELI 4: JaNNITE", 10, 41 },
@@ -173,7 +220,11 @@ const static T_TextField MENU_2_FIELDS[]          = { { "VIRITYS 2/3",        15
                                                       { UPDATABLE_DATA,        5, 41 },    /* Selection 2 */
                                                       { UPDATABLE_DATA,        5, 54  } }; /* Selection 3 */
 
-const static T_TextField MENU_3_FIELDS[]          = { { "VIRITYS 3/3",        15,  2 },
+const static T_TextField MENU_3_FIELDS[]          = { { "VIRITYS 3/4",        15,  2 },
+                                                      { "PANEELIT: JaNNITE",  10, 15 },
+                                                      { UPDATABLE_DATA,        5, 15 } };  /* Selection 0 */
+
+const static T_TextField MENU_4_FIELDS[]          = { { "VIRITYS 4/4",        15,  2 },
                                                       { "AKKU: JaNNITE",      10, 15 },
                                                       { "AKKU: VIRTA",        10, 28 },
                                                       { "TALLENNA",           10, 41 },
@@ -196,16 +247,83 @@ const static T_TextField CALIBRATION_MENU_FIELDS[] = {{ UPDATABLE_DATA,       40
                                                       { "MITTAUS",            19, 54 },
                                                       { UPDATABLE_DATA,       67, 54 } };  /* Measured value    */
 
+#ifdef PROFILER
+
+/* Diagnostics view shows the figures of a profiled stage in timer cycles, the stage changes with
+ * a short click. It's opened by holding the button down in the measurement views: after the long
+ * click the repeat clicks walk the selection through the first menu and over it's end.        */
+const static T_TextField DIAGNOSTICS_FIELDS[]     = { { UPDATABLE_DATA,        5,  2 },    /* Stage             */
+                                                      { "JAKSOT",             80,  2 },
+                                                      { "MIN",                 5, 12 },
+                                                      { UPDATABLE_DATA,       60, 12 },    /* Minimum           */
+                                                      { "KESKI",               5, 22 },
+                                                      { UPDATABLE_DATA,       60, 22 },    /* Mean              */
+                                                      { "MAKS",                5, 32 },
+                                                      { UPDATABLE_DATA,       60, 32 },    /* Maximum           */
+                                                      { "YLITYKSET",           5, 42 },
+                                                      { UPDATABLE_DATA,       60, 42 },    /* Overruns          */
+                                                      { "VIIVE",               5, 54 },
+                                                      { UPDATABLE_DATA,       60, 54 } };  /* Tick latency      */
+
+#endif
+
 /*
- * Defines an array of menuScreen entities. Both calibration states use the same layout so it's used twice.
+ *                                      TRANSITION TABLES
+ *
+ *     Transition tables define for each selection of a view which view a long click changes to
+ *     and what task is given to the main program. Menus 1-2 selections 0-3 and menu 4 selections
+ *     0-1 give tasks 0-9 which define a calibration and adjustment to be made. Menu 3 calibrates
+ *     the voltages of all panels in one go from a single reference. Selection 0 in
+ *     calibration views is cancel/back while 1 defines a calibration value should be measured.
+ *     The view is kept while the point is captured and the main program changes to the next
+ *     view when an accepted point is confirmed with another long click.
+ *
  */
-const static T_MenuView MENU_VIEWS[] = { { PANEL_VIEW_FIELDS,       15 },
-                                         { BATTERY_VIEW_FIELDS,      5 },
-                                         { MENU_1_FIELDS,            9 },
-                                         { MENU_2_FIELDS,            9 },
-                                         { MENU_3_FIELDS,            9 },
-                                         { CALIBRATION_MENU_FIELDS, 12 },
-                                         { CALIBRATION_MENU_FIELDS, 12 } };
+
+const static T_MenuTransition MEASUREMENT_VIEW_TRANSITIONS[] = { { MENU_VIEW_1,        MENU_NO_ACTION } };
+
+const static T_MenuTransition MENU_1_TRANSITIONS[]          = { { CALIBRATION_VIEW_1, PANEL_1_VOLTAGE },
+                                                                { CALIBRATION_VIEW_1, PANEL_1_CURRENT },
+                                                                { CALIBRATION_VIEW_1, PANEL_2_VOLTAGE },
+                                                                { CALIBRATION_VIEW_1, PANEL_2_CURRENT } };
+
+const static T_MenuTransition MENU_2_TRANSITIONS[]          = { { CALIBRATION_VIEW_1, PANEL_3_VOLTAGE },
+                                                                { CALIBRATION_VIEW_1, PANEL_3_CURRENT },
+                                                                { CALIBRATION_VIEW_1, PANEL_4_VOLTAGE },
+                                                                { CALIBRATION_VIEW_1, PANEL_4_CURRENT } };
+
+const static T_MenuTransition MENU_3_TRANSITIONS[]          = { { CALIBRATION_VIEW_1, MENU_CALIBRATE_PANELS } };
+
+const static T_MenuTransition MENU_4_TRANSITIONS[]          = { { CALIBRATION_VIEW_1, BATTERY_VOLTAGE },
+                                                                { CALIBRATION_VIEW_1, BATTERY_CURRENT },
+                                                                { PANEL_VIEW,         MENU_SAVE       },
+                                                                { PANEL_VIEW,         MENU_CANCEL     } };
+
+const static T_MenuTransition CALIBRATION_1_TRANSITIONS[]   = { { MENU_VIEW_1,        MENU_NO_ACTION  },
+                                                                { CALIBRATION_VIEW_1, MENU_MEASURE_1  } };
+
+const static T_MenuTransition CALIBRATION_2_TRANSITIONS[]   = { { CALIBRATION_VIEW_1, MENU_NO_ACTION  },
+                                                                { CALIBRATION_VIEW_2, MENU_MEASURE_2  } };
+
+const static T_MenuTransition CALIBRATION_3_TRANSITIONS[]   = { { CALIBRATION_VIEW_2, MENU_NO_ACTION  },
+                                                                { CALIBRATION_VIEW_3, MENU_MEASURE_3  } };
+
+#ifdef PROFILER
+
+/* A long click in the diagnostics view clears the figures */
+const static T_MenuTransition DIAGNOSTICS_TRANSITIONS[]     = { { DIAGNOSTICS_VIEW,   MENU_PROFILER_RESET },
+                                                                { DIAGNOSTICS_VIEW,   MENU_PROFILER_RESET },
+                                                                { DIAGNOSTICS_VIEW,   MENU_PROFILER_RESET },
+                                                                { DIAGNOSTICS_VIEW,   MENU_PROFILER_RESET },
+                                                                { DIAGNOSTICS_VIEW,   MENU_PROFILER_RESET } };
+
+#endif
+
+
+/*
+ * Defines an array of menuScreen entities. Located in Menu.c as views refer to its update handlers.
+ */
+extern const T_MenuView MENU_VIEWS[];
 
 
 /****************************************************************************************************
@@ -213,8 +331,11 @@ const static T_MenuView MENU_VIEWS[] = { { PANEL_VIEW_FIELDS,       15 },
  ****************************************************************************************************/
 
 
+/* Changes the view on behalf of the main module */
+void Menu_ChangeToView(T_MenuSystem * pMenu, enum E_MenuStates view);
+
 /* Updates menu view with given information and returns a task for main module perform */
-inline uint8_t Menu_UpdateView(T_MenuSystem * pMenu, uint8_t buttonState, float * pMeasResults, T_CalibrationInfo * pCalibInfo);
+inline uint8_t Menu_UpdateView(T_MenuSystem * pMenu, uint8_t buttonState, uint16_t * pMeasResults, uint16_t changedResults, T_CalibrationInfo * pCalibInfo);
 
 
 #endif /* CHARGER_MENU_H_ */
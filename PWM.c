@@ -23,11 +23,24 @@
  ****************************************************************************************************/
 
 
-#include <msp430f2232.h>
-#include <intrinsics.h>
-
 #include "PWM.h"
 #include "Common.h"
+#include "Hal.h"
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+/* Current charging state */
+static int8_t chargingState = WRONG_BATTERY_VOLTAGE;
+
+/* Battery voltage limits in millivolts in the order of their indexes, written by the foreground */
+static volatile uint16_t limits[2] = { BATTERY_VOLTAGE_MIN, CHARGE_VOLTAGE_NOMINAL };
+
+/* Temperature compensated charge voltage in millivolts, written by the foreground */
+static volatile uint16_t chargeVoltage = CHARGE_VOLTAGE_NOMINAL;
 
 
 /****************************************************************************************************
@@ -35,14 +48,15 @@
  ****************************************************************************************************/
 
 /*
- * Updates PWM outputs for all panels according to measurement values of panels and battery.
+ * Updates PWM outputs for all panels according to measurement values of panels and battery in
+ * millivolts and milliamperes.
  */
-inline int8_t PWM_UpdateControl(float * measResults)
+inline int8_t PWM_UpdateControl(uint16_t * measResults)
 {
-    static int8_t chargingState = WRONG_BATTERY_VOLTAGE;
-           int8_t controlValue  = 0;
+    uint16_t controlValue = 0;
+    uint8_t  panel;
 
-    if((measResults[BATTERY_VOLTAGE] < 9.5f) || (measResults[BATTERY_VOLTAGE] >= 14.5f))
+    if((measResults[BATTERY_VOLTAGE] < limits[PWM_LIMIT_MINIMUM]) || (measResults[BATTERY_VOLTAGE] >= chargeVoltage))
         chargingState = WRONG_BATTERY_VOLTAGE;
 
     else if(WRONG_BATTERY_VOLTAGE == chargingState)
@@ -55,26 +69,85 @@ inline int8_t PWM_UpdateControl(float * measResults)
     case WRONG_BATTERY_VOLTAGE:
 
         /* If battery voltage is outside limits charging is off */
-        TACCR1 = 0;
-        TACCR2 = 0;
-        TBCCR1 = 0;
-        TBCCR2 = 0;
+        for(panel = 0; panel < 4; panel++)
+            Hal_SetPwmDuty(panel, 0);
         break;
 
     case START_UP:
 
-        if (measResults[PANEL_4_VOLTAGE] > (measResults[BATTERY_VOLTAGE] + 1.5f))
-            controlValue = 128 * (measResults[BATTERY_VOLTAGE] / (measResults[PANEL_4_VOLTAGE] - 1.0f)) * 1.05f;
+        /* 134 is 128 * 1.05 */
+        if (measResults[PANEL_4_VOLTAGE] > (measResults[BATTERY_VOLTAGE] + 1500))
+            controlValue = ((uint32_t)measResults[BATTERY_VOLTAGE] * 134) / (measResults[PANEL_4_VOLTAGE] - 1000);
         else
             controlValue = 0;
 
         if(controlValue > 125)
             controlValue = 125;
 
-        TBCCR2 = controlValue;
+        Hal_SetPwmDuty(3, controlValue);
 
         break;
     }
 
     return chargingState;
 }
+
+
+/*
+ * Sets the charge voltage for the battery temperature. The temperature is within the range of the
+ * sensor, -20 - 60 C, so the charge voltage is -0.6 - +0.8 V from the 25 C value, 13.9 - 15.3 V
+ * by default.
+ */
+void PWM_SetTemperature(int16_t temperature)
+{
+    if(TEMPERATURE_UNKNOWN == temperature)
+        chargeVoltage = limits[PWM_LIMIT_CHARGE];
+    else
+        chargeVoltage = limits[PWM_LIMIT_CHARGE] - (((int32_t)(temperature - 250) * CHARGE_VOLTAGE_PER_DEGREE) / 10);
+}
+
+
+/*
+ * Copies the duty cycles of the four PWM outputs in panel order.
+ */
+void PWM_GetDuties(uint8_t * pDuties)
+{
+    uint8_t panel;
+
+    for(panel = 0; panel < 4; panel++)
+        pDuties[panel] = Hal_GetPwmDuty(panel);
+}
+
+
+/*
+ * Continues charging from a saved charging state and duty cycles of the four PWM outputs
+ * in panel order. Used after a warm restart.
+ */
+void PWM_RestoreState(int8_t savedState, const uint8_t * pDuties)
+{
+    uint8_t panel;
+
+    chargingState = savedState;
+
+    for(panel = 0; panel < 4; panel++)
+        Hal_SetPwmDuty(panel, pDuties[panel]);
+}
+
+
+/*
+ * Returns a battery voltage limit in millivolts.
+ */
+uint16_t PWM_GetLimit(uint8_t limit)
+{
+    return limits[limit];
+}
+
+
+/*
+ * Sets a battery voltage limit in millivolts. A new charge voltage is compensated for the
+ * temperature when the temperature is set next.
+ */
+void PWM_SetLimit(uint8_t limit, uint16_t millivolts)
+{
+    limits[limit] = millivolts;
+}
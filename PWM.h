@@ -41,13 +41,41 @@
 #define WRONG_BATTERY_VOLTAGE  -1
 #define START_UP                0
 
+/*
+ * Battery voltage limits in millivolts at boot. Charging is off below the minimum and above the
+ * charge voltage. Charge voltage is 14.5 V at 25 C and it's compensated by -18 mV/C, -3 mV/C for
+ * each of the six lead-acid cells. Without a temperature sensor the 25 C value is used.
+ */
+#define BATTERY_VOLTAGE_MIN       9500
+#define CHARGE_VOLTAGE_NOMINAL    14500
+#define CHARGE_VOLTAGE_PER_DEGREE 18
+
+/* Indexes of the battery voltage limits */
+#define PWM_LIMIT_MINIMUM         0    /* Minimum battery voltage                   */
+#define PWM_LIMIT_CHARGE          1    /* Charge voltage at 25 C                    */
+
 
 /****************************************************************************************************
  *                                         GLOBAL FUNCTIONS
  ****************************************************************************************************/
 
 
-inline int8_t PWM_UpdateControl(float * measResults);
+inline int8_t PWM_UpdateControl(uint16_t * measResults);
+
+/* Sets the charge voltage for battery temperature in tenths of a degree Celsius */
+void PWM_SetTemperature(int16_t temperature);
+
+/* Copies the duty cycles of the four PWM outputs */
+void PWM_GetDuties(uint8_t * pDuties);
+
+/* Continues from a saved charging state and duty cycles */
+void PWM_RestoreState(int8_t savedState, const uint8_t * pDuties);
+
+/* Returns a battery voltage limit in millivolts */
+uint16_t PWM_GetLimit(uint8_t limit);
+
+/* Sets a battery voltage limit in millivolts */
+void PWM_SetLimit(uint8_t limit, uint16_t millivolts);
 
 
 #endif /* CHARGER_PWM_H_ */
@@ -0,0 +1,298 @@
+/*
+ * Profiler.c
+ *
+ * Profiler module measures the time each stage of the program takes on the board. Stage
+ * timestamps are PWM periods counted in the period interrupt of the tick combined with Timer_A's
+ * count, so they are in cycles of the 16 MHz crystal and wrap around after about 4.5 minutes.
+ * A run of a stage is added to it's minimum, maximum and sum. When the count of runs would
+ * overflow both the sum and the count are halved so the mean keeps following the runs.
+ *
+ * The tick is counted from the PWM periods of Timer_A, so tick interrupts should start exactly
+ * TICK_CYCLES apart. Latency of a tick is counted from the earliest start seen, thus it's the
+ * delay on top of the interrupt's own entry time: the instruction or the interrupts disabled
+ * section the tick had to wait for. At night the periods are stretched for the slow tick so
+ * nothing is measured until the morning, when the tick is found again.
+ *
+ * All figures are in a single block of RAM, 88 bytes, that can also be read with a debugger.
+ * Nothing here is built unless PROFILER is defined.
+ *
+ * Source includes functionality to:
+ * - keep the PWM periods counted in the period interrupt of the tick
+ * - read a consistent timestamp in and outside interrupts
+ * - add a run of a stage to it's figures and count overruns of it's budget
+ * - measure the latency of the tick interrupt
+ * - pause while Timer_A runs the slow tick
+ * - copy the figures for the diagnostics view
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include "Hal.h"
+#include "Profiler.h"
+#include "Timer.h"
+
+
+#ifdef PROFILER
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Tick interval of 8256 crystal cycles */
+#define TICK_CYCLES ((uint32_t)TIMER_TICK_PERIODS * HAL_PWM_PERIOD_CYCLES)
+
+/* Budgets of the stages in timer cycles, a longer run is an overrun. The stages of the control
+ * interrupt share the tick with the rest of the program so measuring and control may take a
+ * quarter of it each and button sampling a sixteenth. The foreground stages are preempted by
+ * the interrupts and a run longer than a tick delays the other tasks by a whole tick.        */
+const static uint16_t STAGE_BUDGETS[PROFILER_STAGE_COUNT] = { TICK_CYCLES / 4,     /* PROFILER_MEASURE */
+                                                              TICK_CYCLES / 4,     /* PROFILER_CONTROL */
+                                                              TICK_CYCLES / 16,    /* PROFILER_BUTTON  */
+                                                              TICK_CYCLES,         /* PROFILER_MENU    */
+                                                              TICK_CYCLES };       /* PROFILER_LCD     */
+
+
+/****************************************************************************************************
+ *                                           DATA TYPES
+ ****************************************************************************************************/
+
+
+/*
+ * Block of the profiler's figures and state.
+ */
+typedef struct
+{
+    T_ProfilerStage stages[PROFILER_STAGE_COUNT];
+    uint32_t        starts[PROFILER_STAGE_COUNT];  /* Timestamps of the running stages             */
+    uint32_t        expectedTick;                  /* Latest tick as it would be without latency */
+    uint16_t        maxLatency;
+    uint8_t         isTickFound;
+    uint8_t         isPaused;
+} T_ProfilerBlock;
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+/* PWM periods counted by the period interrupt of the tick */
+volatile uint32_t profilerPeriods = 0;
+
+static T_ProfilerBlock profiler;
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Returns the timestamp in timer cycles. Interrupts are disabled for the read so that the
+ * periods and the timer's count match.
+ */
+static uint32_t Profiler_ReadCycles(void)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+    uint32_t cycles         = Hal_TimerReadCycles(profilerPeriods);
+
+    Hal_RestoreInterrupts(interruptState);
+
+    return cycles;
+}
+
+
+/*
+ * Clears the figures of the stages and the latency. Must be called interrupts disabled.
+ */
+static void Profiler_ClearFigures(void)
+{
+    uint8_t i;
+
+    for(i = 0; i < PROFILER_STAGE_COUNT; i++)
+    {
+        profiler.stages[i].minimum  = 0xFFFF;
+        profiler.stages[i].maximum  = 0;
+        profiler.stages[i].sum      = 0;
+        profiler.stages[i].count    = 0;
+        profiler.stages[i].overruns = 0;
+    }
+
+    profiler.maxLatency = 0;
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Clears the figures and finds the tick again.
+ */
+void Profiler_Initialize(void)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+
+    Profiler_ClearFigures();
+    profiler.isTickFound = 0;
+
+    Hal_RestoreInterrupts(interruptState);
+}
+
+
+/*
+ * Clears the figures. The tick is kept.
+ */
+void Profiler_Reset(void)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+
+    Profiler_ClearFigures();
+
+    Hal_RestoreInterrupts(interruptState);
+}
+
+
+/*
+ * Measures the latency of the tick interrupt against the expected tick. A tick that comes
+ * earlier than expected moves the expected tick to it. Ticks that were missed altogether are
+ * skipped from the latency.
+ */
+void Profiler_MarkTick(void)
+{
+    uint32_t now;
+    uint32_t latency;
+
+    if(profiler.isPaused)
+        return;
+
+    now                    = Profiler_ReadCycles();
+    profiler.expectedTick += TICK_CYCLES;
+
+    latency = now - profiler.expectedTick;
+
+    if(!profiler.isTickFound || ((int32_t)latency < 0))
+    {
+        profiler.expectedTick = now;
+        profiler.isTickFound  = 1;
+        return;
+    }
+
+    while(latency >= TICK_CYCLES)
+    {
+        profiler.expectedTick += TICK_CYCLES;
+        latency               -= TICK_CYCLES;
+    }
+
+    if(latency > profiler.maxLatency)
+        profiler.maxLatency = latency;
+}
+
+
+/*
+ * Timestamps the start of a stage.
+ */
+void Profiler_Start(uint8_t stage)
+{
+    if(!profiler.isPaused)
+        profiler.starts[stage] = Profiler_ReadCycles();
+}
+
+
+/*
+ * Timestamps the end of a stage and adds the run to it's figures. Runs longer than 0xFFFF
+ * cycles are counted as 0xFFFF. The figures are updated interrupts disabled as interrupt stages
+ * update them too.
+ */
+void Profiler_End(uint8_t stage)
+{
+    uint32_t          duration;
+    T_ProfilerStage * pStage   = &profiler.stages[stage];
+    uint16_t          interruptState;
+
+    if(profiler.isPaused)
+        return;
+
+    duration = Profiler_ReadCycles() - profiler.starts[stage];
+
+    if(duration > 0xFFFF)
+        duration = 0xFFFF;
+
+    interruptState = Hal_DisableInterrupts();
+
+    if(duration < pStage->minimum)
+        pStage->minimum = duration;
+
+    if(duration > pStage->maximum)
+        pStage->maximum = duration;
+
+    if(duration > STAGE_BUDGETS[stage])
+        pStage->overruns++;
+
+    if(0xFFFF == pStage->count)
+    {
+        pStage->sum   >>= 1;
+        pStage->count >>= 1;
+    }
+
+    pStage->sum += duration;
+    pStage->count++;
+
+    Hal_RestoreInterrupts(interruptState);
+}
+
+
+/*
+ * Pauses the profiler for the slow tick or continues after it. The stages that are running
+ * when profiling continues are timed from there and the tick is found again.
+ */
+void Profiler_Pause(uint8_t isPaused)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+    uint32_t now            = Profiler_ReadCycles();
+    uint8_t  stage;
+
+    for(stage = 0; stage < PROFILER_STAGE_COUNT; stage++)
+        profiler.starts[stage] = now;
+
+    profiler.isPaused    = isPaused;
+    profiler.isTickFound = 0;
+
+    Hal_RestoreInterrupts(interruptState);
+}
+
+
+/*
+ * Copies the figures of a stage. A stage that hasn't run has it's minimum at 0.
+ */
+void Profiler_GetStage(uint8_t stage, T_ProfilerStage * pStage)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+
+    *pStage = profiler.stages[stage];
+
+    Hal_RestoreInterrupts(interruptState);
+
+    if(0 == pStage->count)
+        pStage->minimum = 0;
+}
+
+
+/*
+ * Returns the worst latency of the tick interrupt in timer cycles.
+ */
+uint16_t Profiler_GetMaxLatency(void)
+{
+    return profiler.maxLatency;
+}
+
+#endif /* PROFILER */
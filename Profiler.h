@@ -0,0 +1,146 @@
+/*
+ * Profiler.h
+ *
+ * Profiler module measures the time each stage of the program takes on the board: measuring
+ * and control in the control interrupt, button sampling in the tick interrupt and the menu and
+ * LCD tasks of the main loop. A stage is timestamped when it starts and ends and the profiler
+ * keeps it's minimum, maximum and mean in timer cycles and counts the runs that went over the
+ * stage's budget. It also keeps the worst latency of the tick interrupt. The figures are shown
+ * in a hidden diagnostics view of the menu.
+ *
+ * Both timers run the PWM outputs and the watchdog timer's count can't be read so there's no
+ * free-running timer. The profiler counts PWM periods in the period interrupt of the system
+ * tick and the timestamp is the periods times the period plus Timer_A's count, in cycles of the
+ * 16 MHz crystal. Counting the periods in 32 bits adds a few cycles to the period interrupt
+ * every 8 us, which the figures of the foreground stages include. At night Timer_A's periods
+ * are stretched for the slow tick so the profiler is paused until the morning.
+ *
+ * The profiler is built only when PROFILER is defined. Otherwise the macros used to call it
+ * compile to nothing and the diagnostics view is left out of the menu.
+ *
+ * Header includes:
+ * - stage indexes and the figures of a stage
+ * - macros that call the profiler when it's built
+ * - global functions for timestamping the stages and the tick and reading the figures
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_PROFILER_H_
+#define CHARGER_PROFILER_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Stages of the program */
+#define PROFILER_MEASURE     0
+#define PROFILER_CONTROL     1
+#define PROFILER_BUTTON      2
+#define PROFILER_MENU        3
+#define PROFILER_LCD         4
+#define PROFILER_STAGE_COUNT 5
+
+#ifdef PROFILER
+
+#define PROFILER_INITIALIZE()  Profiler_Initialize()
+#define PROFILER_RESET()       Profiler_Reset()
+#define PROFILER_MARK_TICK()   Profiler_MarkTick()
+#define PROFILER_START(stage)  Profiler_Start(stage)
+#define PROFILER_END(stage)    Profiler_End(stage)
+#define PROFILER_PAUSE(isPaused) Profiler_Pause(isPaused)
+
+/* Counted in the period interrupt without a call so that the interrupt saves no registers */
+#define PROFILER_COUNT_PERIOD() (profilerPeriods++)
+
+#else
+
+#define PROFILER_INITIALIZE()
+#define PROFILER_RESET()
+#define PROFILER_MARK_TICK()
+#define PROFILER_START(stage)
+#define PROFILER_END(stage)
+#define PROFILER_PAUSE(isPaused)
+#define PROFILER_COUNT_PERIOD()
+
+#endif
+
+
+/****************************************************************************************************
+ *                                           DATA TYPES
+ ****************************************************************************************************/
+
+
+/*
+ * Figures of a single stage in timer cycles. The mean is sum / count.
+ */
+typedef struct
+{
+    uint16_t minimum;
+    uint16_t maximum;
+    uint32_t sum;
+    uint16_t count;
+    uint16_t overruns;             /* Runs longer than the stage's budget */
+} T_ProfilerStage;
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+#ifdef PROFILER
+
+/* PWM periods counted by the period interrupt of the tick */
+extern volatile uint32_t profilerPeriods;
+
+#endif
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+#ifdef PROFILER
+
+/* Clears the figures and starts counting PWM periods. Called after the timers are started. */
+void Profiler_Initialize(void);
+
+/* Clears the figures */
+void Profiler_Reset(void);
+
+/* Measures the latency of the tick interrupt. Called first in the interrupt. */
+void Profiler_MarkTick(void);
+
+/* Timestamps the start of a stage */
+void Profiler_Start(uint8_t stage);
+
+/* Timestamps the end of a stage and adds the run to it's figures */
+void Profiler_End(uint8_t stage);
+
+/* Pauses or continues profiling while Timer_A doesn't run PWM periods */
+void Profiler_Pause(uint8_t isPaused);
+
+/* Copies the figures of a stage */
+void Profiler_GetStage(uint8_t stage, T_ProfilerStage * pStage);
+
+/* Returns the worst latency of the tick interrupt in timer cycles */
+uint16_t Profiler_GetMaxLatency(void);
+
+#endif
+
+
+#endif /* CHARGER_PROFILER_H_ */
@@ -0,0 +1,124 @@
+/*
+ * Scheduler.c
+ *
+ * Scheduler module runs the program's tasks cooperatively with the system tick. Each task
+ * has a period and a deadline in milliseconds. Tasks are checked in their order in the task
+ * table so the first tasks have the highest priority. A task that's due is run to the end
+ * and when no task is due the CPU sleeps in a low power mode until the next tick interrupt
+ * wakes it up.
+ *
+ * Source includes functionality to:
+ * - initialize task statuses
+ * - release a task before it's period
+ * - run due tasks and measure their duration and lateness
+ * - put the CPU to sleep between ticks in the chosen low power mode
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include "Hal.h"
+#include "Scheduler.h"
+#include "Timer.h"
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+/* Low power mode bits used when no task is due */
+static uint16_t sleepBits = LPM0_bits;
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Initializes task statuses so that all tasks are due at once.
+ */
+void Scheduler_Initialize(T_TaskStatus * pStatus, uint8_t taskCount)
+{
+    uint32_t now = Timer_GetMilliseconds();
+    uint8_t  i;
+
+    for(i = 0; i < taskCount; i++)
+    {
+        pStatus[i].release     = now;
+        pStatus[i].overruns    = 0;
+        pStatus[i].maxDuration = 0;
+    }
+}
+
+
+/*
+ * Makes a task due at once regardless of it's period. Used when an event needs the task's
+ * output before it would be normally run. Following releases continue from now on.
+ */
+void Scheduler_ReleaseTask(T_TaskStatus * pStatus)
+{
+    pStatus->release = Timer_GetMilliseconds();
+}
+
+
+/*
+ * Sets the low power mode the CPU sleeps in between ticks, e.g. LPM0_bits or LPM3_bits.
+ * The tick interrupt must clear the bits of the deepest mode used.
+ */
+void Scheduler_SetSleepMode(uint16_t lowPowerBits)
+{
+    sleepBits = lowPowerBits;
+}
+
+
+/*
+ * Runs the tasks that are due in priority order. After a task has been run it's checked
+ * whether it finished after it's deadline and it's next release is set. If no task was
+ * due the CPU is put to sleep to wait for the next tick.
+ */
+void Scheduler_RunDueTasks(const T_Task * pTasks, T_TaskStatus * pStatus, uint8_t taskCount)
+{
+    uint8_t  i;
+    uint8_t  isTaskRun = 0;
+    uint32_t start;
+    uint32_t end;
+
+    for(i = 0; i < taskCount; i++)
+    {
+        start = Timer_GetMilliseconds();
+
+        /* Signed difference handles the wrap around of the millisecond clock */
+        if((int32_t)(start - pStatus[i].release) < 0)
+            continue;
+
+        pTasks[i].pfTask();
+        isTaskRun = 1;
+
+        end = Timer_GetMilliseconds();
+
+        if((end - start) > pStatus[i].maxDuration)
+            pStatus[i].maxDuration = end - start;
+
+        if((int32_t)(end - (pStatus[i].release + pTasks[i].deadline)) > 0)
+            pStatus[i].overruns++;
+
+        /* Next release is one period later. If it has already passed the task has missed
+         * releases and it's run once as soon as possible.                               */
+        pStatus[i].release += pTasks[i].period;
+
+        if((int32_t)(end - pStatus[i].release) > 0)
+            pStatus[i].release = end;
+    }
+
+    /* Nothing to do until the next tick wakes the CPU up */
+    if(!isTaskRun)
+        Hal_Sleep(sleepBits);
+}
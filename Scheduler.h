@@ -0,0 +1,85 @@
+/*
+ * Scheduler.h
+ *
+ * Scheduler module runs the program's tasks cooperatively with the system tick. Each task
+ * has a period and a deadline in milliseconds. Tasks are checked in their order in the task
+ * table so the first tasks have the highest priority. A task that's due is run to the end
+ * and when no task is due the CPU sleeps in LPM0, or in LPM3 when set so, until the next tick
+ * interrupt wakes it up.
+ *
+ * For each task the scheduler keeps a status of the next release time, the number of times
+ * the task has finished after it's deadline (overruns) and the longest time it has taken.
+ * If a task misses releases it's run as soon as possible once and the following releases
+ * continue from there.
+ *
+ * Scheduler uses Timer module's millisecond clock as it's time base.
+ *
+ * Header includes:
+ * - task and task status data types
+ * - global functions for initializing the scheduler, setting the sleep mode, releasing and
+ *   running the tasks
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_SCHEDULER_H_
+#define CHARGER_SCHEDULER_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+
+/****************************************************************************************************
+ *                                           DATA TYPES
+ ****************************************************************************************************/
+
+
+/*
+ * Defines a single task with it's function, period and deadline in milliseconds. Deadline is
+ * counted from the time the task was due.
+ */
+typedef struct
+{
+    void        (* const pfTask)(void);
+    const uint16_t       period;
+    const uint16_t       deadline;
+} T_Task;
+
+
+/*
+ * Run time status of a single task.
+ */
+typedef struct
+{
+    uint32_t release;
+    uint16_t overruns;
+    uint16_t maxDuration;
+} T_TaskStatus;
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/* Initializes task statuses so that all tasks are due at once */
+void Scheduler_Initialize(T_TaskStatus * pStatus, uint8_t taskCount);
+
+/* Makes a task due at once regardless of it's period */
+void Scheduler_ReleaseTask(T_TaskStatus * pStatus);
+
+/* Sets the low power mode used between ticks */
+void Scheduler_SetSleepMode(uint16_t lowPowerBits);
+
+/* Runs the tasks that are due and sleeps until the next tick if none was */
+void Scheduler_RunDueTasks(const T_Task * pTasks, T_TaskStatus * pStatus, uint8_t taskCount);
+
+
+#endif /* CHARGER_SCHEDULER_H_ */
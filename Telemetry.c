@@ -0,0 +1,194 @@
+/*
+ * Telemetry.c
+ *
+ * Telemetry module streams binary records of the charger's state over the UART. A record is
+ * made only if the whole frame fits to the UART ring, otherwise it's dropped and counted, so
+ * making a record never waits. The payload is put straight to the ring while the CRC is
+ * counted, so no copy of the record is kept in RAM.
+ *
+ * The CRC is counted four bits at a time with a 16 entry table which is a compromise between
+ * the speed of a 256 entry table and the size of bitwise counting.
+ *
+ * Source includes functionality to:
+ * - keep the period of the records
+ * - frame a record with a sequence number and a CRC
+ * - drop records that don't fit to the UART ring
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include "Telemetry.h"
+#include "Uart.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Start byte of a frame */
+#define FRAME_START 0xA5
+
+/* Bytes of a frame around the payload: start, length, sequence and CRC */
+#define FRAME_OVERHEAD 6
+
+#define CRC_INITIAL 0xFFFF
+
+/* CRC-16/CCITT of the values of a nibble */
+const static uint16_t CRC_TABLE[16] = { 0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+                                        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF };
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+static uint16_t period   = TELEMETRY_DEFAULT_PERIOD_MS;
+static uint32_t dueTime  = 0;        /* Millisecond clock value when the next record is due */
+static uint16_t sequence = 0;
+static uint16_t dropped  = 0;
+static uint16_t crc      = CRC_INITIAL; /* CRC of the record being made                  */
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Puts a byte to the UART ring and adds it to the CRC.
+ */
+static void Telemetry_Put(uint8_t value)
+{
+    crc = (crc << 4) ^ CRC_TABLE[(crc >> 12) ^ (value >> 4)];
+    crc = (crc << 4) ^ CRC_TABLE[(crc >> 12) ^ (value & 0x0F)];
+
+    Uart_Put(value);
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Sets the period of the records in milliseconds, 0 stops them.
+ */
+void Telemetry_SetPeriod(uint16_t newPeriod)
+{
+    period = newPeriod;
+}
+
+
+/*
+ * Returns the period of the records in milliseconds.
+ */
+uint16_t Telemetry_GetPeriod(void)
+{
+    return period;
+}
+
+
+/*
+ * Returns the number of records dropped since boot.
+ */
+uint16_t Telemetry_GetDropped(void)
+{
+    return dropped;
+}
+
+
+/*
+ * Returns 1 if a record is due. Records keep to the period unless they fall behind more than a
+ * period, then the next one is a period from now.
+ */
+uint8_t Telemetry_IsDue(uint32_t milliseconds)
+{
+    if((0 == period) || ((int32_t)(milliseconds - dueTime) < 0))
+        return 0;
+
+    dueTime += period;
+
+    if((int32_t)(milliseconds - dueTime) >= 0)
+        dueTime = milliseconds + period;
+
+    return 1;
+}
+
+
+/*
+ * Starts a record with the given payload length if the whole frame fits to the UART ring.
+ * A dropped record takes it's sequence number so the receiver sees the gap.
+ */
+uint8_t Telemetry_StartRecord(uint8_t length)
+{
+    if(Uart_GetFree() < (length + FRAME_OVERHEAD))
+    {
+        sequence++;
+        dropped++;
+        return 0;
+    }
+
+    Uart_Put(FRAME_START);
+
+    crc = CRC_INITIAL;
+
+    Telemetry_Put(length);
+    Telemetry_PutWord(sequence);
+
+    sequence++;
+
+    return 1;
+}
+
+
+/*
+ * Puts a byte of the payload.
+ */
+void Telemetry_PutByte(uint8_t value)
+{
+    Telemetry_Put(value);
+}
+
+
+/*
+ * Puts a 16-bit value of the payload, low byte first.
+ */
+void Telemetry_PutWord(uint16_t value)
+{
+    Telemetry_Put((uint8_t)value);
+    Telemetry_Put((uint8_t)(value >> 8));
+}
+
+
+/*
+ * Puts a 32-bit value of the payload, low byte first.
+ */
+void Telemetry_PutLong(uint32_t value)
+{
+    Telemetry_PutWord((uint16_t)value);
+    Telemetry_PutWord((uint16_t)(value >> 16));
+}
+
+
+/*
+ * Ends the record with it's CRC and hands it to the UART.
+ */
+void Telemetry_EndRecord(void)
+{
+    uint16_t frameCrc = crc;
+
+    Uart_Put((uint8_t)frameCrc);
+    Uart_Put((uint8_t)(frameCrc >> 8));
+
+    Uart_Send();
+}
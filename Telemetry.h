@@ -0,0 +1,74 @@
+/*
+ * Telemetry.h
+ *
+ * Telemetry module streams binary records of the charger's state over the UART at a set
+ * period. A record is framed as
+ *
+ *   0xA5, length, sequence (2 bytes), payload (length bytes), CRC (2 bytes)
+ *
+ * with multi-byte values little-endian. The CRC is CRC-16/CCITT-FALSE (polynomial 0x1021,
+ * initial value 0xFFFF) over the length, the sequence and the payload. A receiver finds a frame
+ * by the start byte and checks it with the CRC. The sequence counts every record made, so a
+ * gap in it tells the number of records dropped as the UART ring had no room for them. The
+ * payload is defined by the main module.
+ *
+ * Header includes:
+ * - the default period
+ * - global functions for setting the period and making records
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_TELEMETRY_H_
+#define CHARGER_TELEMETRY_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Period of the records in milliseconds at boot, 0 stops the records */
+#define TELEMETRY_DEFAULT_PERIOD_MS 100
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/* Sets the period of the records in milliseconds, 0 stops them */
+void Telemetry_SetPeriod(uint16_t period);
+
+/* Returns the period of the records in milliseconds */
+uint16_t Telemetry_GetPeriod(void);
+
+/* Returns the number of records dropped since boot */
+uint16_t Telemetry_GetDropped(void);
+
+/* Returns 1 if a record is due at the given time of the millisecond clock */
+uint8_t Telemetry_IsDue(uint32_t milliseconds);
+
+/* Starts a record with the given payload length. Returns 0 if the record was dropped. */
+uint8_t Telemetry_StartRecord(uint8_t length);
+
+/* Put the payload of a started record */
+void Telemetry_PutByte(uint8_t value);
+void Telemetry_PutWord(uint16_t value);
+void Telemetry_PutLong(uint32_t value);
+
+/* Ends a started record with it's CRC and sends it */
+void Telemetry_EndRecord(void);
+
+
+#endif /* CHARGER_TELEMETRY_H_ */
@@ -0,0 +1,334 @@
+/*
+ * Timer.c
+ *
+ * Timer module keeps the system time. Both Timer_A and Timer_B are reserved for the PWM
+ * outputs and the watchdog timer is used as a watchdog, so the system tick is counted from the
+ * PWM periods of Timer_A. The period interrupt of CCR0 comes every 129 cycles of the 16 MHz
+ * crystal. It only counts down and on the last period of a tick enables the overflow interrupt,
+ * whose flag is already set, so the tick runs in the overflow interrupt every 8256 cycles, thus
+ * every 516 microseconds. Each tick is added to a 32-bit millisecond clock which wraps around
+ * after about 49 days.
+ *
+ * The period interrupt comes 124 000 times a second and takes about a seventh of the CPU. It's
+ * kept without function calls so that it saves no registers. The tick enables interrupts while
+ * it runs so that no period is missed, a tick that comes meanwhile is run late right after it.
+ * At night the PWM outputs are off and the periods are stretched to 31.25 ms, one period for
+ * each tick, so the CPU sleeps between the ticks.
+ *
+ * Software timers are kept in a fixed pool. Running timers form a list sorted by their expiry
+ * time, linked with pool indexes, so checking the next expiry on each tick is O(1) and only
+ * starting a timer walks the list.
+ *
+ * Source includes functionality to:
+ * - count PWM periods and start the system tick
+ * - count ticks into milliseconds
+ * - change Timer_A between the PWM periods and the slow tick of the night
+ * - read the millisecond clock consistently outside the tick interrupt
+ * - start, stop and expire one-shot and periodic software timers
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include "Hal.h"
+#include "Profiler.h"
+#include "Timer.h"
+
+
+/****************************************************************************************************
+ *                                           DATA TYPES
+ ****************************************************************************************************/
+
+
+/*
+ * A single software timer of the pool.
+ */
+typedef struct
+{
+    uint32_t expiry;               /* Millisecond clock value when the timer expires */
+    uint16_t period;               /* 0 for one-shot timers                          */
+    void  (* pfCallback)(void);    /* NULL when the timer is free                    */
+    uint8_t  next;                 /* Next running timer in the list                 */
+} T_SoftwareTimer;
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+/* Millisecond clock and the microseconds of the current millisecond */
+static volatile uint32_t milliseconds = 0;
+static          uint16_t microseconds = 0;
+
+/* Length of the current tick */
+static          uint16_t tickMicroseconds = TIMER_TICK_MICROSECONDS;
+
+/* Periods of a tick and the periods left until the next tick */
+static          uint16_t tickDivider = TIMER_TICK_PERIODS;
+static volatile uint16_t tickPeriods = TIMER_TICK_PERIODS;
+
+/* Tick interrupt is running and the next tick came meanwhile */
+static volatile uint8_t  isTickRunning = 0;
+static volatile uint8_t  isTickLate    = 0;
+
+/* Software timer pool and the running timer which expires first */
+static T_SoftwareTimer timers[TIMER_COUNT];
+static uint8_t         timerHead = TIMER_NONE;
+
+
+/****************************************************************************************************
+ *                                         LOCAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Adds a timer to the running timer list in the order of expiry times. Timers with the same
+ * expiry time are expired in the order they were added. Must be called interrupts disabled.
+ */
+static void Timer_Insert(uint8_t timer)
+{
+    uint8_t * pLink = &timerHead;
+
+    /* Signed difference handles the wrap around of the millisecond clock */
+    while((TIMER_NONE != *pLink) && ((int32_t)(timers[*pLink].expiry - timers[timer].expiry) <= 0))
+        pLink = &timers[*pLink].next;
+
+    timers[timer].next = *pLink;
+    *pLink             = timer;
+}
+
+
+/*
+ * Removes a timer from the running timer list if it's there. Must be called interrupts disabled.
+ */
+static void Timer_Remove(uint8_t timer)
+{
+    uint8_t * pLink = &timerHead;
+
+    while((TIMER_NONE != *pLink) && (timer != *pLink))
+        pLink = &timers[*pLink].next;
+
+    if(TIMER_NONE != *pLink)
+        *pLink = timers[timer].next;
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Counts the PWM periods of Timer_A and starts the tick after the periods of a tick by enabling
+ * the overflow interrupt. If the previous tick is still running the tick is marked late instead
+ * and Timer_EndTick starts it.
+ */
+#pragma vector=TIMERA0_VECTOR
+__interrupt void Timer_PeriodISR(void)
+{
+    PROFILER_COUNT_PERIOD();
+
+    if(--tickPeriods)
+        return;
+
+    tickPeriods = tickDivider;
+
+    if(isTickRunning)
+        isTickLate = 1;
+    else
+        Hal_TimerEnableOverflow();
+}
+
+
+/*
+ * Starts the system tick by enabling the period interrupt of CCR0. Timer_A must already run
+ * the PWM periods from the crystal.
+ */
+void Timer_Initialize(void)
+{
+    TACCTL0 = CCIE;
+}
+
+
+/*
+ * Starts the tick in the overflow interrupt. The overflow interrupt is disabled until the next
+ * tick and interrupts are enabled so that the period interrupt counts the periods while the
+ * tick runs.
+ */
+void Timer_BeginTick(void)
+{
+    Hal_TimerDisableOverflow();
+    isTickRunning = 1;
+
+    Hal_EnableInterrupts();
+}
+
+
+/*
+ * Ends the tick and disables interrupts until the return from the interrupt. If the next tick
+ * came while this one was running it's started at once after the return. Returns 1 if the next
+ * tick is late.
+ */
+uint8_t Timer_EndTick(void)
+{
+    uint8_t isLate;
+
+    (void)Hal_DisableInterrupts();
+
+    isTickRunning = 0;
+    isLate        = isTickLate;
+
+    if(isLate)
+    {
+        isTickLate = 0;
+        Hal_TimerEnableOverflow();
+    }
+
+    return isLate;
+}
+
+
+/*
+ * Advances the millisecond clock by one tick and expires the software timers that are due.
+ */
+void Timer_Tick(void)
+{
+    microseconds += tickMicroseconds;
+
+    /* A slow tick is longer than a millisecond */
+    while(microseconds >= 1000)
+    {
+        microseconds -= 1000;
+        milliseconds++;
+    }
+
+    /* Expire all timers that are due. A periodic timer is put back to the list before it's
+     * callback so the callback may stop it.                                              */
+    while((TIMER_NONE != timerHead) && ((int32_t)(milliseconds - timers[timerHead].expiry) >= 0))
+    {
+        uint8_t timer = timerHead;
+        void (* pfCallback)(void) = timers[timer].pfCallback;
+
+        timerHead = timers[timer].next;
+
+        if(timers[timer].period)
+        {
+            timers[timer].expiry += timers[timer].period;
+            Timer_Insert(timer);
+        }
+        else
+        {
+            timers[timer].pfCallback = 0;
+        }
+
+        pfCallback();
+    }
+}
+
+
+/*
+ * Changes Timer_A between the PWM periods of the normal tick and the slow tick. The slow tick
+ * divides the crystal by 8 and stretches the period to 62500 cycles, a tick of its own, so
+ * the period interrupt that comes every 8 us by day wakes the CPU only 32 times a second at
+ * night. The PWM outputs of Timer_A must be off meanwhile. The timer is cleared so the tick
+ * in progress starts again with the new length, the part of it that had run is lost from the
+ * millisecond clock. The profiler is paused as the periods aren't PWM periods.
+ */
+void Timer_SetSlowTick(uint8_t isSlow)
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+
+    if(isSlow)
+    {
+        TACTL           |= ID_3;
+        TACCR0           = TIMER_SLOW_TICK_CYCLES - 1;
+        tickDivider      = 1;
+        tickMicroseconds = TIMER_SLOW_TICK_MICROSECONDS;
+    }
+    else
+    {
+        TACTL           &= ~ID_3;
+        TACCR0           = HAL_PWM_PERIOD_CYCLES - 1;
+        tickDivider      = TIMER_TICK_PERIODS;
+        tickMicroseconds = TIMER_TICK_MICROSECONDS;
+    }
+
+    TACTL       |= TACLR;
+    tickPeriods  = tickDivider;
+
+    PROFILER_PAUSE(isSlow);
+
+    Hal_RestoreInterrupts(interruptState);
+}
+
+
+/*
+ * Returns the milliseconds since the tick was started. The 32-bit value is read in two
+ * parts so it's read again if the tick interrupt changed it in between.
+ */
+uint32_t Timer_GetMilliseconds(void)
+{
+    uint32_t result;
+
+    do
+        result = milliseconds;
+    while(result != milliseconds);
+
+    return result;
+}
+
+
+/*
+ * Starts a free software timer from the pool. The timer expires after delay milliseconds and
+ * then every period milliseconds unless period is 0. Interrupt state is saved and restored so
+ * the function can be used both from the main loop and from interrupts. Returns the started
+ * timer or TIMER_NONE if the pool is full.
+ */
+uint8_t Timer_Start(uint32_t delay, uint16_t period, void (* pfCallback)(void))
+{
+    uint16_t interruptState = Hal_DisableInterrupts();
+    uint8_t  timer;
+
+    for(timer = 0; timer < TIMER_COUNT; timer++)
+    {
+        if(!timers[timer].pfCallback)
+        {
+            timers[timer].expiry     = milliseconds + delay;
+            timers[timer].period     = period;
+            timers[timer].pfCallback = pfCallback;
+            Timer_Insert(timer);
+            break;
+        }
+    }
+
+    Hal_RestoreInterrupts(interruptState);
+
+    return (timer < TIMER_COUNT) ? timer : TIMER_NONE;
+}
+
+
+/*
+ * Stops a running software timer and frees it. A one-shot timer is freed already when it
+ * expires so it mustn't be stopped after that as it may have been given to another user.
+ */
+void Timer_Stop(uint8_t timer)
+{
+    uint16_t interruptState;
+
+    if(timer >= TIMER_COUNT)
+        return;
+
+    interruptState = Hal_DisableInterrupts();
+
+    Timer_Remove(timer);
+    timers[timer].pfCallback = 0;
+
+    Hal_RestoreInterrupts(interruptState);
+}
@@ -0,0 +1,94 @@
+/*
+ * Timer.h
+ *
+ * Timer module keeps the system time. Both Timer_A and Timer_B run the PWM outputs and the
+ * watchdog timer supervises the main loop, so the system tick is counted from the PWM periods
+ * of Timer_A, which runs from ACLK's 16 MHz crystal. The period interrupt of CCR0 counts 64
+ * periods of 129 cycles and then starts the tick in Timer_A's overflow interrupt, thus the
+ * tick comes every 8256 cycles or 516 microseconds. Each tick is added to a 32-bit millisecond
+ * clock which wraps around after about 49 days. At night the PWM outputs are off and Timer_A
+ * is changed to the slow tick: it divides the crystal by 8 and a period is 62500 cycles, so
+ * each period is a tick of 31.25 ms and the CPU wakes up 32 times a second.
+ *
+ * On top of the millisecond clock Timer module offers a small pool of software timers. A timer
+ * is either one-shot or periodic and calls it's callback function when it expires. Running
+ * timers are kept in a list sorted by their expiry time so each tick only checks the head of
+ * the list. Callbacks are called from the tick interrupt so they must be short. Timers can be
+ * started and stopped both from the main loop and from interrupts. The Charger module times
+ * the delay before night mode with a one-shot timer.
+ *
+ * The tick interrupt itself is in the Charger module which calls Timer_Tick and then the
+ * other submodules that need to be run with the tick. It's started with Timer_BeginTick which
+ * lets the period interrupt count the periods while the tick runs and ended with Timer_EndTick.
+ *
+ * Header includes:
+ * - tick length and timer pool definitions
+ * - global functions for initializing the tick, reading the millisecond clock and using
+ *   software timers
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_TIMER_H_
+#define CHARGER_TIMER_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* PWM periods and length of a single system tick: 64 * 129 / 16 MHz = 516 us */
+#define TIMER_TICK_PERIODS      64
+#define TIMER_TICK_MICROSECONDS 516
+
+/* Timer_A period and length of the slow tick used at night: 62500 * 8 / 16 MHz = 31250 us */
+#define TIMER_SLOW_TICK_CYCLES       62500
+#define TIMER_SLOW_TICK_MICROSECONDS 31250
+
+/* Number of software timers in the pool */
+#define TIMER_COUNT 4
+
+/* Returned when no software timer is available and used to end the timer list */
+#define TIMER_NONE  0xFF
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/* Starts the system tick from the PWM periods of Timer_A */
+void Timer_Initialize(void);
+
+/* Start and end the tick interrupt. Timer_EndTick returns 1 if the next tick is late. */
+void    Timer_BeginTick(void);
+uint8_t Timer_EndTick(void);
+
+/* Advances the millisecond clock by one tick. Called from the tick interrupt. */
+void Timer_Tick(void);
+
+/* Changes between the normal and the slow tick. The slow tick stops the PWM periods of Timer_A. */
+void Timer_SetSlowTick(uint8_t isSlow);
+
+/* Returns the milliseconds since the tick was started */
+uint32_t Timer_GetMilliseconds(void);
+
+/* Starts a software timer expiring after delay. Period 0 makes it one-shot. Returns the timer or TIMER_NONE. */
+uint8_t Timer_Start(uint32_t delay, uint16_t period, void (* pfCallback)(void));
+
+/* Stops a running software timer */
+void Timer_Stop(uint8_t timer);
+
+
+#endif /* CHARGER_TIMER_H_ */
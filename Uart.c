@@ -0,0 +1,202 @@
+/*
+ * Uart.c
+ *
+ * Uart module sends messages over USCI A0 in UART mode. The USCI is clocked from the 16 MHz
+ * crystal's ACLK which runs in LPM3 too, so sending continues at night. 16 MHz / 115200 is
+ * 138.9 so the divider is 138 and the second stage modulation 0.9 * 8 = 7.
+ *
+ * The transmit ring has a write index private to the main loop, a head that publishes the
+ * written bytes to the interrupt and a tail that only the interrupt moves. Bytes are put after
+ * the write index and published all at once, so the interrupt never sends half of a message.
+ * Indexes are single bytes which MSP430 reads and writes atomically.
+ *
+ * Received text is collected a line at a time to a single buffer by the receive interrupt. When
+ * the line ends the buffer is handed to the main loop and bytes received before the main loop
+ * releases it are dropped. Lines are only collected here, the main loop parses them.
+ *
+ * Source includes functionality to:
+ * - configure USCI A0 for UART
+ * - put messages to the ring and publish them
+ * - send the ring from the transmit interrupt and stop it when the ring is empty
+ * - collect received lines in the receive interrupt
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include "Hal.h"
+#include "Uart.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Length of the transmit ring, must be a power of two. One byte is left unused so that a full
+ * ring can be told from an empty one.                                                        */
+#define TX_RING_LENGTH 128
+
+/* Length of the receive line buffer with the terminating null */
+#define RX_LINE_LENGTH 32
+
+/* States of the receive line buffer */
+#define RX_COLLECTING  0    /* Interrupt collects a line                         */
+#define RX_READY       1    /* Line ended and it's handed to the main loop       */
+#define RX_TOO_LONG    2    /* Line ended and it was longer than the buffer      */
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+static uint8_t          txRing[TX_RING_LENGTH];
+static uint8_t          txWrite      = 0;    /* Next byte to put, main loop only       */
+static volatile uint8_t txHead       = 0;    /* End of the published bytes             */
+static volatile uint8_t txTail       = 0;    /* Next byte to send, interrupt only      */
+
+static char             rxLine[RX_LINE_LENGTH];
+static uint8_t          rxLength     = 0;    /* Bytes collected, interrupt only        */
+static uint8_t          isRxOverflow = 0;    /* Bytes were dropped from the line       */
+static volatile uint8_t rxState      = RX_COLLECTING;
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Configures USCI A0 as a 115200 baud UART, 8 data bits, no parity and one stop bit.
+ */
+void Uart_Initialize(void)
+{
+    UCA0CTL1  = UCSWRST;          /* USCI reset ON                                     */
+    UCA0CTL0  = 0;                /* UART mode, 8N1, LSB first                         */
+    UCA0CTL1 |= UCSSEL_1;         /* Select ACLK which is configured for 16 MHz crystal */
+
+    UCA0BR0   = 138;
+    UCA0BR1   = 0;
+    UCA0MCTL  = UCBRS_7;
+
+    UCA0CTL1 &= ~UCSWRST;         /* USCI reset OFF                                    */
+
+    Hal_UartEnableRxInterrupt();
+}
+
+
+/*
+ * Returns the number of bytes that can be put to the ring.
+ */
+uint8_t Uart_GetFree(void)
+{
+    return (txTail - txWrite - 1) & (TX_RING_LENGTH - 1);
+}
+
+
+/*
+ * Puts a byte after the bytes put earlier.
+ */
+void Uart_Put(uint8_t data)
+{
+    txRing[txWrite] = data;
+    txWrite         = (txWrite + 1) & (TX_RING_LENGTH - 1);
+}
+
+
+/*
+ * Publishes the bytes put so far and starts the transmit interrupt. If the interrupt has just
+ * emptied the ring it's started again here.
+ */
+void Uart_Send(void)
+{
+    txHead = txWrite;
+
+    Hal_UartEnableTxInterrupt();
+}
+
+
+/*
+ * Sends the next published byte and stops the interrupt after the last one.
+ */
+void Uart_TransmitNext(void)
+{
+    uint8_t tail = txTail;
+
+    if(tail != txHead)
+    {
+        Hal_UartWrite(txRing[tail]);
+        tail   = (tail + 1) & (TX_RING_LENGTH - 1);
+        txTail = tail;
+    }
+
+    if(tail == txHead)
+        Hal_UartDisableTxInterrupt();
+}
+
+
+/*
+ * Collects a received byte to the line. A line ends with CR or LF and empty lines are skipped,
+ * so CR LF ends a line once. Bytes are dropped while the main loop has the line.
+ */
+#pragma vector=USCIAB0RX_VECTOR
+__interrupt void USCI0RX_ISR(void)
+{
+    uint8_t data = Hal_UartRead();
+
+    if(RX_COLLECTING != rxState)
+        return;
+
+    if(('\r' == data) || ('\n' == data))
+    {
+        if((0 == rxLength) && !isRxOverflow)
+            return;
+
+        rxLine[rxLength] = '\0';
+        rxState          = isRxOverflow ? RX_TOO_LONG : RX_READY;
+    }
+    else if(rxLength < (RX_LINE_LENGTH - 1))
+        rxLine[rxLength++] = data;
+    else
+        isRxOverflow = 1;
+}
+
+
+/*
+ * Returns UART_LINE and points to the received line if one has ended. The line is null
+ * terminated and it can be changed in place until it's released.
+ */
+uint8_t Uart_GetLine(char ** ppLine)
+{
+    *ppLine = rxLine;
+
+    switch(rxState)
+    {
+    case RX_READY:
+        return UART_LINE;
+
+    case RX_TOO_LONG:
+        return UART_LINE_TOO_LONG;
+
+    default:
+        return UART_NO_LINE;
+    }
+}
+
+
+/*
+ * Releases the line buffer to the receive interrupt for the next line.
+ */
+void Uart_ReleaseLine(void)
+{
+    rxLength     = 0;
+    isRxOverflow = 0;
+    rxState      = RX_COLLECTING;
+}
@@ -0,0 +1,74 @@
+/*
+ * Uart.h
+ *
+ * Uart module sends messages over USCI A0 in UART mode from P3.4 (TXD) at 115200 baud, 8N1.
+ * Messages are written to a transmit ring buffer in the main loop and the transmit interrupt
+ * sends them byte by byte. The main loop is the only writer and the interrupt the only reader
+ * of the ring so no locks are needed. A writer checks the free space first and drops what
+ * doesn't fit, so the program never waits for the UART.
+ *
+ * Text is received from P3.5 (RXD) a line at a time. The receive interrupt collects a line and
+ * hands it to the main loop, which releases the buffer for the next line when it has used it.
+ * A sender waits for the reply to a line before sending the next one.
+ *
+ * Header includes:
+ * - results of getting a received line
+ * - global functions for initializing the UART, writing messages to the ring, sending the
+ *   next byte from the interrupt and getting the received lines
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_UART_H_
+#define CHARGER_UART_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Results of Uart_GetLine */
+#define UART_NO_LINE       0    /* Line hasn't ended yet                           */
+#define UART_LINE          1    /* Line has ended                                  */
+#define UART_LINE_TOO_LONG 2    /* Line has ended but it didn't fit to the buffer  */
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/* Configures USCI A0 as a 115200 baud UART from the 16 MHz crystal */
+void Uart_Initialize(void);
+
+/* Returns the number of bytes that can be put to the ring */
+uint8_t Uart_GetFree(void);
+
+/* Puts a byte after the bytes put earlier. The caller has checked the free space. */
+void Uart_Put(uint8_t data);
+
+/* Hands the bytes put so far to the transmit interrupt */
+void Uart_Send(void);
+
+/* Sends the next byte of the ring. Called from the USCI transmit interrupt. */
+void Uart_TransmitNext(void);
+
+/* Points to the received line and returns UART_LINE if the line has ended */
+uint8_t Uart_GetLine(char ** ppLine);
+
+/* Releases the line buffer for the next line */
+void Uart_ReleaseLine(void);
+
+
+#endif /* CHARGER_UART_H_ */
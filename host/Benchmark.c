@@ -0,0 +1,443 @@
+/*
+ * Benchmark.c
+ *
+ * Micro-benchmarks of the hot paths of the main loop and the control interrupt on the host:
+ * - Charger_ConvertMeasurements, the measurement step of the control run, and the whole
+ *   Charger_RunControl
+ * - PWM_UpdateControl
+ * - Menu_UpdateView and LCD_UpdateScreen in each view
+ * - Menu_FixedToCharArray which formats every value on the screen, and the float formatter of
+ *   the earlier versions that it replaced, FloatFormat_FloatToCharArray of FloatFormat.c
+ *
+ * Charger.c and Menu.c are included here so that their static functions can be called. Each
+ * function is called through a small wrapper until it has run for long enough, and the cycles
+ * and nanoseconds per call are taken as the mean. Stack depth is the part of a painted stack
+ * area that a single call overwrote, wrapper included. Code size is the size of the function's
+ * symbol, missing when the compiler inlined it. Cycles come from the time stamp counter on x86
+ * and are nanoseconds elsewhere.
+ *
+ * Results are printed one JSON object per line. Given a file of earlier results, as the
+ * baseline committed in host/BenchmarkBaseline.jsonl, each case also gets it's baseline cycles
+ * and the changes of cycles, stack and code from the baseline. The figures are host figures,
+ * they show relative changes rather than MSP430 cycles, and cycles only compare between runs on
+ * the same machine. Stack and code compare wherever the compiler is the same.
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* The program's main is renamed so that the benchmark has it's own */
+#define main Charger_Main
+#include "../Charger.c"
+#undef main
+
+#include "../Menu.c"
+
+#include "FloatFormat.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Every case runs at least this many calls and this long */
+#define BENCHMARK_MIN_CALLS        100
+#define BENCHMARK_MIN_NANOSECONDS  50000000ull
+
+/* Most cases read from a baseline */
+#define BASELINE_MAX_CASES         32
+
+/* Bytes of stack painted below the caller for measuring the stack depth of a call */
+#define STACK_PAINT_BYTES          4096
+#define STACK_PAINT_PATTERN        0xA5
+
+/* Measurements of a sunny day in millivolts and milliamperes */
+static const uint16_t BENCHMARK_MEAS_RESULTS[11] = { 17500, 2800, 17400, 2750, 17600, 2850, 17550, 2900,
+                                                     12800, 10500, 250 };
+
+/* Raw measurements of the same day */
+static const unsigned int BENCHMARK_RAW_MEAS[15] = { 1000, 512, 812, 900, 0, 0, 0, 0, 560, 485, 482, 550, 484, 560, 486 };
+
+
+/****************************************************************************************************
+ *                                       DATA TYPE DEFINITIONS
+ ****************************************************************************************************/
+
+
+/* Result of a case read from a baseline, code size is -1 if it had none */
+typedef struct
+{
+    char     name[64];
+    double   cyclesPerCall;
+    unsigned stackBytes;
+    long     codeBytes;
+} T_BaselineCase;
+
+
+/****************************************************************************************************
+ *                                             VARIABLES
+ ****************************************************************************************************/
+
+
+/* Lowest address of the painted stack area, kept after the painting function has returned */
+static uintptr_t paintedStack;
+
+/* Arguments of the cases */
+static uint16_t benchmarkMeasResults[11];
+static char     benchmarkCharArray[UPDATABLE_TEXT_LENGTH];
+static uint16_t benchmarkValue;
+static enum E_MenuStates benchmarkView;
+
+/* Cases of the baseline, none if no baseline was given */
+static T_BaselineCase baseline[BASELINE_MAX_CASES];
+static uint8_t        baselineCount;
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Returns a free-running count of cycles.
+ */
+static inline uint64_t Benchmark_ReadCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000ull) + now.tv_nsec;
+#endif
+}
+
+
+/*
+ * Returns monotonic nanoseconds.
+ */
+static uint64_t Benchmark_ReadNanoseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000ull) + now.tv_nsec;
+}
+
+
+/*
+ * Paints the stack area below the caller's frame with the pattern.
+ */
+__attribute__((noinline))
+static void Benchmark_PaintStack(void)
+{
+    volatile uint8_t area[STACK_PAINT_BYTES];
+    uint16_t         i;
+
+    for(i = 0; i < STACK_PAINT_BYTES; i++)
+        area[i] = STACK_PAINT_PATTERN;
+
+    paintedStack = (uintptr_t)area;
+}
+
+
+/*
+ * Returns the number of bytes of the painted stack area that a call overwrote. The area is
+ * below the frame of this function so the call's frames land in it.
+ */
+__attribute__((noinline))
+static uint16_t Benchmark_MeasureStack(void (* pfCall)(void))
+{
+    const volatile uint8_t * pArea;
+    uint16_t                 i = 0;
+
+    Benchmark_PaintStack();
+    pfCall();
+
+    pArea = (const volatile uint8_t *)paintedStack;
+
+    /* Stack grows down, the lowest overwritten byte tells the depth */
+    while((i < STACK_PAINT_BYTES) && (STACK_PAINT_PATTERN == pArea[i]))
+        i++;
+
+    return STACK_PAINT_BYTES - i;
+}
+
+
+/*
+ * Returns the size of a function's symbol in the benchmark binary or -1 if there's no symbol.
+ */
+static long Benchmark_CodeSize(const char * pSymbol)
+{
+    char          command[64];
+    char          line[256];
+    char          name[128];
+    char          type;
+    unsigned long address;
+    unsigned long size;
+    long          result = -1;
+    FILE        * pNm;
+
+    /* The benchmark's own binary, /proc/self would be nm's */
+    snprintf(command, sizeof(command), "nm -S --defined-only /proc/%d/exe 2>/dev/null", (int)getpid());
+    pNm = popen(command, "r");
+
+    if(!pNm)
+        return -1;
+
+    while(fgets(line, sizeof(line), pNm))
+    {
+        if((4 == sscanf(line, "%lx %lx %c %127s", &address, &size, &type, name)) && (0 == strcmp(name, pSymbol)))
+            result = (long)size;
+    }
+
+    pclose(pNm);
+
+    return result;
+}
+
+
+/*
+ * Reads the cases of a baseline written by an earlier run. Lines that aren't results are
+ * skipped. Exits with a failure if the file can't be read.
+ */
+static void Benchmark_ReadBaseline(const char * pPath)
+{
+    char             line[256];
+    char             code[16];
+    T_BaselineCase * pCase;
+    FILE           * pFile = fopen(pPath, "r");
+
+    if(!pFile)
+    {
+        printf("benchmark: can't read baseline %s\n", pPath);
+        exit(EXIT_FAILURE);
+    }
+
+    while(fgets(line, sizeof(line), pFile) && (baselineCount < BASELINE_MAX_CASES))
+    {
+        pCase = &baseline[baselineCount];
+
+        if(4 != sscanf(line, "{\"name\":\"%63[^\"]\",\"calls\":%*u,\"cycles_per_call\":%lf,\"ns_per_call\":%*f,\"stack_bytes\":%u,\"code_bytes\":%15[^}]",
+                       pCase->name, &pCase->cyclesPerCall, &pCase->stackBytes, code))
+        {
+            continue;
+        }
+
+        pCase->codeBytes = (0 == strcmp(code, "null")) ? -1 : atol(code);
+        baselineCount++;
+    }
+
+    fclose(pFile);
+}
+
+
+/*
+ * Returns the baseline of a case or 0 if the baseline doesn't have it.
+ */
+static const T_BaselineCase * Benchmark_FindBaseline(const char * pName)
+{
+    uint8_t i;
+
+    for(i = 0; i < baselineCount; i++)
+    {
+        if(0 == strcmp(baseline[i].name, pName))
+            return &baseline[i];
+    }
+
+    return 0;
+}
+
+
+/*
+ * Prints the changes of a case from the baseline as the last fields of it's JSON object.
+ */
+static void Benchmark_PrintChanges(const char * pName, double cyclesPerCall, uint16_t stack, long codeSize)
+{
+    const T_BaselineCase * pCase = Benchmark_FindBaseline(pName);
+
+    if(!pCase)
+    {
+        printf(",\"baseline\":null");
+        return;
+    }
+
+    printf(",\"baseline_cycles_per_call\":%.1f,\"cycles_change_percent\":%.1f,\"stack_change_bytes\":%d",
+           pCase->cyclesPerCall, 100.0 * (cyclesPerCall - pCase->cyclesPerCall) / pCase->cyclesPerCall,
+           (int)stack - (int)pCase->stackBytes);
+
+    if((codeSize < 0) || (pCase->codeBytes < 0))
+        printf(",\"code_change_bytes\":null");
+    else
+        printf(",\"code_change_bytes\":%ld", codeSize - pCase->codeBytes);
+}
+
+
+/*
+ * Runs a case and prints it's result as a JSON object, with the changes from the baseline if
+ * one was given.
+ */
+static void Benchmark_Run(const char * pName, const char * pSymbol, void (* pfCall)(void))
+{
+    uint64_t calls       = 0;
+    uint64_t startTime;
+    uint64_t elapsedTime;
+    uint64_t startCycles;
+    uint64_t cycles;
+    uint16_t stack       = Benchmark_MeasureStack(pfCall);
+    long     codeSize    = Benchmark_CodeSize(pSymbol);
+
+    startTime   = Benchmark_ReadNanoseconds();
+    startCycles = Benchmark_ReadCycles();
+
+    do
+    {
+        pfCall();
+        calls++;
+        elapsedTime = Benchmark_ReadNanoseconds() - startTime;
+    }
+    while((calls < BENCHMARK_MIN_CALLS) || (elapsedTime < BENCHMARK_MIN_NANOSECONDS));
+
+    cycles = Benchmark_ReadCycles() - startCycles;
+
+    printf("{\"name\":\"%s\",\"calls\":%llu,\"cycles_per_call\":%.1f,\"ns_per_call\":%.1f,\"stack_bytes\":%u,",
+           pName, (unsigned long long)calls, (double)cycles / calls, (double)elapsedTime / calls, stack);
+
+    if(codeSize < 0)
+        printf("\"code_bytes\":null");
+    else
+        printf("\"code_bytes\":%ld", codeSize);
+
+    if(baselineCount > 0)
+        Benchmark_PrintChanges(pName, (double)cycles / calls, stack, codeSize);
+
+    printf("}\n");
+}
+
+
+/*
+ * Cases of the benchmark. Each sets it's own arguments so the calls don't drift.
+ */
+static void Benchmark_ConvertMeasurements(void)
+{
+    memcpy(measInfo.rawMeas, BENCHMARK_RAW_MEAS, sizeof(BENCHMARK_RAW_MEAS));
+
+    Charger_CorrectVcc();
+    Charger_ConvertMeasurements();
+}
+
+
+static void Benchmark_RunControl(void)
+{
+    Charger_RunControl();
+}
+
+
+static void Benchmark_UpdateControl(void)
+{
+    memcpy(benchmarkMeasResults, BENCHMARK_MEAS_RESULTS, sizeof(BENCHMARK_MEAS_RESULTS));
+
+    PWM_UpdateControl(benchmarkMeasResults);
+}
+
+
+static void Benchmark_FixedToCharArray(void)
+{
+    Menu_FixedToCharArray(benchmarkCharArray, sizeof(benchmarkCharArray), benchmarkValue, 2, 'V');
+
+    benchmarkValue += 1237;
+}
+
+
+static void Benchmark_FloatToCharArray(void)
+{
+    /* The earlier versions kept the measurements in volts and amperes */
+    float value = benchmarkValue / 1000.0f;
+
+    FloatFormat_FloatToCharArray(benchmarkCharArray, &value, 'V');
+
+    benchmarkValue += 1237;
+}
+
+
+static void Benchmark_UpdateView(void)
+{
+    menu.isViewChanged = 1;
+
+    Menu_UpdateView(&menu, NO_CLICK, measInfo.measResults, 0x07FF, &calib);
+}
+
+
+static void Benchmark_UpdateScreen(void)
+{
+    LCD_UpdateScreen(menu.views[benchmarkView].textFields, menu.views[benchmarkView].textFieldCount,
+                     menu.updatableCharTables, ALL_TEXT_FIELDS);
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Sets the program up as at boot and runs every case. The optional argument is the file of the
+ * baseline to compare with.
+ */
+int main(int argc, char * argv[])
+{
+    const char * VIEW_NAMES[NO_MENU] = { "PANEL_VIEW", "BATTERY_VIEW", "MENU_VIEW_1", "MENU_VIEW_2", "MENU_VIEW_3",
+                                         "MENU_VIEW_4", "CALIBRATION_VIEW_1", "CALIBRATION_VIEW_2", "CALIBRATION_VIEW_3",
+#ifdef PROFILER
+                                         "DIAGNOSTICS_VIEW"
+#endif
+                                       };
+    char name[64];
+
+    if(argc > 1)
+        Benchmark_ReadBaseline(argv[1]);
+
+    Adjustment_GetCurrentAdjustment(&measInfo);
+    memcpy(measInfo.rawMeas, BENCHMARK_RAW_MEAS, sizeof(BENCHMARK_RAW_MEAS));
+    memcpy(measInfo.measResults, BENCHMARK_MEAS_RESULTS, sizeof(BENCHMARK_MEAS_RESULTS));
+    LCD_Initialize();
+
+    Benchmark_Run("Charger_ConvertMeasurements", "Charger_ConvertMeasurements", Benchmark_ConvertMeasurements);
+    Benchmark_Run("Charger_RunControl",          "Charger_RunControl",          Benchmark_RunControl);
+    Benchmark_Run("PWM_UpdateControl",           "PWM_UpdateControl",           Benchmark_UpdateControl);
+    Benchmark_Run("Menu_FixedToCharArray",       "Menu_FixedToCharArray",       Benchmark_FixedToCharArray);
+    Benchmark_Run("FloatFormat_FloatToCharArray", "FloatFormat_FloatToCharArray", Benchmark_FloatToCharArray);
+
+    for(benchmarkView = PANEL_VIEW; benchmarkView < NO_MENU; benchmarkView++)
+    {
+        Menu_ChangeToView(&menu, benchmarkView);
+
+        snprintf(name, sizeof(name), "Menu_UpdateView/%s", VIEW_NAMES[benchmarkView]);
+        Benchmark_Run(name, "Menu_UpdateView", Benchmark_UpdateView);
+
+        snprintf(name, sizeof(name), "LCD_UpdateScreen/%s", VIEW_NAMES[benchmarkView]);
+        Benchmark_Run(name, "LCD_UpdateScreen", Benchmark_UpdateScreen);
+    }
+
+    return 0;
+}
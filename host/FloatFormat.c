@@ -0,0 +1,72 @@
+/*
+ * FloatFormat.c
+ *
+ * Float formatter of the earlier versions, Menu_FloatToCharArray, as it was together with the
+ * unit and the terminator that it's caller Menu_WriteMeasurement added. It took the measurement
+ * in volts or amperes and truncated it to hundredths after a float multiply, so some values came
+ * out a hundredth too small.
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+#include "FloatFormat.h"
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Writes a value in volts or amperes with two decimals, a decimal comma and the unit into an 8
+ * char array. The number is right aligned and the remaining chars are filled with spaces.
+ */
+void FloatFormat_FloatToCharArray(char * charArray, const float * value, char unit)
+{
+    /* Convert value into unsigned int after multiplying it with 100 for decimals */
+    unsigned int newValue = (unsigned int)((*value) * 100);
+
+    int8_t i = 0;
+
+    /* Set decimals into their places */
+    charArray[5] = (newValue % 10) + '0';
+    newValue /= 10;
+    charArray[4] = (newValue % 10) + '0';
+    newValue /= 10;
+
+    charArray[3] = ',';
+
+    i = 2;
+
+    if(0 == newValue)
+    {
+        charArray[i] = '0';
+        i--;
+    }
+    else
+    {
+        /* Continue dividing with 10 and putting numbers into char array until value reaches 0 */
+        while(newValue > 0)
+        {
+            charArray[i] = (newValue % 10) + '0';
+            newValue /= 10;
+            i--;
+        }
+    }
+
+    /* Put empty spaces to the remaining chars */
+    while(i >= 0)
+        charArray[i--] = ' ';
+
+    charArray[6] = unit;
+    charArray[7] = '\0';
+}
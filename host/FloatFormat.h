@@ -0,0 +1,29 @@
+/*
+ * FloatFormat.h
+ *
+ * Float formatter of the earlier versions, kept on the host as the reference of the fixed-point
+ * formatter Menu_FixedToCharArray. The format check compares the two texts and the benchmark
+ * times both, so the old and the new formatter can be compared on the same machine.
+ *
+ * Header includes:
+ * - the float formatter
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_FLOAT_FORMAT_H_
+#define CHARGER_FLOAT_FORMAT_H_
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/* Writes a value in volts or amperes with two decimals and the unit into an 8 char array */
+void FloatFormat_FloatToCharArray(char * charArray, const float * value, char unit);
+
+
+#endif /* CHARGER_FLOAT_FORMAT_H_ */
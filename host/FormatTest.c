@@ -0,0 +1,157 @@
+/*
+ * FormatTest.c
+ *
+ * Host check of Menu_FixedToCharArray, the integer formatter of every value on the screen,
+ * against the float formatter of the earlier versions and against the C library.
+ *
+ * The float formatter is kept as it was in FloatFormat.c. It took the measurement in volts or
+ * amperes and truncated it to hundredths after a float multiply, so some values came out a
+ * hundredth too small. For every 16-bit value in thousandths the check takes the value as the
+ * float of the earlier versions and compares the two formatters. The outputs must be the same or the float one must show one hundredth less,
+ * anything else fails the check.
+ *
+ * The fixed-point formatter is also compared with snprintf for every value with 0-3 decimals,
+ * with and without a unit, in the eight char tables of the menu and the six chars left by the
+ * noise prefix. A value that doesn't fit and VALUE_SATURATED must show '>' chars.
+ *
+ * The check prints a summary and exits with a failure on the first wrong text.
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The formatter doesn't depend on the profiler so the menu is taken without it's view */
+#undef PROFILER
+#include "../Menu.c"
+
+#include "FloatFormat.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Char table sizes of a measurement and of the number part of a noise */
+#define MEASUREMENT_SIZE UPDATABLE_TEXT_LENGTH
+#define NOISE_SIZE       (UPDATABLE_TEXT_LENGTH - 2)
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Formats a value in thousandths the way the fixed-point formatter should with the C library.
+ */
+static void FormatTest_Reference(char * pText, uint8_t size, uint16_t value, uint8_t decimals, char unit)
+{
+    /* Divider of the thousandths for the shown decimals */
+    static const uint16_t DIVIDERS[4] = { 1000, 100, 10, 1 };
+    char                  number[16];
+    uint8_t               numberSize = size - 1 - (('\0' != unit) ? 1 : 0);
+
+    if(0 == decimals)
+        snprintf(number, sizeof(number), "%u", value / 1000);
+    else
+        snprintf(number, sizeof(number), "%u,%0*u", value / 1000, decimals, (value % 1000) / DIVIDERS[decimals]);
+
+    if((VALUE_SATURATED == value) || (strlen(number) > numberSize))
+    {
+        memset(number, '>', numberSize);
+        number[numberSize] = '\0';
+    }
+
+    /* A layout without room for a single integer digit has no unit either */
+    if(numberSize < (1 + ((decimals > 0) ? (decimals + 1) : 0)))
+    {
+        memset(pText, '>', size - 1);
+        pText[size - 1] = '\0';
+        return;
+    }
+
+    snprintf(pText, size, "%*s%c", numberSize, number, unit);
+}
+
+
+/*
+ * Compares two texts and exits with a failure if they differ.
+ */
+static void FormatTest_Compare(const char * pWhat, uint16_t value, const char * pText, const char * pExpected)
+{
+    if(0 == strcmp(pText, pExpected))
+        return;
+
+    printf("format: %s of %u gave \"%s\", expected \"%s\"\n", pWhat, value, pText, pExpected);
+    exit(EXIT_FAILURE);
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+int main(void)
+{
+    static const char    UNITS[2] = { 'V', '\0' };
+    static const uint8_t SIZES[2] = { MEASUREMENT_SIZE, NOISE_SIZE };
+    char                 text[MEASUREMENT_SIZE];
+    char                 expected[MEASUREMENT_SIZE];
+    float                floatValue;
+    uint32_t             value;
+    uint32_t             truncated = 0;
+    uint8_t              decimals;
+    uint8_t              unit;
+    uint8_t              size;
+
+    /* Earlier versions against the fixed-point formatter with the measurement layout */
+    for(value = 0; value < VALUE_SATURATED; value++)
+    {
+        floatValue = value / 1000.0f;
+
+        FloatFormat_FloatToCharArray(expected, &floatValue, 'V');
+        Menu_FixedToCharArray(text, sizeof(text), value, 2, 'V');
+
+        if(0 == strcmp(text, expected))
+            continue;
+
+        /* Float truncation shows a hundredth less */
+        Menu_FixedToCharArray(text, sizeof(text), value - 10, 2, 'V');
+        FormatTest_Compare("float formatter", value, expected, text);
+        truncated++;
+    }
+
+    /* Fixed-point formatter against the C library */
+    for(size = 0; size < 2; size++)
+    {
+        for(unit = 0; unit < 2; unit++)
+        {
+            for(decimals = 0; decimals <= 3; decimals++)
+            {
+                for(value = 0; value <= VALUE_SATURATED; value++)
+                {
+                    Menu_FixedToCharArray(text, SIZES[size], value, decimals, UNITS[unit]);
+                    FormatTest_Reference(expected, SIZES[size], value, decimals, UNITS[unit]);
+                    FormatTest_Compare("fixed-point formatter", value, text, expected);
+                }
+            }
+        }
+    }
+
+    printf("format: %u values match the float formatter or show the %u hundredths it truncated, "
+           "all match snprintf with 0-3 decimals\n", (unsigned)VALUE_SATURATED, (unsigned)truncated);
+
+    return EXIT_SUCCESS;
+}
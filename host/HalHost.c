@@ -0,0 +1,506 @@
+/*
+ * HalHost.c
+ *
+ * Simulated peripherals of the host build. Peripherals act at once: an ADC10 sequence is
+ * converted when it's started, an SPI transfer is sent when the transmit interrupt is enabled
+ * and a FLASH write is done when the word is written. Time advances only when the program
+ * sleeps, each sleep runs the period interrupt until it starts the tick and then one tick
+ * interrupt. The watchdog counts the time of the ticks and resets the device if the program
+ * doesn't clear it in time.
+ *
+ * The run takes CHARGER_HOST_SECONDS seconds of the millisecond clock, 10 by default, and then
+ * prints a summary. A reset of the device ends the run with an error.
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../Hal.h"
+#include "../Timer.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+#define DEFAULT_RUN_SECONDS  10
+
+#define FLASH_SEGMENT_SIZE   64
+
+/* Vcc / 2 is converted against the 2.5 V reference */
+#define VCC_FULL_SCALE_MV    5000
+
+/* NTC at 25 C */
+#define DEFAULT_NTC_RAW      512
+#define NTC_INPUT            13
+
+#define DEFAULT_VCC_MV       3300
+
+/* Watchdog resets the device after 32768 cycles of it's clock */
+#define WATCHDOG_CYCLES      32768UL
+
+/* Crystal of ACLK and the DCO in kHz */
+#define CRYSTAL_KHZ          16000
+#define DCO_FAST_KHZ         16000
+#define DCO_SLOW_KHZ         1000
+
+/* Time a console sender waits for the reply after a line */
+#define CONSOLE_REPLY_WAIT_MS 200
+
+/* Timer clock cycles in a microsecond */
+#define CYCLES_PER_MICROSECOND 16
+
+
+/****************************************************************************************************
+ *                                             VARIABLES
+ ****************************************************************************************************/
+
+
+T_HalHostState halHost;
+
+volatile uint16_t ADC10CTL0, ADC10CTL1, ADC10MEM, ADC10SA;
+volatile uint8_t  ADC10AE0, ADC10AE1, ADC10DTC1;
+
+volatile uint8_t  BCSCTL1, BCSCTL2, BCSCTL3, DCOCTL;
+volatile uint8_t  CALBC1_16MHZ = 0x8F, CALDCO_16MHZ = 0x95, CALBC1_1MHZ = 0x86, CALDCO_1MHZ = 0xB4;
+
+volatile uint16_t FCTL1, FCTL2, FCTL3 = 0x0018;
+volatile uint8_t  IE1, IFG1 = PORIFG;
+
+volatile uint8_t  P1DIR, P1OUT, P1REN, P1SEL;
+volatile uint8_t  P2DIR, P2OUT, P2REN, P2SEL;
+volatile uint8_t  P3DIR, P3IN = 0xFF, P3OUT, P3REN, P3SEL;
+volatile uint8_t  P4DIR, P4OUT, P4REN, P4SEL;
+
+volatile uint16_t TACTL, TACCR0, TACCR1, TACCR2, TACCTL0, TACCTL1, TACCTL2;
+volatile uint16_t TBCTL, TBCCR0, TBCCR1, TBCCR2, TBCCTL1, TBCCTL2;
+
+/* Transmit buffers are always empty */
+volatile uint8_t  UC0IE, UC0IFG = UCA0TXIFG + UCB0TXIFG, UCB0BR0, UCB0BR1, UCB0CTL0, UCB0CTL1, UCB0TXBUF;
+volatile uint8_t  UCA0BR0, UCA0BR1, UCA0CTL0, UCA0CTL1, UCA0MCTL, UCA0RXBUF, UCA0TXBUF;
+
+volatile uint16_t WDTCTL;
+
+/* Interrupt functions of the program */
+void Timer_PeriodISR(void);
+void Charger_TickISR(void);
+void USCI0TX_ISR(void);
+void USCI0RX_ISR(void);
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Sets the peripherals to their state at power up before main is entered. A simulation using
+ * the hooks initializes after this with a later constructor priority.
+ */
+__attribute__((constructor(101)))
+static void HalHost_Initialize(void)
+{
+    const char * pSeconds = getenv("CHARGER_HOST_SECONDS");
+    const char * pUart    = getenv("CHARGER_HOST_UART");
+    uint32_t     seconds  = DEFAULT_RUN_SECONDS;
+
+    if(pSeconds)
+        seconds = strtoul(pSeconds, NULL, 10);
+
+    if(pUart)
+        halHost.pUartFile = fopen(pUart, "wb");
+
+    halHost.pUartInput = getenv("CHARGER_HOST_CONSOLE");
+
+    memset(halHost.infoFlash, 0xFF, sizeof(halHost.infoFlash));
+
+    halHost.adcInputs[NTC_INPUT] = DEFAULT_NTC_RAW;
+    halHost.vccMillivolts        = DEFAULT_VCC_MV;
+    halHost.endMilliseconds      = seconds * 1000;
+}
+
+
+/*
+ * Prints the summary of the run and ends it with the given exit status.
+ */
+static void HalHost_End(int status)
+{
+    if(halHost.pEndHook)
+        halHost.pEndHook();
+
+    printf("ticks %lu, %lu ms\n", (unsigned long)halHost.ticks, (unsigned long)Timer_GetMilliseconds());
+    printf("duties %u %u %u %u\n", Hal_GetPwmDuty(0), Hal_GetPwmDuty(1), Hal_GetPwmDuty(2), Hal_GetPwmDuty(3));
+    printf("lcd bytes %lu\n", (unsigned long)halHost.lcdBytes);
+    printf("uart bytes %lu\n", (unsigned long)halHost.uartBytes);
+    printf("flash writes %u, erases %u\n", halHost.flashWrites, halHost.flashErases);
+
+    if(halHost.pUartFile)
+        fclose((FILE *)halHost.pUartFile);
+
+    exit(status);
+}
+
+
+/*
+ * Returns the host's monotonic clock in nanoseconds.
+ */
+static uint64_t HalHost_ReadNanoseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000ull) + now.tv_nsec;
+}
+
+
+/*
+ * Returns the offset of an address in the information memory and ends the run if the address
+ * is outside of it.
+ */
+static uint16_t HalHost_FlashOffset(const void * pFlash)
+{
+    const uint8_t * pByte = (const uint8_t *)pFlash;
+
+    if((pByte < halHost.infoFlash) || (pByte >= halHost.infoFlash + HAL_HOST_INFO_FLASH_SIZE))
+    {
+        printf("FLASH access outside of information memory\n");
+        HalHost_End(EXIT_FAILURE);
+    }
+
+    return (uint16_t)(pByte - halHost.infoFlash);
+}
+
+
+/*
+ * Adds the latest tick to the watchdog's count unless the program has cleared it since the
+ * previous tick, and resets the device when the count passes 32768 cycles of the watchdog's
+ * clock. SMCLK is the DCO divided by DIVS and ACLK the crystal.
+ */
+static void HalHost_CountWatchdog(void)
+{
+    uint32_t clockKhz;
+
+    if(WDTCTL & WDTHOLD)
+        return;
+
+    if(WDTCTL & WDTCNTCL)
+    {
+        WDTCTL                      &= ~WDTCNTCL;
+        halHost.watchdogMicroseconds = 0;
+        return;
+    }
+
+    if(WDTCTL & WDTSSEL)
+        clockKhz = CRYSTAL_KHZ;
+    else
+        clockKhz = ((CALDCO_1MHZ == DCOCTL) ? DCO_SLOW_KHZ : DCO_FAST_KHZ) >> ((BCSCTL2 & DIVS_3) >> 1);
+
+    halHost.watchdogMicroseconds += halHost.tickMicroseconds;
+
+    if(halHost.watchdogMicroseconds * clockKhz >= WATCHDOG_CYCLES * 1000)
+    {
+        printf("device reset by the watchdog at %lu ms\n", (unsigned long)Timer_GetMilliseconds());
+        HalHost_End(EXIT_FAILURE);
+    }
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Disables interrupts and returns the earlier interrupt state. Interrupts are only run when
+ * the program sleeps so the state is just kept.
+ */
+uint16_t Hal_DisableInterrupts(void)
+{
+    uint16_t interruptState = halHost.isInterruptEnabled ? GIE : 0;
+
+    halHost.isInterruptEnabled = 0;
+
+    return interruptState;
+}
+
+
+/*
+ * Restores the interrupt state returned by Hal_DisableInterrupts.
+ */
+void Hal_RestoreInterrupts(uint16_t interruptState)
+{
+    if(interruptState & GIE)
+        halHost.isInterruptEnabled = 1;
+}
+
+
+/*
+ * Enables interrupts.
+ */
+void Hal_EnableInterrupts(void)
+{
+    halHost.isInterruptEnabled = 1;
+}
+
+
+/*
+ * Runs the period interrupt until it enables the overflow interrupt, then the tick interrupt
+ * once, and ends the run when it's time.
+ */
+void Hal_Sleep(uint16_t sleepBits)
+{
+    uint32_t periods = 0;
+    uint32_t periodCycles;
+
+    (void)sleepBits;
+
+    if(Timer_GetMilliseconds() >= halHost.endMilliseconds)
+        HalHost_End(EXIT_SUCCESS);
+
+    while(!(TACTL & TAIE))
+    {
+        Timer_PeriodISR();
+        periods++;
+    }
+
+    /* Crystal cycles of a period, the slow tick divides the crystal by 8 */
+    periodCycles = (uint32_t)(TACCR0 + 1) << ((TACTL & ID_3) >> 6);
+
+    halHost.tickMicroseconds = (periods * periodCycles) / CYCLES_PER_MICROSECOND;
+    halHost.timerCycles     += periods * periodCycles;
+
+    if(halHost.pTickHook)
+        halHost.pTickHook();
+
+    HalHost_CountWatchdog();
+
+    halHost.tickNanoseconds    = HalHost_ReadNanoseconds();
+    halHost.isInterruptEnabled = 1;
+    halHost.ticks++;
+
+    Charger_TickISR();
+
+    halHost.isInterruptEnabled = 1;
+
+    /* Console input arrives a byte on each tick once the receive interrupt is on */
+    if(halHost.pUartInput && *halHost.pUartInput && (UC0IE & UCA0RXIE) &&
+       ((int32_t)(Timer_GetMilliseconds() - halHost.uartInputTime) >= 0))
+    {
+        UCA0RXBUF = *halHost.pUartInput++;
+        USCI0RX_ISR();
+
+        if('\n' == UCA0RXBUF)
+            halHost.uartInputTime = Timer_GetMilliseconds() + CONSOLE_REPLY_WAIT_MS;
+    }
+}
+
+
+/*
+ * The simulation returns from Hal_Sleep after each tick.
+ */
+void Hal_WakeFromInterrupt(uint16_t sleepBits)
+{
+    (void)sleepBits;
+}
+
+
+/*
+ * Ends the run with an error as the device was reset.
+ */
+void Hal_Reset(void)
+{
+    printf("device reset at %lu ms\n", (unsigned long)Timer_GetMilliseconds());
+    HalHost_End(EXIT_FAILURE);
+}
+
+
+/*
+ * Conversions are done when they are started.
+ */
+uint8_t Hal_AdcIsBusy(void)
+{
+    return 0;
+}
+
+
+/*
+ * Converts the analog inputs from channel 14 down to channel 0 to the 15 word array.
+ */
+void Hal_AdcStartSequence(unsigned int * pRaw, uint16_t reference)
+{
+    uint8_t i;
+
+    ADC10CTL0 = ADC10SHT_2 + SREF_0 + ADC10ON + MSC + reference;
+
+    for(i = 0; i < 15; i++)
+        pRaw[i] = halHost.adcInputs[14 - i] & 0x03FF;
+}
+
+
+/*
+ * Converts (Vcc - Vss) / 2 against the 2.5 V reference to ADC10MEM.
+ */
+void Hal_AdcStartVcc(void)
+{
+    uint32_t raw = ((uint32_t)halHost.vccMillivolts * 1023) / VCC_FULL_SCALE_MV;
+
+    ADC10CTL0 = ADC10SHT_3 + SREF_1 + REFON + REF2_5V + ADC10ON;
+    ADC10MEM  = (raw > 1023) ? 1023 : raw;
+}
+
+
+/*
+ * Returns the result of the Vcc conversion.
+ */
+uint16_t Hal_AdcReadVcc(void)
+{
+    return ADC10MEM;
+}
+
+
+/*
+ * Turns ADC10 and the internal reference off.
+ */
+void Hal_AdcOff(void)
+{
+    ADC10CTL0 &= ~(ENC + ADC10ON + REFON);
+}
+
+
+/*
+ * Runs the transmit interrupt until it disables itself after the last byte.
+ */
+void Hal_SpiEnableTxInterrupt(void)
+{
+    UC0IE |= UCB0TXIE;
+
+    while(UC0IE & UCB0TXIE)
+        USCI0TX_ISR();
+}
+
+
+/*
+ * Disables the transmit interrupt.
+ */
+void Hal_SpiDisableTxInterrupt(void)
+{
+    UC0IE &= ~UCB0TXIE;
+}
+
+
+/*
+ * Sends a byte to the LCD.
+ */
+void Hal_SpiWrite(uint8_t data)
+{
+    UCB0TXBUF = data;
+    halHost.lcdBytes++;
+}
+
+
+/*
+ * Returns the Timer_A cycles of the simulated periods and of the host time spent since the
+ * current tick started. The host counts the periods itself so the given periods are not used.
+ */
+uint32_t Hal_TimerReadCycles(uint32_t periods)
+{
+    (void)periods;
+
+    return halHost.timerCycles + (uint32_t)(((HalHost_ReadNanoseconds() - halHost.tickNanoseconds) * CYCLES_PER_MICROSECOND) / 1000);
+}
+
+
+/*
+ * Runs the transmit interrupt until it disables itself after the last byte of the ring.
+ */
+void Hal_UartEnableTxInterrupt(void)
+{
+    UC0IE |= UCA0TXIE;
+
+    while(UC0IE & UCA0TXIE)
+        USCI0TX_ISR();
+}
+
+
+/*
+ * Disables the transmit interrupt.
+ */
+void Hal_UartDisableTxInterrupt(void)
+{
+    UC0IE &= ~UCA0TXIE;
+}
+
+
+/*
+ * Sends a byte over the UART.
+ */
+void Hal_UartWrite(uint8_t data)
+{
+    UCA0TXBUF = data;
+    halHost.uartBytes++;
+
+    if(halHost.pUartFile)
+        fputc(data, (FILE *)halHost.pUartFile);
+}
+
+
+/*
+ * FLASH timing has no effect on the host.
+ */
+void Hal_FlashSetClock(void)
+{
+    FCTL2 = FWKEY + FSSEL_0 + (FN5 + FN4);
+}
+
+
+/*
+ * Writes a word to FLASH. As in NOR FLASH a write can only clear bits.
+ */
+void Hal_FlashWriteWord(const void * pFlash, uint16_t word)
+{
+    uint16_t offset = HalHost_FlashOffset(pFlash);
+
+    if(halHost.pFlashHook)
+        halHost.pFlashHook(pFlash, word, 0);
+
+    halHost.infoFlash[offset]     &= (uint8_t)word;
+    halHost.infoFlash[offset + 1] &= (uint8_t)(word >> 8);
+    halHost.flashWrites++;
+}
+
+
+/*
+ * Erases the 64 byte segment of the given address.
+ */
+void Hal_FlashEraseSegment(const void * pSegment)
+{
+    uint16_t offset = HalHost_FlashOffset(pSegment) & ~(FLASH_SEGMENT_SIZE - 1);
+
+    if(halHost.pFlashHook)
+        halHost.pFlashHook(pSegment, 0xFFFF, 1);
+
+    memset(&halHost.infoFlash[offset], 0xFF, FLASH_SEGMENT_SIZE);
+    halHost.flashErases++;
+}
+
+
+/*
+ * Busy waits take no time.
+ */
+void _delay_cycles(unsigned long cycles)
+{
+    (void)cycles;
+}
@@ -0,0 +1,251 @@
+/*
+ * HalHost.h
+ *
+ * Simulated peripherals of the host build. The registers that the modules configure at boot
+ * are plain variables with the bit definitions of the device header so that the same code
+ * compiles and runs on a PC. The HAL functions whose hardware behaviour matters to the
+ * program are implemented in HalHost.c:
+ * - ADC10 sequences convert at once from the simulated analog inputs in raw counts
+ * - the SPI transmit interrupt is run until the whole LCD buffer is sent
+ * - the UART transmit interrupt is run until the ring is empty, the bytes are written to the
+ *   file named by CHARGER_HOST_UART if it's set
+ * - the text of CHARGER_HOST_CONSOLE is received by the UART a byte on each tick, after each
+ *   line the sender waits for the reply
+ * - information FLASH is an array that behaves as NOR FLASH, a write can only clear bits
+ * - sleeping runs the period interrupt of Timer_A until it starts the tick and then calls the
+ *   tick interrupt
+ * - Timer_A cycles are the simulated periods plus the host time spent in the current tick
+ * - the watchdog counts the ticks from it's clock and resets the device unless it's cleared
+ *
+ * The run ends after a given time of the millisecond clock or when the device resets. Hooks
+ * let a simulation update the analog inputs on every tick and report at the end.
+ *
+ * Header includes:
+ * - register variables and bit definitions of the device
+ * - state of the simulated peripherals
+ * - functions of the HAL implemented by the simulation
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_HAL_HOST_H_
+#define CHARGER_HAL_HOST_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Interrupt functions are ordinary functions on the host */
+#define __interrupt
+
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+
+/* Status register */
+#define GIE       0x0008
+#define CPUOFF    0x0010
+#define SCG0      0x0040
+#define SCG1      0x0080
+#define LPM0_bits (CPUOFF)
+#define LPM3_bits (SCG1 + SCG0 + CPUOFF)
+
+/* ADC10 */
+#define ADC10SC    0x0001
+#define ENC        0x0002
+#define ADC10ON    0x0010
+#define REFON      0x0020
+#define REF2_5V    0x0040
+#define MSC        0x0080
+#define ADC10SHT_2 0x1000
+#define ADC10SHT_3 0x1800
+#define SREF_0     0x0000
+#define SREF_1     0x2000
+#define CONSEQ_1   0x0002
+#define BUSY       0x0001
+#define INCH_11    0xB000
+#define INCH_14    0xE000
+
+/* Timer_A and Timer_B */
+#define TACLR     0x0004
+#define TBCLR     0x0004
+#define TASSEL_1  0x0100
+#define TASSEL_2  0x0200
+#define ID_0      0x0000
+#define ID_3      0x00C0
+#define MC_1      0x0010
+#define MC_3      0x0030
+#define TAIFG     0x0001
+#define TAIE      0x0002
+#define CCIFG     0x0001
+#define CCIE      0x0010
+#define OUTMOD_0  0x0000
+#define OUTMOD_7  0x00E0
+
+/* Watchdog timer */
+#define WDTPW     0x5A00
+#define WDTHOLD   0x0080
+#define WDTTMSEL  0x0010
+#define WDTCNTCL  0x0008
+#define WDTSSEL   0x0004
+#define WDTIS0    0x0001
+#define WDTIE     0x01
+
+/* Special function registers */
+#define WDTIFG    0x01
+#define OFIFG     0x02
+#define PORIFG    0x04
+#define RSTIFG    0x08
+
+/* Basic clock module */
+#define XTS       0x40
+#define LFXT1S_2  0x20
+#define SELM_0    0x00
+#define DIVS_3    0x06
+
+/* FLASH */
+#define FWKEY     0xA500
+#define ERASE     0x0002
+#define WRT       0x0040
+#define LOCK      0x0010
+#define FSSEL_0   0x0000
+#define FN4       0x0010
+#define FN5       0x0020
+
+/* USCI */
+#define UCSWRST   0x01
+#define UCSSEL_1  0x40
+#define UCSYNC    0x01
+#define UCMSB     0x20
+#define UCCKPL    0x40
+#define UCMST     0x08
+#define UCB0TXIE  0x08
+#define UCA0TXIE  0x02
+#define UCA0RXIE  0x01
+#define UCB0TXIFG 0x08
+#define UCA0TXIFG 0x02
+#define UCBRS_7   0x0E
+
+/* Size of the information memory */
+#define HAL_HOST_INFO_FLASH_SIZE 256
+
+/* Information memory segments D, C, B and A */
+#define HAL_INFO_FLASH ((const uint8_t *)halHost.infoFlash)
+
+
+/****************************************************************************************************
+ *                                       DATA TYPE DEFINITIONS
+ ****************************************************************************************************/
+
+
+/* State of the simulated peripherals and the run */
+typedef struct
+{
+    uint8_t  infoFlash[HAL_HOST_INFO_FLASH_SIZE]; /* Information memory, erased to 0xFF         */
+    uint16_t adcInputs[16];       /* Raw counts of analog inputs A0 - A15 against Vcc           */
+    uint16_t vccMillivolts;       /* Supply voltage measured against the internal reference     */
+    uint8_t  isInterruptEnabled;
+    uint32_t ticks;               /* Ticks run                                                 */
+    uint16_t tickMicroseconds;    /* Length of the latest tick                                 */
+    uint32_t timerCycles;         /* Timer_A cycles of the periods run                         */
+    uint32_t watchdogMicroseconds; /* Time since the watchdog was cleared                     */
+    uint64_t tickNanoseconds;     /* Host clock when the current tick started                  */
+    uint32_t endMilliseconds;     /* Run ends when the millisecond clock reaches this          */
+    uint32_t lcdBytes;            /* Bytes sent to the LCD                                     */
+    uint32_t uartBytes;           /* Bytes sent over the UART                                  */
+    void   * pUartFile;           /* FILE the UART is written to if set                        */
+    const char * pUartInput;      /* Text received by the UART, a byte on each tick             */
+    uint32_t uartInputTime;       /* Millisecond clock when the next byte of the text is sent  */
+    uint16_t flashWrites;         /* Words written to FLASH                                    */
+    uint16_t flashErases;         /* Segments erased                                           */
+    void (*pTickHook)(void);      /* Called before every tick interrupt if set                 */
+    void (*pEndHook)(void);       /* Called at the end of the run if set                       */
+    void (*pFlashHook)(const void * pFlash, uint16_t word, uint8_t isErase); /* Called before every
+                                     FLASH write and erase if set                              */
+} T_HalHostState;
+
+
+/****************************************************************************************************
+ *                                             VARIABLES
+ ****************************************************************************************************/
+
+
+extern T_HalHostState halHost;
+
+extern volatile uint16_t ADC10CTL0, ADC10CTL1, ADC10MEM, ADC10SA;
+extern volatile uint8_t  ADC10AE0, ADC10AE1, ADC10DTC1;
+
+extern volatile uint8_t  BCSCTL1, BCSCTL2, BCSCTL3, DCOCTL;
+extern volatile uint8_t  CALBC1_16MHZ, CALDCO_16MHZ, CALBC1_1MHZ, CALDCO_1MHZ;
+
+extern volatile uint16_t FCTL1, FCTL2, FCTL3;
+extern volatile uint8_t  IE1, IFG1;
+
+extern volatile uint8_t  P1DIR, P1OUT, P1REN, P1SEL;
+extern volatile uint8_t  P2DIR, P2OUT, P2REN, P2SEL;
+extern volatile uint8_t  P3DIR, P3IN, P3OUT, P3REN, P3SEL;
+extern volatile uint8_t  P4DIR, P4OUT, P4REN, P4SEL;
+
+extern volatile uint16_t TACTL, TACCR0, TACCR1, TACCR2, TACCTL0, TACCTL1, TACCTL2;
+extern volatile uint16_t TBCTL, TBCCR0, TBCCR1, TBCCR2, TBCCTL1, TBCCTL2;
+
+extern volatile uint8_t  UC0IE, UC0IFG, UCB0BR0, UCB0BR1, UCB0CTL0, UCB0CTL1, UCB0TXBUF;
+extern volatile uint8_t  UCA0BR0, UCA0BR1, UCA0CTL0, UCA0CTL1, UCA0MCTL, UCA0RXBUF, UCA0TXBUF;
+
+extern volatile uint16_t WDTCTL;
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+uint16_t Hal_DisableInterrupts(void);
+void     Hal_RestoreInterrupts(uint16_t interruptState);
+void     Hal_EnableInterrupts(void);
+void     Hal_Sleep(uint16_t sleepBits);
+void     Hal_WakeFromInterrupt(uint16_t sleepBits);
+void     Hal_Reset(void);
+
+uint8_t  Hal_AdcIsBusy(void);
+void     Hal_AdcStartSequence(unsigned int * pRaw, uint16_t reference);
+void     Hal_AdcStartVcc(void);
+uint16_t Hal_AdcReadVcc(void);
+void     Hal_AdcOff(void);
+
+void     Hal_SpiEnableTxInterrupt(void);
+void     Hal_SpiDisableTxInterrupt(void);
+void     Hal_SpiWrite(uint8_t data);
+
+void     Hal_UartEnableTxInterrupt(void);
+void     Hal_UartDisableTxInterrupt(void);
+void     Hal_UartWrite(uint8_t data);
+
+uint32_t Hal_TimerReadCycles(uint32_t periods);
+
+void     Hal_FlashSetClock(void);
+void     Hal_FlashWriteWord(const void * pFlash, uint16_t word);
+void     Hal_FlashEraseSegment(const void * pSegment);
+
+/* Busy waits take no time on the host */
+void     _delay_cycles(unsigned long cycles);
+
+
+#endif /* CHARGER_HAL_HOST_H_ */
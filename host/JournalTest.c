@@ -0,0 +1,359 @@
+/*
+ * JournalTest.c
+ *
+ * Power cut test of the adjustment journal in Adjustment.c on the host. The FLASH hook of the
+ * simulated HAL cuts the power before a chosen write or erase: a cut write clears only some of
+ * the bits it would have cleared and a cut erase sets only some of the bits, as the cells of a
+ * real FLASH are left between the states. The test then "reboots" by reading the adjustment
+ * again and checks that every channel converts either as it did before the save or, if the
+ * save had the channel, as it was going to be saved. Anything else fails the test.
+ *
+ * A run starts from the data of the earlier versions in segments D and C and goes through a
+ * fixed sequence of calibrations and zero tracking saves, so it takes the journal through the
+ * migration and a number of rotations. The sweep cuts the run once at each of it's FLASH
+ * operations in turn and continues it after the reboot. Finally a long random run is cut at
+ * random operations, also during the recovery of an earlier cut.
+ *
+ * The test prints a summary and exits with a failure on the first wrong channel.
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../Adjustment.h"
+#include "../Hal.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* Saves of a run of the sweep and of the random run */
+#define SWEEP_SAVES         40
+#define RANDOM_SAVES        20000
+
+/* One FLASH operation in this many is cut in the random run */
+#define RANDOM_CUT_INTERVAL 50
+
+/* Size of a FLASH segment in bytes */
+#define FLASH_SEGMENT_SIZE  64
+
+/* Segments D and C where the earlier versions kept the coefficients and the offsets */
+#define OLD_COEFFICIENTS    0x00
+#define OLD_OFFSETS         0x40
+
+/* First byte of a journal segment header, the old data must not start with it */
+#define JOURNAL_MAGIC       0xA5
+
+#define NO_CUT              0
+#define NO_CHANNEL          0xFF
+
+
+/****************************************************************************************************
+ *                                            VARIABLES
+ ****************************************************************************************************/
+
+
+static T_MeasureInformation measInfo;
+
+/* Conversions that a reboot must give and the ones of the save in progress */
+static T_Conversion committed[10];
+static T_Conversion pending[10];
+static uint16_t     pendingChannels;
+
+/* FLASH operations until the cut, NO_CUT if none is coming, and the operations so far */
+static uint32_t cutCountdown;
+static uint32_t flashOperations;
+
+static jmp_buf  powerCut;
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Returns a pseudo random number below the limit.
+ */
+static uint32_t JournalTest_Random(uint32_t limit)
+{
+    return (uint32_t)rand() % limit;
+}
+
+
+/*
+ * Cuts the power before the chosen FLASH operation and leaves the operation half done.
+ */
+static void JournalTest_FlashHook(const void * pFlash, uint16_t word, uint8_t isErase)
+{
+    uint16_t offset = (uint16_t)((const uint8_t *)pFlash - halHost.infoFlash);
+    uint8_t  i;
+
+    flashOperations++;
+
+    if((NO_CUT == cutCountdown) || (--cutCountdown > 0))
+        return;
+
+    if(isErase)
+    {
+        offset &= ~(FLASH_SEGMENT_SIZE - 1);
+
+        for(i = 0; i < FLASH_SEGMENT_SIZE; i++)
+            halHost.infoFlash[offset + i] |= (uint8_t)JournalTest_Random(0x100);
+    }
+    else
+    {
+        word |= (uint16_t)JournalTest_Random(0x10000);
+
+        halHost.infoFlash[offset]     &= (uint8_t)word;
+        halHost.infoFlash[offset + 1] &= (uint8_t)(word >> 8);
+    }
+
+    longjmp(powerCut, 1);
+}
+
+
+/*
+ * Writes a float to four bytes of the simulated FLASH.
+ */
+static void JournalTest_WriteOldFloat(uint8_t offset, float value)
+{
+    memcpy(&halHost.infoFlash[offset], &value, sizeof(value));
+}
+
+
+/*
+ * Fills segments D and C with the data of the earlier versions. Some channels are left erased
+ * so that they take the factory values. The first bytes never hold the journal magic as the
+ * journal couldn't tell the old data from a segment then.
+ */
+static void JournalTest_SetOldData(void)
+{
+    uint8_t channel;
+
+    memset(halHost.infoFlash, 0xFF, HAL_HOST_INFO_FLASH_SIZE);
+
+    for(channel = 0; channel < 10; channel++)
+    {
+        if(JournalTest_Random(4) > 0)
+            JournalTest_WriteOldFloat(OLD_COEFFICIENTS + (4 * channel), 0.005f + (JournalTest_Random(1000) * 0.00004f));
+
+        if(JournalTest_Random(4) > 0)
+            JournalTest_WriteOldFloat(OLD_OFFSETS + (4 * channel), (JournalTest_Random(400) * 0.001f) - 0.2f);
+    }
+
+    if(JOURNAL_MAGIC == halHost.infoFlash[OLD_COEFFICIENTS])
+        halHost.infoFlash[OLD_COEFFICIENTS]--;
+
+    if(JOURNAL_MAGIC == halHost.infoFlash[OLD_OFFSETS])
+        halHost.infoFlash[OLD_OFFSETS]--;
+}
+
+
+/*
+ * Reads the adjustment as the program does at boot and takes it as the committed one.
+ */
+static void JournalTest_Reboot(void)
+{
+    Adjustment_GetCurrentAdjustment(&measInfo);
+    memcpy(committed, measInfo.conversions, sizeof(committed));
+}
+
+
+/*
+ * Reboots and checks each channel. After a complete save every channel must be as saved. After
+ * a cut save a channel must be as committed or, if the save had the channel, as pending. Exits
+ * with a failure on a wrong channel.
+ */
+static void JournalTest_Check(const char * pPhase, uint32_t run, uint32_t save, uint8_t isCut)
+{
+    T_Conversion before[10];
+    uint8_t      channel;
+
+    memcpy(before, committed, sizeof(before));
+    JournalTest_Reboot();
+
+    for(channel = 0; channel < 10; channel++)
+    {
+        if(!isCut)
+        {
+            if(0 == memcmp(&committed[channel], &pending[channel], sizeof(T_Conversion)))
+                continue;
+
+            before[channel] = pending[channel];
+        }
+        else if(0 == memcmp(&committed[channel], &before[channel], sizeof(T_Conversion)))
+            continue;
+
+        if((pendingChannels & (1 << channel)) && (0 == memcmp(&committed[channel], &pending[channel], sizeof(T_Conversion))))
+            continue;
+
+        printf("journal: %s run %u save %u: channel %u has slope %d intercept %d, expected slope %d intercept %d\n",
+               pPhase, (unsigned)run, (unsigned)save, channel, committed[channel].slope[0], committed[channel].intercept[0],
+               before[channel].slope[0], before[channel].intercept[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+/*
+ * Adjusts some channels as the menu or the zero tracking would and sets them pending. Returns
+ * the channel to save alone or NO_CHANNEL when the save is a calibration save.
+ */
+static uint8_t JournalTest_Adjust(void)
+{
+    T_CalibrationInfo calibInfo;
+    uint8_t           channel  = (uint8_t)JournalTest_Random(10);
+    uint8_t           i;
+    uint8_t           j;
+
+    if(JournalTest_Random(2))
+    {
+        /* Zero tracking of a single channel */
+        Adjustment_SetZero(&measInfo, channel, (uint16_t)JournalTest_Random(0x4000));
+        pendingChannels = 1 << channel;
+    }
+    else
+    {
+        /* Calibration of a batch, every other channel from the first one */
+        calibInfo.measToCalibrate = channel;
+        calibInfo.channelCount    = 1 + JournalTest_Random(4);
+
+        while((channel + (2 * (calibInfo.channelCount - 1))) >= 10)
+            calibInfo.channelCount--;
+
+        for(i = 0; i < calibInfo.channelCount; i++)
+        {
+            calibInfo.calibResults[i][0] = 800 + JournalTest_Random(3000);
+
+            for(j = 1; j < CALIBRATION_POINT_COUNT; j++)
+                calibInfo.calibResults[i][j] = calibInfo.calibResults[i][j - 1] + 2000 + JournalTest_Random(4000);
+        }
+
+        if(Adjustment_MakeAdjustment(&measInfo, &calibInfo, CALIBRATION_POINTS[channel % 2]))
+        {
+            for(i = 0; i < calibInfo.channelCount; i++)
+                pendingChannels |= 1 << (channel + (2 * i));
+        }
+
+        channel = NO_CHANNEL;
+    }
+
+    memcpy(pending, measInfo.conversions, sizeof(pending));
+
+    return channel;
+}
+
+
+/*
+ * Runs a number of saves from the old data, cutting the power at the chosen FLASH operations.
+ * After a cut the device reboots, the adjustment is checked and the run goes on with the next
+ * save. The seed makes the saves and the cuts of a run repeatable. Returns the number of FLASH
+ * operations of the run.
+ */
+static uint32_t JournalTest_Run(const char * pPhase, uint32_t run, uint32_t saves, uint32_t cut, uint8_t isRandom)
+{
+    /* Kept in statics so that they're intact after the long jump */
+    static uint32_t save;
+    static uint8_t  channel;
+    static uint8_t  isCut;
+
+    srand(run + 1);
+    JournalTest_SetOldData();
+    JournalTest_Reboot();
+
+    flashOperations = 0;
+    cutCountdown    = cut;
+
+    for(save = 0; save < saves; save++)
+    {
+        pendingChannels = 0;
+        channel         = JournalTest_Adjust();
+        isCut           = 0;
+
+        if(0 == setjmp(powerCut))
+        {
+            if(NO_CHANNEL != channel)
+                Adjustment_SaveChannel(&measInfo, channel);
+            else
+                Adjustment_SaveAdjustmentToFlash(&measInfo);
+        }
+        else
+        {
+            isCut = 1;
+
+            if(isRandom)
+                cutCountdown = 1 + JournalTest_Random(2 * RANDOM_CUT_INTERVAL);
+        }
+
+        JournalTest_Check(pPhase, run, save, isCut);
+    }
+
+    return flashOperations;
+}
+
+
+/****************************************************************************************************
+ *                                         GLOBAL FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * The test has no tick, these keep the simulated HAL linked.
+ */
+void Timer_PeriodISR(void)
+{
+}
+
+void Charger_TickISR(void)
+{
+}
+
+uint32_t Timer_GetMilliseconds(void)
+{
+    return 0;
+}
+
+void USCI0TX_ISR(void)
+{
+}
+
+void USCI0RX_ISR(void)
+{
+}
+
+
+int main(void)
+{
+    uint32_t operations;
+    uint32_t cut;
+
+    halHost.pFlashHook = JournalTest_FlashHook;
+
+    /* Same run without a cut gives the number of operations to cut at */
+    operations = JournalTest_Run("sweep", 0, SWEEP_SAVES, NO_CUT, 0);
+
+    for(cut = 1; cut <= operations; cut++)
+        JournalTest_Run("sweep", 0, SWEEP_SAVES, cut, 0);
+
+    JournalTest_Run("random", 1, RANDOM_SAVES, 1 + JournalTest_Random(2 * RANDOM_CUT_INTERVAL), 1);
+
+    printf("journal: %u cut points of %u saves and %u random saves passed\n",
+           (unsigned)operations, SWEEP_SAVES, RANDOM_SAVES);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,678 @@
+/*
+ * Plant.c
+ *
+ * Closed-loop solar panel, buck converter and battery plant of the host build. The plant is
+ * advanced on every tick before the tick interrupt in sub steps short enough for the converter
+ * dynamics, then the ADC inputs are updated from it. See Plant.h for the models and the report.
+ *
+ * Panel: I = Iph - I0 * (exp((V + I * Rs) / (n * Ns * Vt)) - 1) - (V + I * Rs) / Rsh, solved for
+ * the current with Newton's method. Photo current is proportional to the irradiance and the
+ * cells are at 25 C.
+ *
+ * Converter: the input capacitor C is charged by the panel and discharged by D * IL, the
+ * inductor L sees D * Vc less the battery voltage and it's resistance. The diode keeps the
+ * inductor current from going negative. D is the panel's CCR value divided by the timer period.
+ *
+ * Battery: open circuit voltage rises linearly with the state of charge and steeply in the
+ * absorption region near full, the terminal voltage adds the internal resistance.
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Hal.h"
+#include "Plant.h"
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+/* 50 W panel of 36 cells: 3.1 A short circuit current and 21.6 V open circuit voltage at 1000 W/m^2 */
+#define PANEL_SHORT_CIRCUIT_CURRENT 3.1
+#define PANEL_OPEN_CIRCUIT_VOLTAGE  21.6
+#define PANEL_CELLS                 36
+#define PANEL_IDEALITY              1.3
+#define PANEL_THERMAL_VOLTAGE       0.025693
+#define PANEL_SERIES_RESISTANCE     0.3
+#define PANEL_SHUNT_RESISTANCE      200.0
+#define PANEL_NOMINAL_IRRADIANCE    1000.0
+#define PANEL_EMPTY_VOLTAGE         1e-9
+
+/* Buck converter */
+#define CONVERTER_INDUCTANCE        100e-6
+#define CONVERTER_CAPACITANCE       220e-6
+#define CONVERTER_RESISTANCE        0.05
+#define CONVERTER_PERIOD_COUNTS     128.0
+#define CONVERTER_STEP_SECONDS      4e-6
+
+/* Lead-acid battery */
+#define BATTERY_EMPTY_VOLTAGE       11.8
+#define BATTERY_VOLTAGE_SPAN        0.9
+#define BATTERY_ABSORPTION_START    0.9
+#define BATTERY_ABSORPTION_SLOPE    20.0
+#define BATTERY_RESISTANCE          0.02
+
+/* NTC of 10 kOhm at 25 C with B 3950 K and a 10 kOhm pull-up */
+#define NTC_RESISTANCE              10000.0
+#define NTC_B                       3950.0
+#define NTC_PULL_UP                 10000.0
+
+/* Gains of the measurement front end in volts and amperes per ADC count */
+#define PANEL_VOLTAGE_GAIN          0.0361111
+#define PANEL_CURRENT_GAIN          0.005
+#define BATTERY_VOLTAGE_GAIN        0.0218397
+#define BATTERY_CURRENT_GAIN        0.01
+
+/* Analog inputs of the measurements in the order of the measurement channels and the NTC */
+#define MEASUREMENT_CHANNELS        10
+#define NTC_INPUT                   13
+
+/* Adjustment data of the earlier versions in information FLASH */
+#define FLASH_COEFFICIENT_OFFSET    0x00
+#define FLASH_OFFSET_OFFSET         0x40
+
+/* Harvested power is averaged over 100 ms so the ripple of the control isn't taken as unsettled */
+#define SAMPLE_SECONDS              0.1
+
+/* Harvested power is settled when it stays within 2 % of it's final value or 0.5 W */
+#define SETTLING_BAND               0.02
+#define SETTLING_MIN_BAND           0.5
+
+/* Final value of a window is the mean of it's last tenth */
+#define SETTLING_FINAL_DIVIDER      10
+
+/* Night mode must start within 2 s of the expected time */
+#define NIGHT_TOLERANCE_SECONDS     2.0
+
+#define DEFAULT_SCENARIO            "clear"
+
+
+/* Analog inputs A0 - A7, A12 and A14 of the measurement channels */
+static const uint8_t MEASUREMENT_INPUTS[MEASUREMENT_CHANNELS] = { 0, 1, 2, 3, 4, 5, 6, 7, 12, 14 };
+
+static const double MEASUREMENT_GAINS[MEASUREMENT_CHANNELS] = { PANEL_VOLTAGE_GAIN, PANEL_CURRENT_GAIN,
+                                                                PANEL_VOLTAGE_GAIN, PANEL_CURRENT_GAIN,
+                                                                PANEL_VOLTAGE_GAIN, PANEL_CURRENT_GAIN,
+                                                                PANEL_VOLTAGE_GAIN, PANEL_CURRENT_GAIN,
+                                                                BATTERY_VOLTAGE_GAIN, BATTERY_CURRENT_GAIN };
+
+static const T_Scenario SCENARIOS[] =
+{
+    /* Steady sun on all panels */
+    { "clear",   20,  25, 50, 50000, 1,   0, 1, { {     0, 1000, { 100, 100, 100, 100 } } } },
+
+    /* A cloud covers the sun for 8 seconds */
+    { "cloud",   24,  25, 50, 50000, 1,   0, 5, { {     0, 1000, { 100, 100, 100, 100 } },
+                                                  {  8000, 1000, { 100, 100, 100, 100 } },
+                                                  {  8000,  300, { 100, 100, 100, 100 } },
+                                                  { 16000,  300, { 100, 100, 100, 100 } },
+                                                  { 16000, 1000, { 100, 100, 100, 100 } } } },
+
+    /* Panel 4 is partly shaded */
+    { "shading", 16,  25, 50, 50000, 1,   0, 3, { {     0, 1000, { 100, 100, 100, 100 } },
+                                                  {  8000, 1000, { 100, 100, 100, 100 } },
+                                                  {  8000, 1000, { 100, 100, 100,  40 } } } },
+
+    /* Morning sun rises slowly */
+    { "ramp",    20,  25, 50, 50000, 1,   0, 2, { {     0,  100, { 100, 100, 100, 100 } },
+                                                  { 20000, 1000, { 100, 100, 100, 100 } } } },
+
+    /* Cold battery takes a higher charge voltage */
+    { "cold",    12, -10, 90, 50000, 1,   0, 1, { {     0,  800, { 100, 100, 100, 100 } } } },
+
+    /* Sun sets and night mode is entered after NIGHT_DELAY_MS of 600 s */
+    { "dusk",   620,  25, 50, 50000, 1, 610, 3, { {     0, 1000, { 100, 100, 100, 100 } },
+                                                  { 10000, 1000, { 100, 100, 100, 100 } },
+                                                  { 10000,    0, { 100, 100, 100, 100 } } } },
+
+    /* Small battery reaches the charge voltage */
+    { "full",    20,  25, 95,    50, 1,   0, 1, { {     0, 1000, { 100, 100, 100, 100 } } } },
+};
+
+#define SCENARIO_COUNT (sizeof(SCENARIOS) / sizeof(SCENARIOS[0]))
+
+
+/****************************************************************************************************
+ *                                       DATA TYPE DEFINITIONS
+ ****************************************************************************************************/
+
+
+/* Harvested power averaged over a sample period that ends at the given time */
+typedef struct
+{
+    double seconds;
+    double power;
+} T_PowerSample;
+
+
+/* State of the plant */
+typedef struct
+{
+    const T_Scenario * pScenario;
+    double             seconds;
+    double             capacitorVoltage[PLANT_PANELS];
+    double             inductorCurrent[PLANT_PANELS];
+    double             panelCurrent[PLANT_PANELS];
+    double             batteryCurrent;
+    double             batteryVoltage;
+    double             stateOfCharge;
+    double             panelEnergy[PLANT_PANELS];    /* J */
+    double             availableEnergy[PLANT_PANELS];
+    double             batteryEnergy;
+    double             mppIrradiance[PLANT_PANELS];  /* Irradiance of the cached maximum power */
+    double             mppPower[PLANT_PANELS];
+    uint32_t           noiseSeed;
+    double             sampleEnergy;
+    double             sampleSeconds;
+    T_PowerSample    * pSamples;
+    uint32_t           sampleCount;
+    uint32_t           sampleCapacity;
+    double             nightSeconds;                 /* Start of night mode, 0 if not yet */
+} T_Plant;
+
+
+/****************************************************************************************************
+ *                                             VARIABLES
+ ****************************************************************************************************/
+
+
+static T_Plant plant;
+
+
+/****************************************************************************************************
+ *                                         STATIC FUNCTIONS
+ ****************************************************************************************************/
+
+
+/*
+ * Returns the current of a panel at the given voltage and irradiance. Newton's method starts
+ * from the given current which is usually the panel's previous current.
+ */
+static double Plant_PanelCurrent(double irradiance, double voltage, double current)
+{
+    const double thermal    = PANEL_IDEALITY * PANEL_CELLS * PANEL_THERMAL_VOLTAGE;
+    const double saturation = PANEL_SHORT_CIRCUIT_CURRENT / (exp(PANEL_OPEN_CIRCUIT_VOLTAGE / thermal) - 1.0);
+    double       photo      = PANEL_SHORT_CIRCUIT_CURRENT * irradiance / PANEL_NOMINAL_IRRADIANCE;
+    double       exponent;
+    double       diode;
+    double       error;
+    uint8_t      i;
+
+    /* A dark panel with an empty capacitor has no current */
+    if((irradiance <= 0.0) && (voltage <= 0.0))
+        return 0.0;
+
+    for(i = 0; i < 20; i++)
+    {
+        exponent = (voltage + current * PANEL_SERIES_RESISTANCE) / thermal;
+
+        if(exponent > 60.0)
+            exponent = 60.0;
+
+        diode = saturation * exp(exponent);
+        error = photo - (diode - saturation) - ((voltage + current * PANEL_SERIES_RESISTANCE) / PANEL_SHUNT_RESISTANCE) - current;
+
+        current += error / ((diode * PANEL_SERIES_RESISTANCE / thermal) + (PANEL_SERIES_RESISTANCE / PANEL_SHUNT_RESISTANCE) + 1.0);
+
+        if(fabs(error) < 1e-7)
+            break;
+    }
+
+    return current;
+}
+
+
+/*
+ * Returns the maximum power of a panel at the given irradiance by a golden section search
+ * over the voltage.
+ */
+static double Plant_MaximumPower(double irradiance)
+{
+    const double ratio = (sqrt(5.0) - 1.0) / 2.0;
+    double       low   = 0.0;
+    double       high  = PANEL_OPEN_CIRCUIT_VOLTAGE * 1.05;
+    double       a;
+    double       b;
+    uint8_t      i;
+
+    if(irradiance <= 0.0)
+        return 0.0;
+
+    for(i = 0; i < 60; i++)
+    {
+        a = high - ratio * (high - low);
+        b = low  + ratio * (high - low);
+
+        if(a * Plant_PanelCurrent(irradiance, a, 0.0) > b * Plant_PanelCurrent(irradiance, b, 0.0))
+            high = b;
+        else
+            low  = a;
+    }
+
+    a = (low + high) / 2.0;
+
+    return a * Plant_PanelCurrent(irradiance, a, 0.0);
+}
+
+
+/*
+ * Returns the open circuit voltage of a panel at the given irradiance by bisection.
+ */
+static double Plant_OpenCircuitVoltage(double irradiance)
+{
+    double  low  = 0.0;
+    double  high = PANEL_OPEN_CIRCUIT_VOLTAGE * 1.2;
+    double  middle;
+    uint8_t i;
+
+    if(irradiance <= 0.0)
+        return 0.0;
+
+    for(i = 0; i < 50; i++)
+    {
+        middle = (low + high) / 2.0;
+
+        if(Plant_PanelCurrent(irradiance, middle, 0.0) > 0.0)
+            low  = middle;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+
+/*
+ * Returns the irradiance reaching a panel at the given time of the scenario's profile.
+ */
+static double Plant_Irradiance(uint8_t panel, double seconds)
+{
+    const T_Scenario     * pScenario    = plant.pScenario;
+    const T_ProfilePoint * pPrevious    = &pScenario->points[0];
+    const T_ProfilePoint * pNext;
+    double                 milliseconds = seconds * 1000.0;
+    double                 fraction;
+    uint8_t                i;
+
+    for(i = 1; i < pScenario->pointCount; i++)
+    {
+        pNext = &pScenario->points[i];
+
+        if(milliseconds < pNext->milliseconds)
+        {
+            fraction = (milliseconds - pPrevious->milliseconds) / (double)(pNext->milliseconds - pPrevious->milliseconds);
+
+            return ((pPrevious->irradiance * pPrevious->shade[panel]) +
+                    fraction * ((pNext->irradiance * pNext->shade[panel]) - (pPrevious->irradiance * pPrevious->shade[panel]))) / 100.0;
+        }
+
+        pPrevious = pNext;
+    }
+
+    return (pPrevious->irradiance * pPrevious->shade[panel]) / 100.0;
+}
+
+
+/*
+ * Returns the open circuit voltage of the battery at the given state of charge.
+ */
+static double Plant_BatteryOpenCircuitVoltage(double stateOfCharge)
+{
+    double voltage = BATTERY_EMPTY_VOLTAGE + BATTERY_VOLTAGE_SPAN * stateOfCharge;
+
+    if(stateOfCharge > BATTERY_ABSORPTION_START)
+        voltage += BATTERY_ABSORPTION_SLOPE * (stateOfCharge - BATTERY_ABSORPTION_START);
+
+    return voltage;
+}
+
+
+/*
+ * Returns the ADC count of a quantity with the given gain. Noise of the scenario is added.
+ */
+static uint16_t Plant_ToCounts(double value, double gain)
+{
+    int32_t counts = (int32_t)floor((value / gain) + 0.5);
+    uint8_t noise  = plant.pScenario->noise;
+
+    if(noise)
+    {
+        plant.noiseSeed = plant.noiseSeed * 1103515245u + 12345u;
+        counts         += (int32_t)((plant.noiseSeed >> 16) % (2u * noise + 1u)) - noise;
+    }
+
+    if(counts < 0)
+        return 0;
+
+    if(counts > 1023)
+        return 1023;
+
+    return counts;
+}
+
+
+/*
+ * Updates the simulated analog inputs from the plant.
+ */
+static void Plant_UpdateInputs(void)
+{
+    double  values[MEASUREMENT_CHANNELS];
+    double  kelvin     = plant.pScenario->batteryTemperature + 273.15;
+    double  resistance = NTC_RESISTANCE * exp(NTC_B * ((1.0 / kelvin) - (1.0 / 298.15)));
+    uint8_t i;
+
+    for(i = 0; i < PLANT_PANELS; i++)
+    {
+        values[2 * i]     = plant.capacitorVoltage[i];
+        values[2 * i + 1] = (plant.panelCurrent[i] > 0.0) ? plant.panelCurrent[i] : 0.0;
+    }
+
+    values[8] = plant.batteryVoltage;
+    values[9] = plant.batteryCurrent;
+
+    for(i = 0; i < MEASUREMENT_CHANNELS; i++)
+        halHost.adcInputs[MEASUREMENT_INPUTS[i]] = Plant_ToCounts(values[i], MEASUREMENT_GAINS[i]);
+
+    halHost.adcInputs[NTC_INPUT] = (uint16_t)floor((1023.0 * resistance / (resistance + NTC_PULL_UP)) + 0.5);
+}
+
+
+/*
+ * Adds a sample of the harvested power to the record of the run.
+ */
+static void Plant_AddSample(double power)
+{
+    if(plant.sampleCount == plant.sampleCapacity)
+    {
+        plant.sampleCapacity = plant.sampleCapacity ? (2 * plant.sampleCapacity) : 4096;
+        plant.pSamples       = realloc(plant.pSamples, plant.sampleCapacity * sizeof(T_PowerSample));
+
+        if(!plant.pSamples)
+        {
+            printf("out of memory for power samples\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    plant.pSamples[plant.sampleCount].seconds = plant.seconds;
+    plant.pSamples[plant.sampleCount].power   = power;
+    plant.sampleCount++;
+}
+
+
+/*
+ * Advances the plant over the last tick with the duty cycles of the PWM outputs and updates the
+ * analog inputs. Called by the simulated peripherals before every tick interrupt.
+ */
+static void Plant_Tick(void)
+{
+    double  tickSeconds = halHost.tickMicroseconds * 1e-6;
+    double  capacity    = plant.pScenario->capacity * 3.6;   /* As */
+    double  irradiance[PLANT_PANELS];
+    double  duty[PLANT_PANELS];
+    double  harvested   = 0.0;
+    double  power;
+    double  current;
+    uint8_t  panel;
+    uint16_t step;
+    uint16_t steps      = (uint16_t)((tickSeconds / CONVERTER_STEP_SECONDS) + 0.5);
+
+    for(panel = 0; panel < PLANT_PANELS; panel++)
+    {
+        irradiance[panel] = Plant_Irradiance(panel, plant.seconds);
+        duty[panel]       = Hal_GetPwmDuty(panel) / CONVERTER_PERIOD_COUNTS;
+
+        if(irradiance[panel] != plant.mppIrradiance[panel])
+        {
+            plant.mppIrradiance[panel] = irradiance[panel];
+            plant.mppPower[panel]      = Plant_MaximumPower(irradiance[panel]);
+        }
+
+        plant.availableEnergy[panel] += plant.mppPower[panel] * tickSeconds;
+    }
+
+    for(step = 0; step < steps; step++)
+    {
+        plant.batteryVoltage = Plant_BatteryOpenCircuitVoltage(plant.stateOfCharge) + (plant.batteryCurrent * BATTERY_RESISTANCE);
+        current              = 0.0;
+
+        for(panel = 0; panel < PLANT_PANELS; panel++)
+        {
+            plant.panelCurrent[panel] = Plant_PanelCurrent(irradiance[panel], plant.capacitorVoltage[panel], plant.panelCurrent[panel]);
+
+            /* Inductor first and then the capacitor with the new inductor current keeps the LC stable */
+            plant.inductorCurrent[panel] += (CONVERTER_STEP_SECONDS / CONVERTER_INDUCTANCE) *
+                                            ((duty[panel] * plant.capacitorVoltage[panel]) - plant.batteryVoltage -
+                                             (plant.inductorCurrent[panel] * CONVERTER_RESISTANCE));
+
+            if(plant.inductorCurrent[panel] < 0.0)
+                plant.inductorCurrent[panel] = 0.0;
+
+            plant.capacitorVoltage[panel] += (CONVERTER_STEP_SECONDS / CONVERTER_CAPACITANCE) *
+                                             (plant.panelCurrent[panel] - (duty[panel] * plant.inductorCurrent[panel]));
+
+            /* A dark panel's voltage decays towards zero, it's cut before it reaches the slow denormal numbers */
+            if(plant.capacitorVoltage[panel] < PANEL_EMPTY_VOLTAGE)
+                plant.capacitorVoltage[panel] = 0.0;
+
+            power = plant.capacitorVoltage[panel] * plant.panelCurrent[panel];
+
+            if(power > 0.0)
+            {
+                plant.panelEnergy[panel] += power * CONVERTER_STEP_SECONDS;
+                harvested                += power * CONVERTER_STEP_SECONDS;
+            }
+
+            current += plant.inductorCurrent[panel];
+        }
+
+        plant.batteryCurrent  = current;
+        plant.batteryEnergy  += plant.batteryVoltage * current * CONVERTER_STEP_SECONDS;
+        plant.stateOfCharge  += current * CONVERTER_STEP_SECONDS / capacity;
+
+        if(plant.stateOfCharge > 1.0)
+            plant.stateOfCharge = 1.0;
+    }
+
+    /* Timer_B is stopped only in night mode */
+    if(!(TBCTL & MC_3) && (0.0 == plant.nightSeconds))
+        plant.nightSeconds = plant.seconds;
+
+    plant.seconds += tickSeconds;
+    plant.sampleEnergy  += harvested;
+    plant.sampleSeconds += tickSeconds;
+
+    if(plant.sampleSeconds >= SAMPLE_SECONDS - 1e-9)
+    {
+        Plant_AddSample(plant.sampleEnergy / plant.sampleSeconds);
+        plant.sampleEnergy  = 0.0;
+        plant.sampleSeconds = 0.0;
+    }
+
+    Plant_UpdateInputs();
+}
+
+
+/*
+ * Prints the settling time of the harvested power in the window starting from the given time.
+ * The final value is the mean of the last tenth of the window and the power is settled after
+ * the last sample outside the band around it.
+ */
+static void Plant_ReportSettling(double start, double end)
+{
+    double   finalPower = 0.0;
+    double   band;
+    double   settled    = start;
+    uint32_t count      = 0;
+    uint32_t i;
+
+    for(i = 0; i < plant.sampleCount; i++)
+    {
+        if((plant.pSamples[i].seconds > end - ((end - start) / SETTLING_FINAL_DIVIDER)) && (plant.pSamples[i].seconds <= end + 1e-9))
+        {
+            finalPower += plant.pSamples[i].power;
+            count++;
+        }
+    }
+
+    if(0 == count)
+        return;
+
+    finalPower /= count;
+    band        = finalPower * SETTLING_BAND;
+
+    if(band < SETTLING_MIN_BAND)
+        band = SETTLING_MIN_BAND;
+
+    for(i = 0; i < plant.sampleCount; i++)
+    {
+        if((plant.pSamples[i].seconds > start) && (plant.pSamples[i].seconds <= end + 1e-9) &&
+           (fabs(plant.pSamples[i].power - finalPower) > band))
+        {
+            settled = plant.pSamples[i].seconds;
+        }
+    }
+
+    if(settled >= end - ((end - start) / SETTLING_FINAL_DIVIDER))
+        printf("  after %6.0f ms: not settled, %.2f W at the end\n", start * 1000.0, finalPower);
+    else
+        printf("  after %6.0f ms: settled in %.0f ms to %.2f W\n", start * 1000.0, (settled - start) * 1000.0, finalPower);
+}
+
+
+/*
+ * Prints the report of the scenario at the end of the run.
+ */
+static void Plant_Report(void)
+{
+    const T_Scenario * pScenario = plant.pScenario;
+    double             panelEnergy     = 0.0;
+    double             availableEnergy = 0.0;
+    double             start           = 0.0;
+    double             time;
+    uint8_t            panel;
+    uint8_t            i;
+
+    printf("scenario %s, %.1f s, battery %d C, state of charge %u %% -> %.2f %%\n",
+           pScenario->pName, plant.seconds, pScenario->batteryTemperature, pScenario->stateOfCharge, plant.stateOfCharge * 100.0);
+
+    for(panel = 0; panel < PLANT_PANELS; panel++)
+    {
+        panelEnergy     += plant.panelEnergy[panel];
+        availableEnergy += plant.availableEnergy[panel];
+
+        printf("panel %u: harvested %.4f Wh of %.4f Wh, tracking efficiency %.1f %%\n", panel + 1,
+               plant.panelEnergy[panel] / 3600.0, plant.availableEnergy[panel] / 3600.0,
+               (plant.availableEnergy[panel] > 0.0) ? (100.0 * plant.panelEnergy[panel] / plant.availableEnergy[panel]) : 0.0);
+    }
+
+    printf("total: harvested %.4f Wh of %.4f Wh, tracking efficiency %.1f %%, to battery %.4f Wh\n",
+           panelEnergy / 3600.0, availableEnergy / 3600.0,
+           (availableEnergy > 0.0) ? (100.0 * panelEnergy / availableEnergy) : 0.0, plant.batteryEnergy / 3600.0);
+
+    printf("settling of harvested power:\n");
+
+    /* Each new time in the profile starts a window that ends at the next one or at the end */
+    for(i = 1; i <= pScenario->pointCount; i++)
+    {
+        time = (i < pScenario->pointCount) ? (pScenario->points[i].milliseconds / 1000.0) : plant.seconds;
+
+        if(time > plant.seconds)
+            time = plant.seconds;
+
+        if(time > start)
+        {
+            Plant_ReportSettling(start, time);
+            start = time;
+        }
+    }
+
+    free(plant.pSamples);
+
+    if(plant.nightSeconds > 0.0)
+        printf("night mode at %.1f s\n", plant.nightSeconds);
+
+    /* A run cut short before the expected night mode, with CHARGER_HOST_SECONDS, isn't checked */
+    if((plant.nightSeconds <= 0.0) && (plant.seconds <= pScenario->nightSeconds + NIGHT_TOLERANCE_SECONDS))
+        return;
+
+    if((pScenario->nightSeconds > 0) != (plant.nightSeconds > 0.0) ||
+       (fabs(plant.nightSeconds - pScenario->nightSeconds) > NIGHT_TOLERANCE_SECONDS))
+    {
+        printf("night mode expected at %u s\n", pScenario->nightSeconds);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+/*
+ * Chooses the scenario, writes the gains of the measurement front end to information FLASH and
+ * sets the plant to it's start. Runs after the simulated peripherals are initialized.
+ */
+__attribute__((constructor(102)))
+static void Plant_Initialize(void)
+{
+    const char * pName = getenv("CHARGER_HOST_SCENARIO");
+    float        gain;
+    float        offset = 0.0f;
+    uint8_t      panel;
+    uint8_t      i;
+
+    if(!pName)
+        pName = DEFAULT_SCENARIO;
+
+    for(i = 0; i < SCENARIO_COUNT; i++)
+    {
+        if(0 == strcmp(pName, SCENARIOS[i].pName))
+            plant.pScenario = &SCENARIOS[i];
+    }
+
+    if(!plant.pScenario)
+    {
+        printf("unknown scenario %s, scenarios are:", pName);
+
+        for(i = 0; i < SCENARIO_COUNT; i++)
+            printf(" %s", SCENARIOS[i].pName);
+
+        printf("\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if(!getenv("CHARGER_HOST_SECONDS"))
+        halHost.endMilliseconds = plant.pScenario->seconds * 1000u;
+
+    for(i = 0; i < MEASUREMENT_CHANNELS; i++)
+    {
+        gain = (float)MEASUREMENT_GAINS[i];
+        memcpy(&halHost.infoFlash[FLASH_COEFFICIENT_OFFSET + (4 * i)], &gain,   sizeof(gain));
+        memcpy(&halHost.infoFlash[FLASH_OFFSET_OFFSET + (4 * i)],      &offset, sizeof(offset));
+    }
+
+    plant.stateOfCharge  = plant.pScenario->stateOfCharge / 100.0;
+    plant.batteryVoltage = Plant_BatteryOpenCircuitVoltage(plant.stateOfCharge);
+    plant.noiseSeed      = 1;
+
+    for(panel = 0; panel < PLANT_PANELS; panel++)
+    {
+        plant.mppIrradiance[panel]    = -1.0;
+        plant.capacitorVoltage[panel] = Plant_OpenCircuitVoltage(Plant_Irradiance(panel, 0.0));
+    }
+
+    Plant_UpdateInputs();
+
+    halHost.pTickHook = Plant_Tick;
+    halHost.pEndHook  = Plant_Report;
+}
@@ -0,0 +1,82 @@
+/*
+ * Plant.h
+ *
+ * Closed-loop plant of the host build for evaluating the charge control. Four solar panels are
+ * modelled with the single-diode equation and each drives the battery through a buck converter
+ * whose averaged model takes the duty cycle from the panel's CCR register. The battery is an
+ * open circuit voltage by state of charge behind an internal resistance. On every tick the
+ * plant is advanced over the tick and the panel and battery quantities are turned into ADC
+ * counts of the simulated inputs, so the program measures them through it's real measurement
+ * path. The gains of the measurement front end are written to information FLASH as the data of
+ * the earlier versions, so the program's conversions match the plant.
+ *
+ * A scenario gives the irradiance, the shading of each panel, the battery and the length of the
+ * run. It's chosen by name with CHARGER_HOST_SCENARIO, "clear" by default. At the end of the run
+ * the plant reports the energy harvested to the battery, the tracking efficiency of each panel
+ * against it's maximum power point and the settling time of the harvested power after each
+ * change of the profile. The run is deterministic, ADC noise comes from a fixed sequence. The
+ * time the program enters night mode is reported too and the run fails if it's not the time
+ * the scenario expects.
+ *
+ * Header includes:
+ * - scenario and profile definitions
+ *
+ *    Part of: Charger project
+ * Created on: 18.10.2026
+ */
+
+
+#ifndef CHARGER_PLANT_H_
+#define CHARGER_PLANT_H_
+
+
+/****************************************************************************************************
+ *                                             HEADERS
+ ****************************************************************************************************/
+
+
+#include <stdint.h>
+
+
+/****************************************************************************************************
+ *                                            CONSTANTS
+ ****************************************************************************************************/
+
+
+#define PLANT_PANELS         4
+
+/* Maximum number of points in the profile of a scenario */
+#define PLANT_PROFILE_POINTS 6
+
+
+/****************************************************************************************************
+ *                                       DATA TYPE DEFINITIONS
+ ****************************************************************************************************/
+
+
+/* Point of an irradiance profile. Values between points are interpolated linearly and two points
+ * at the same time make a step.                                                              */
+typedef struct
+{
+    uint32_t milliseconds;
+    uint16_t irradiance;              /* W/m^2                                              */
+    uint8_t  shade[PLANT_PANELS];     /* Percent of the irradiance that reaches each panel  */
+} T_ProfilePoint;
+
+
+/* Scenario of a simulation run */
+typedef struct
+{
+    const char     * pName;
+    uint16_t         seconds;                  /* Length of the run                         */
+    int8_t           batteryTemperature;       /* C                                         */
+    uint8_t          stateOfCharge;            /* Percent at the start                      */
+    uint16_t         capacity;                 /* mAh                                       */
+    uint8_t          noise;                    /* Peak ADC noise in counts                  */
+    uint16_t         nightSeconds;             /* Expected start of night mode, 0 if none   */
+    uint8_t          pointCount;
+    T_ProfilePoint   points[PLANT_PROFILE_POINTS];
+} T_Scenario;
+
+
+#endif /* CHARGER_PLANT_H_ */